@@ -0,0 +1,404 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <utility>
+#include <cmath>
+
+#include "graph_point.hpp"
+#include "instrument.hpp"
+
+namespace sampling
+{
+    struct AdaptiveOptions
+    {
+        // Screen scale: how many pixels one world unit spans.
+        double pixels_per_unit = 10.0;
+
+        // Maximum distance, in pixels, between the curve and the drawn
+        // segment approximating it.
+        double tolerance = 0.5;
+
+        // Segments are always halved below `min_depth`. Segments still
+        // failing the test at `max_depth` are either drawn as they are or,
+        // if they jump more than `jump` pixels, treated as a discontinuity
+        // and cut.
+        int min_depth = 0;
+        int max_depth = 10;
+        double jump = 100.0;
+
+        GraphPoint::Color color { 0, 0, 255, 255 };
+    };
+
+    struct SamplePoint
+    {
+        double x;
+        double y;
+    };
+
+    // Most vertices a segment refined with `max_depth` can yield, its ends
+    // included: every segment of the deepest level may keep its midpoint.
+    inline std::size_t max_vertices(int max_depth)
+    {
+        return (std::size_t(1) << (max_depth + 1)) + 1;
+    }
+
+    namespace detail
+    {
+        class CurveBuilder
+        {
+        public:
+            CurveBuilder(Curve& curve, GraphPoint::Color color)
+                : m_curve(curve), m_color(color)
+            {
+            }
+
+            void add(SamplePoint p)
+            {
+                if (!std::isfinite(p.y))
+                {
+                    cut();
+                    return;
+                }
+
+                if (!m_open)
+                {
+                    m_curve.strips.push_back(static_cast<asl::i32>(m_curve.vertices.size()), 0);
+                    m_open = true;
+                }
+
+                GraphPoint v;
+                v.pos.x = static_cast<float>(p.x);
+                v.pos.y = static_cast<float>(p.y);
+                v.color = m_color;
+
+                m_curve.vertices.push_back(v);
+                ++m_curve.strips.count.back();
+            }
+
+            void cut()
+            {
+                m_open = false;
+            }
+
+        private:
+            Curve& m_curve;
+            GraphPoint::Color m_color;
+            bool m_open = false;
+        };
+
+        // Distance in pixels of m from the segment a-b.
+        inline double screen_deviation(SamplePoint a, SamplePoint m, SamplePoint b,
+                                       double scale)
+        {
+            const double dx = (b.x - a.x) * scale;
+            const double dy = (b.y - a.y) * scale;
+            const double mx = (m.x - a.x) * scale;
+            const double my = (m.y - a.y) * scale;
+
+            const double len = std::sqrt(dx * dx + dy * dy);
+
+            if (len == 0.0)
+            {
+                return std::sqrt(mx * mx + my * my);
+            }
+
+            return std::abs(dx * my - dy * mx) / len;
+        }
+
+        inline bool finite(SamplePoint p)
+        {
+            return std::isfinite(p.y);
+        }
+
+        enum class Segment
+        {
+            Flat,   // close enough to a straight line
+            Split,  // halve it and look again
+            Keep,   // out of depth: draw it through the midpoint
+            Cut     // out of depth and jumping, or undefined: break the strip
+        };
+
+        inline Segment classify(SamplePoint a, SamplePoint m, SamplePoint b,
+                                int depth, const AdaptiveOptions& opt)
+        {
+            if (depth < opt.min_depth)
+            {
+                return Segment::Split;
+            }
+
+            if (!finite(a) && !finite(m) && !finite(b))
+            {
+                return Segment::Cut;
+            }
+
+            const bool all_finite = finite(a) && finite(m) && finite(b);
+
+            // A steep segment whose midpoint falls outside its endpoints
+            // (a pole between them) must not pass as a vertical line.
+            const bool steep = std::abs(b.y - a.y) * opt.pixels_per_unit > opt.jump;
+            const bool between = (m.y >= std::min(a.y, b.y)) && (m.y <= std::max(a.y, b.y));
+
+            if (all_finite && (!steep || between) &&
+                screen_deviation(a, m, b, opt.pixels_per_unit) <= opt.tolerance)
+            {
+                return Segment::Flat;
+            }
+
+            if (depth >= opt.max_depth)
+            {
+                return (!all_finite || steep) ? Segment::Cut : Segment::Keep;
+            }
+
+            return Segment::Split;
+        }
+
+        // Emits the points after `a` up to and including `b`.
+        template <typename F>
+        void refine(F& fun, const AdaptiveOptions& opt, CurveBuilder& out,
+                    SamplePoint a, SamplePoint b, int depth)
+        {
+            const double xm = (a.x + b.x) / 2;
+            const SamplePoint m { xm, fun(xm) };
+
+            switch (classify(a, m, b, depth, opt))
+            {
+            case Segment::Flat:
+                out.add(b);
+                break;
+
+            case Segment::Keep:
+                out.add(m);
+                out.add(b);
+                break;
+
+            case Segment::Cut:
+                out.cut();
+                out.add(b);
+                break;
+
+            case Segment::Split:
+                refine(fun, opt, out, a, m, depth + 1);
+                refine(fun, opt, out, m, b, depth + 1);
+                break;
+            }
+        }
+    }
+
+    // Samples fun on the segments between consecutive seeds (sorted by x,
+    // with their values already known), recursively halving every segment
+    // until the midpoint lies within `tolerance` pixels of the straight
+    // line. The result is appended to `curve`, split in a new strip at
+    // every discontinuity or undefined stretch.
+    template <typename F>
+    void sample_adaptive(F&& fun, const std::vector<SamplePoint>& seeds,
+                         const AdaptiveOptions& opt, Curve& curve)
+    {
+        if (seeds.empty())
+        {
+            return;
+        }
+
+        const instrument::Scope scope("adaptive");
+
+        detail::CurveBuilder out(curve, opt.color);
+
+        out.add(seeds.front());
+
+        for (std::size_t i = 1; i < seeds.size(); ++i)
+        {
+            detail::refine(fun, opt, out, seeds[i - 1], seeds[i], 0);
+        }
+    }
+
+    // Resumable, breadth-first version of sample_adaptive for [from, to].
+    //
+    // Level 0 is the segment between the two endpoints; every level halves
+    // the segments of the previous one that fail the same test used by
+    // sample_adaptive (segments below `min_depth` are always halved). Each
+    // call to step() works for at most about `budget` and can stop in the
+    // middle of a level; every completed level replaces curve(), so a
+    // coarse curve is available early and is refined in place.
+    class ProgressiveSampler
+    {
+    public:
+        using Function = std::function<double(double)>;
+        using Clock = std::chrono::steady_clock;
+
+        void reset(Function fun, const AdaptiveOptions& opt, double from, double to)
+        {
+            m_fun = std::move(fun);
+            m_options = opt;
+            m_from = from;
+            m_to = to;
+            m_seeds.clear();
+
+            restart();
+        }
+
+        // Starts from at least two `seeds`, sorted by x with their values
+        // already known, instead of the endpoints: level 0 is the segments
+        // between them and the depths in `opt` count from there.
+        void reset(Function fun, const AdaptiveOptions& opt, std::vector<SamplePoint> seeds)
+        {
+            m_fun = std::move(fun);
+            m_options = opt;
+            m_from = seeds.front().x;
+            m_to = seeds.back().x;
+            m_seeds = std::move(seeds);
+
+            restart();
+        }
+
+        bool done() const { return m_done; }
+        int level() const { return m_depth; }
+
+        // Last completed level.
+        const Curve& curve() const { return m_curve; }
+
+        // Refines until `budget` runs out or sampling is complete. Returns
+        // true if at least one level was completed, i.e. curve() changed.
+        bool step(std::chrono::microseconds budget)
+        {
+            const auto deadline = Clock::now() + budget;
+            bool completed = false;
+
+            if (m_done)
+            {
+                return false;
+            }
+
+            if (m_current.empty())
+            {
+                if (m_seeds.empty())
+                {
+                    m_current.push_back({ { m_from, m_fun(m_from) }, false, false });
+                    m_current.push_back({ { m_to, m_fun(m_to) }, false, false });
+                }
+
+                for (const auto& seed : m_seeds)
+                {
+                    m_current.push_back({ seed, false, false });
+                }
+
+                finish_level();
+                completed = true;
+            }
+
+            while (!m_done && Clock::now() < deadline)
+            {
+                if (m_cursor + 1 >= m_current.size())
+                {
+                    m_next.push_back(m_current.back());
+                    std::swap(m_current, m_next);
+
+                    ++m_depth;
+                    finish_level();
+                    completed = true;
+
+                    continue;
+                }
+
+                const Node& a = m_current[m_cursor];
+                const Node& b = m_current[m_cursor + 1];
+
+                ++m_cursor;
+
+                if (a.settled)
+                {
+                    m_next.push_back(a);
+                    continue;
+                }
+
+                const double xm = (a.p.x + b.p.x) / 2;
+                const SamplePoint m { xm, m_fun(xm) };
+
+                switch (detail::classify(a.p, m, b.p, m_depth, m_options))
+                {
+                case detail::Segment::Flat:
+                    m_next.push_back({ a.p, true, false });
+                    break;
+
+                case detail::Segment::Keep:
+                    m_next.push_back({ a.p, true, false });
+                    m_next.push_back({ m, true, false });
+                    break;
+
+                case detail::Segment::Cut:
+                    m_next.push_back({ a.p, true, true });
+                    break;
+
+                case detail::Segment::Split:
+                    m_next.push_back({ a.p, false, false });
+                    m_next.push_back({ m, false, false });
+                    break;
+                }
+            }
+
+            return completed;
+        }
+
+    private:
+        // `settled` and `cut` describe the segment starting at the node.
+        struct Node
+        {
+            SamplePoint p;
+            bool settled;
+            bool cut;
+        };
+
+        void restart()
+        {
+            m_current.clear();
+            m_next.clear();
+            m_curve.clear();
+            m_cursor = 0;
+            m_depth = 0;
+            m_done = false;
+        }
+
+        void finish_level()
+        {
+            m_next.clear();
+            m_cursor = 0;
+
+            m_curve.clear();
+            detail::CurveBuilder out(m_curve, m_options.color);
+
+            bool refinable = false;
+
+            for (std::size_t i = 0; i < m_current.size(); ++i)
+            {
+                out.add(m_current[i].p);
+
+                if (m_current[i].cut)
+                {
+                    out.cut();
+                }
+
+                if (i + 1 < m_current.size() && !m_current[i].settled)
+                {
+                    refinable = true;
+                }
+            }
+
+            m_done = !refinable;
+        }
+
+        Function m_fun;
+        AdaptiveOptions m_options;
+        double m_from = 0.0;
+        double m_to = 0.0;
+        std::vector<SamplePoint> m_seeds;
+
+        std::vector<Node> m_current;
+        std::vector<Node> m_next;
+        std::size_t m_cursor = 0;
+        int m_depth = 0;
+        bool m_done = false;
+
+        Curve m_curve;
+    };
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <cmath>
+
+#include "parallel.hpp"
+
+namespace analysis
+{
+    struct Extremum
+    {
+        enum class Kind
+        {
+            Minimum,
+            Maximum
+        } kind;
+
+        double x;
+        double y;
+    };
+
+    struct CriticalPoints
+    {
+        std::vector<double> roots;
+        std::vector<Extremum> extrema;
+    };
+
+    // Brent's method on a bracket [a, b] where fa and fb have opposite
+    // signs (or one of them is zero).
+    template <typename F>
+    double brent_root(F&& fun, double a, double b, double fa, double fb,
+                      double tolerance, int max_iterations = 100)
+    {
+        if (fa == 0.0)
+        {
+            return a;
+        }
+
+        if (fb == 0.0)
+        {
+            return b;
+        }
+
+        if (std::abs(fa) < std::abs(fb))
+        {
+            std::swap(a, b);
+            std::swap(fa, fb);
+        }
+
+        double c = a;
+        double fc = fa;
+        double d = b - a;
+        bool bisected = true;
+
+        for (int i = 0; i < max_iterations; ++i)
+        {
+            if (fb == 0.0 || std::abs(b - a) < tolerance)
+            {
+                break;
+            }
+
+            double s = 0.0;
+
+            if (fa != fc && fb != fc)
+            {
+                // inverse quadratic interpolation
+                s = a * fb * fc / ((fa - fb) * (fa - fc))
+                  + b * fa * fc / ((fb - fa) * (fb - fc))
+                  + c * fa * fb / ((fc - fa) * (fc - fb));
+            }
+            else
+            {
+                // secant
+                s = b - fb * (b - a) / (fb - fa);
+            }
+
+            const double bound = (3 * a + b) / 4;
+            const bool outside = !((s > std::min(bound, b)) && (s < std::max(bound, b)));
+            const bool slow_bisect = bisected && std::abs(s - b) >= std::abs(b - c) / 2;
+            const bool slow_interp = !bisected && std::abs(s - b) >= std::abs(c - d) / 2;
+            const bool tiny_bisect = bisected && std::abs(b - c) < tolerance;
+            const bool tiny_interp = !bisected && std::abs(c - d) < tolerance;
+
+            if (outside || slow_bisect || slow_interp || tiny_bisect || tiny_interp)
+            {
+                s = (a + b) / 2;
+                bisected = true;
+            }
+            else
+            {
+                bisected = false;
+            }
+
+            const double fs = fun(s);
+
+            d = c;
+            c = b;
+            fc = fb;
+
+            if ((fa < 0) != (fs < 0))
+            {
+                b = s;
+                fb = fs;
+            }
+            else
+            {
+                a = s;
+                fa = fs;
+            }
+
+            if (std::abs(fa) < std::abs(fb))
+            {
+                std::swap(a, b);
+                std::swap(fa, fb);
+            }
+        }
+
+        return b;
+    }
+
+    // Central difference with a step scaled to x.
+    template <typename F>
+    double derivative(F&& fun, double x)
+    {
+        const double h = std::cbrt(std::numeric_limits<double>::epsilon())
+                       * std::max(1.0, std::abs(x));
+
+        return (fun(x + h) - fun(x - h)) / (2 * h);
+    }
+
+    // Finds the roots and local extrema of fun from samples that are already
+    // available, with ys[i] = fun(lower + i * step).
+    //
+    // The samples are split in one chunk per thread. Every chunk looks for
+    // sign changes of f (roots) and of its finite differences (extrema) and
+    // refines each bracket with Brent's method, on f for roots and on f' for
+    // extrema. Brackets around poles, where |f| grows instead of vanishing,
+    // are dropped.
+    template <typename F>
+    CriticalPoints find_critical_points(F&& fun, double lower, double step,
+                                        const std::vector<double>& ys,
+                                        double tolerance = 1e-10)
+    {
+        const std::size_t chunks = parallel::thread_count();
+        std::vector<CriticalPoints> partial(chunks);
+
+        const auto x_at = [&] (std::size_t i) { return lower + i * step; };
+        const auto sign = [] (double v) { return (v > 0) - (v < 0); };
+        const auto slope = [&] (std::size_t i) { return ys[i + 1] - ys[i]; };
+        const auto df = [&] (double x) { return derivative(fun, x); };
+
+        const std::size_t segments = ys.size() - 1;
+
+        parallel::for_chunks(segments, chunks,
+                             [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+        {
+            auto& out = partial[chunk];
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const double y0 = ys[i];
+                const double y1 = ys[i + 1];
+
+                if (!std::isfinite(y0) || !std::isfinite(y1))
+                {
+                    continue;
+                }
+
+                // A sample that is exactly zero belongs to the segment
+                // starting there, so that it is reported once.
+                if (y0 == 0.0 || (sign(y0) * sign(y1) < 0) ||
+                    (y1 == 0.0 && i + 1 == segments))
+                {
+                    const double root = brent_root(fun, x_at(i), x_at(i + 1),
+                                                   y0, y1, tolerance);
+                    const double froot = fun(root);
+
+                    if (std::abs(froot) <= std::max(std::abs(y0), std::abs(y1)))
+                    {
+                        out.roots.push_back(root);
+                    }
+                }
+
+                if (i == 0)
+                {
+                    continue;
+                }
+
+                const int s0 = sign(slope(i - 1));
+                const int s1 = sign(slope(i));
+
+                if (s0 == 0 || s1 == 0 || s0 == s1 || !std::isfinite(ys[i - 1]))
+                {
+                    continue;
+                }
+
+                const double a = x_at(i - 1);
+                const double b = x_at(i + 1);
+                const double da = df(a);
+                const double db = df(b);
+
+                // No sign change of f' across the bracket: a jump, not a peak.
+                if (sign(da) * sign(db) >= 0)
+                {
+                    continue;
+                }
+
+                const double x = brent_root(df, a, b, da, db, tolerance);
+                const double y = fun(x);
+
+                if (!std::isfinite(y))
+                {
+                    continue;
+                }
+
+                out.extrema.push_back({
+                    (s0 > 0) ? Extremum::Kind::Maximum : Extremum::Kind::Minimum,
+                    x, y
+                });
+            }
+        });
+
+        CriticalPoints res;
+
+        for (auto& p : partial)
+        {
+            res.roots.insert(res.roots.end(), p.roots.begin(), p.roots.end());
+            res.extrema.insert(res.extrema.end(), p.extrema.begin(), p.extrema.end());
+        }
+
+        return res;
+    }
+
+    // Finds the roots and local extrema of fun in [lower, upper], scanning
+    // `scan_points` uniform samples evaluated in parallel.
+    template <typename F>
+    CriticalPoints find_critical_points(F&& fun, double lower, double upper,
+                                        std::size_t scan_points,
+                                        double tolerance = 1e-10)
+    {
+        if (upper < lower)
+        {
+            std::swap(lower, upper);
+        }
+
+        scan_points = std::max<std::size_t>(scan_points, 3);
+
+        const double step = (upper - lower) / (scan_points - 1);
+        std::vector<double> ys(scan_points);
+
+        parallel::for_chunks(scan_points,
+                             [&] (std::size_t, std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                ys[i] = fun(lower + i * step);
+            }
+        });
+
+        return find_critical_points(fun, lower, step, ys, tolerance);
+    }
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+
+namespace grid
+{
+    // The part of the plane on screen, and pixels per unit on each axis.
+    struct Viewport
+    {
+        asl::mut_f64 x_from;
+        asl::mut_f64 x_to;
+        asl::mut_f64 y_from;
+        asl::mut_f64 y_to;
+
+        asl::mut_f64 x_scale;
+        asl::mut_f64 y_scale;
+    };
+
+    struct GridOptions
+    {
+        // Grid lines are at least this far apart on screen (pixels).
+        asl::mut_f64 min_spacing = 80.0;
+
+        // Tick marks on the axes, and label digits (pixels).
+        asl::mut_f64 tick_size = 4.0;
+        asl::mut_f64 glyph_width = 6.0;
+        asl::mut_f64 glyph_height = 10.0;
+
+        GraphPoint::Color axis_color { 0, 0, 0, 255 };
+        GraphPoint::Color grid_color { 0, 0, 0, 20 };
+        GraphPoint::Color label_color { 0, 0, 0, 160 };
+    };
+
+    // Smallest 1, 2 or 5 times a power of ten not below `step`.
+    inline asl::f64 nice_step(asl::f64 step)
+    {
+        const asl::f64 power = std::pow(10.0, std::floor(std::log10(step)));
+        const asl::f64 fraction = step / power;
+
+        if (fraction <= 1.0)
+        {
+            return power;
+        }
+
+        if (fraction <= 2.0)
+        {
+            return 2.0 * power;
+        }
+
+        if (fraction <= 5.0)
+        {
+            return 5.0 * power;
+        }
+
+        return 10.0 * power;
+    }
+
+    // Label of a tick at `value` on a grid of `step`: as many decimals as
+    // the step needs, or scientific notation for very large or small
+    // values. Returns the length written to `buf`.
+    inline std::size_t format_label(asl::mut_f64 value, asl::f64 step, char (&buf)[32])
+    {
+        // Ticks are multiples of the step: anything smaller is rounding.
+        if (std::abs(value) < step * 1e-6)
+        {
+            value = 0.0;
+        }
+
+        const asl::f64 magnitude = std::max(std::abs(value), step);
+        asl::mut_i32 written = 0;
+
+        if (magnitude >= 1e6 || step < 1e-4)
+        {
+            const auto digits = static_cast<int>(std::floor(std::log10(magnitude)) -
+                                                 std::floor(std::log10(step)));
+            written = std::snprintf(buf, sizeof(buf), "%.*e", std::max(digits, 0), value);
+        }
+        else
+        {
+            const auto decimals = static_cast<int>(std::max(0.0, -std::floor(std::log10(step))));
+            written = std::snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        }
+
+        return (written > 0) ? static_cast<std::size_t>(written) : 0;
+    }
+
+    namespace detail
+    {
+        // Stroke glyphs on a seven-segment layout, 2 cells wide and 4
+        // high: a digit costs at most seven lines.
+        enum Segment : std::uint8_t
+        {
+            Top = 1 << 0,
+            UpperRight = 1 << 1,
+            LowerRight = 1 << 2,
+            Bottom = 1 << 3,
+            LowerLeft = 1 << 4,
+            UpperLeft = 1 << 5,
+            Middle = 1 << 6
+        };
+
+        inline std::uint8_t digit_segments(char c)
+        {
+            switch (c)
+            {
+            case '0': return Top | UpperRight | LowerRight | Bottom | LowerLeft | UpperLeft;
+            case '2': return Top | UpperRight | Middle | LowerLeft | Bottom;
+            case '3': return Top | UpperRight | Middle | LowerRight | Bottom;
+            case '4': return UpperLeft | Middle | UpperRight | LowerRight;
+            case '5': return Top | UpperLeft | Middle | LowerRight | Bottom;
+            case '6': return Top | UpperLeft | Middle | LowerLeft | LowerRight | Bottom;
+            case '7': return Top | UpperRight | LowerRight;
+            case '8': return Top | UpperRight | LowerRight | Bottom | LowerLeft | UpperLeft | Middle;
+            case '9': return Top | UpperRight | LowerRight | Bottom | UpperLeft | Middle;
+            case '-': return Middle;
+            case 'e': return Top | UpperLeft | Middle | LowerLeft | Bottom;
+            default:  return 0;
+            }
+        }
+
+        // Appends line vertices in world coordinates from glyph cells.
+        struct Pen
+        {
+            std::vector<GraphPoint>& out;
+            GraphPoint::Color color;
+
+            asl::mut_f64 x;
+            asl::mut_f64 y;
+            asl::mut_f64 cell_x;
+            asl::mut_f64 cell_y;
+
+            void line(asl::f64 x0, asl::f64 y0, asl::f64 x1, asl::f64 y1)
+            {
+                GraphPoint p;
+                p.color = color;
+
+                p.pos = glm::vec2(x + x0 * cell_x, y + y0 * cell_y);
+                out.push_back(p);
+
+                p.pos = glm::vec2(x + x1 * cell_x, y + y1 * cell_y);
+                out.push_back(p);
+            }
+
+            void glyph(char c)
+            {
+                if (c == '.')
+                {
+                    line(0.75, 0.0, 1.25, 0.0);
+                    return;
+                }
+
+                if (c == '1')
+                {
+                    line(1.0, 0.0, 1.0, 4.0);
+                    return;
+                }
+
+                if (c == '+')
+                {
+                    line(1.0, 1.0, 1.0, 3.0);
+                    line(0.0, 2.0, 2.0, 2.0);
+                    return;
+                }
+
+                const std::uint8_t s = digit_segments(c);
+
+                if (s & Top)        line(0.0, 4.0, 2.0, 4.0);
+                if (s & UpperRight) line(2.0, 4.0, 2.0, 2.0);
+                if (s & LowerRight) line(2.0, 2.0, 2.0, 0.0);
+                if (s & Bottom)     line(0.0, 0.0, 2.0, 0.0);
+                if (s & LowerLeft)  line(0.0, 0.0, 0.0, 2.0);
+                if (s & UpperLeft)  line(0.0, 2.0, 0.0, 4.0);
+                if (s & Middle)     line(0.0, 2.0, 2.0, 2.0);
+            }
+        };
+    }
+
+    // Axes, grid lines and tick labels for the part of the plane in
+    // `view`, as line vertices (GL_LINES) in world coordinates. Only what
+    // is on screen is emitted, at 1, 2 or 5 times a power of ten apart:
+    // the vertex count depends on the size of the window, not on the
+    // extent of the plane or on the zoom.
+    //
+    // Axes out of view leave their labels along the nearest edge.
+    inline void build_grid(const Viewport& view, const GridOptions& opt,
+                           std::vector<GraphPoint>& out)
+    {
+        out.clear();
+
+        const asl::f64 x_step = nice_step(opt.min_spacing / view.x_scale);
+        const asl::f64 y_step = nice_step(opt.min_spacing / view.y_scale);
+
+        // Pixels in world units, on each axis.
+        const asl::f64 px = 1.0 / view.x_scale;
+        const asl::f64 py = 1.0 / view.y_scale;
+
+        const auto segment = [&] (asl::f64 x0, asl::f64 y0, asl::f64 x1, asl::f64 y1,
+                                  GraphPoint::Color color) {
+            GraphPoint p;
+            p.color = color;
+
+            p.pos = glm::vec2(x0, y0);
+            out.push_back(p);
+
+            p.pos = glm::vec2(x1, y1);
+            out.push_back(p);
+        };
+
+        const auto first_x = static_cast<std::int64_t>(std::ceil(view.x_from / x_step));
+        const auto last_x = static_cast<std::int64_t>(std::floor(view.x_to / x_step));
+        const auto first_y = static_cast<std::int64_t>(std::ceil(view.y_from / y_step));
+        const auto last_y = static_cast<std::int64_t>(std::floor(view.y_to / y_step));
+
+        for (auto i = first_x; i <= last_x; ++i)
+        {
+            segment(i * x_step, view.y_from, i * x_step, view.y_to, opt.grid_color);
+        }
+
+        for (auto i = first_y; i <= last_y; ++i)
+        {
+            segment(view.x_from, i * y_step, view.x_to, i * y_step, opt.grid_color);
+        }
+
+        // Where the axes are, or the edge they are beyond.
+        const asl::f64 axis_y = std::clamp(0.0, view.y_from, view.y_to);
+        const asl::f64 axis_x = std::clamp(0.0, view.x_from, view.x_to);
+
+        if (view.y_from <= 0.0 && 0.0 <= view.y_to)
+        {
+            segment(view.x_from, 0.0, view.x_to, 0.0, opt.axis_color);
+        }
+
+        if (view.x_from <= 0.0 && 0.0 <= view.x_to)
+        {
+            segment(0.0, view.y_from, 0.0, view.y_to, opt.axis_color);
+        }
+
+        detail::Pen pen { out, opt.label_color, 0.0, 0.0,
+                          opt.glyph_width / 2.0 * px, opt.glyph_height / 4.0 * py };
+
+        const asl::f64 advance = (opt.glyph_width + 3.0) * px;
+        const asl::f64 gap = (opt.tick_size + 3.0);
+
+        char buf[32];
+
+        // x labels under the x axis, or above the bottom edge.
+        const bool x_labels_below = axis_y - view.y_from >= (gap + opt.glyph_height) * py;
+
+        for (auto i = first_x; i <= last_x; ++i)
+        {
+            const asl::f64 x = i * x_step;
+
+            segment(x, axis_y - opt.tick_size * py, x, axis_y + opt.tick_size * py, opt.axis_color);
+
+            if (i == 0 && view.x_from <= 0.0 && 0.0 <= view.x_to)
+            {
+                // The y axis is in the way; 0 is labelled once, by y.
+                continue;
+            }
+
+            const std::size_t len = format_label(x, x_step, buf);
+
+            pen.x = x - len * advance / 2.0;
+            pen.y = x_labels_below ? axis_y - (gap + opt.glyph_height) * py : axis_y + gap * py;
+
+            for (std::size_t c = 0; c < len; ++c)
+            {
+                pen.glyph(buf[c]);
+                pen.x += advance;
+            }
+        }
+
+        // y labels left of the y axis, or right of the left edge.
+        for (auto i = first_y; i <= last_y; ++i)
+        {
+            const asl::f64 y = i * y_step;
+
+            segment(axis_x - opt.tick_size * px, y, axis_x + opt.tick_size * px, y, opt.axis_color);
+
+            if (i == 0 && !(view.x_from <= 0.0 && 0.0 <= view.x_to))
+            {
+                // Along the left edge it would run into the x labels.
+                continue;
+            }
+
+            const std::size_t len = format_label(y, y_step, buf);
+            const asl::f64 width = len * advance;
+
+            const bool left = axis_x - view.x_from >= width + gap * px;
+
+            pen.x = left ? axis_x - gap * px - width : axis_x + gap * px;
+            pen.y = y - opt.glyph_height / 2.0 * py;
+
+            for (std::size_t c = 0; c < len; ++c)
+            {
+                pen.glyph(buf[c]);
+                pen.x += advance;
+            }
+        }
+    }
+}
@@ -0,0 +1,582 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "asl/types"
+
+#include "spsc_queue.hpp"
+#include "parallel.hpp"
+#include "integration.hpp"
+#include "program.hpp"
+#include "sample_file.hpp"
+#include "instrument.hpp"
+
+namespace batch
+{
+    // One line of a job file: "expression; lower; upper; divisions" and
+    // optionally "; output", where the samples go ("-" for stdout). Outputs
+    // named *.spsm get a sample file (see samplefile), anything else text.
+    struct Job
+    {
+        std::string expression;
+        asl::mut_f64 lower = 0.0;
+        asl::mut_f64 upper = 0.0;
+        std::size_t divisions = 0;
+        std::string output;
+    };
+
+    inline std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        {
+            s.remove_prefix(1);
+        }
+
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+        {
+            s.remove_suffix(1);
+        }
+
+        return s;
+    }
+
+    inline bool parse_job(std::string_view line, Job& job)
+    {
+        std::string_view fields[5];
+        std::size_t count = 0;
+
+        while (count < 5)
+        {
+            const auto end = line.find(';');
+            fields[count++] = trim(line.substr(0, end));
+
+            if (end == std::string_view::npos)
+            {
+                break;
+            }
+
+            line.remove_prefix(end + 1);
+        }
+
+        if (count < 4 || fields[0].empty())
+        {
+            return false;
+        }
+
+        const auto number = [] (std::string_view s, auto& value) {
+            const auto res = std::from_chars(s.data(), s.data() + s.size(), value);
+            return res.ec == std::errc() && res.ptr == s.data() + s.size();
+        };
+
+        job.expression = std::string(fields[0]);
+        job.output = (count == 5) ? std::string(fields[4]) : std::string();
+
+        return number(fields[1], job.lower) && number(fields[2], job.upper) &&
+               number(fields[3], job.divisions) && job.divisions > 0;
+    }
+
+    // Output to a file descriptor through a large buffer, with numbers
+    // formatted by std::to_chars (shortest form that reads back the same
+    // double).
+    class Writer
+    {
+    public:
+        explicit Writer(int fd, bool owned = false, std::size_t capacity = 1 << 20)
+            : m_buffer(capacity),
+              m_fd(fd),
+              m_owned(owned)
+        {
+        }
+
+        // A new file, or stdout for "-". Check valid().
+        static std::unique_ptr<Writer> open(const std::string& path)
+        {
+            if (path == "-")
+            {
+                return std::make_unique<Writer>(STDOUT_FILENO);
+            }
+
+            return std::make_unique<Writer>(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644), true);
+        }
+
+        ~Writer()
+        {
+            flush();
+
+            if (m_owned && m_fd >= 0)
+            {
+                ::close(m_fd);
+            }
+        }
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // False once a write has failed.
+        bool valid() const { return m_fd >= 0 && m_ok; }
+        std::size_t written() const { return m_written + m_used; }
+
+        Writer& put(std::string_view s)
+        {
+            if (m_used + s.size() > m_buffer.size())
+            {
+                flush();
+
+                if (s.size() > m_buffer.size())
+                {
+                    write_all(s.data(), s.size());
+                    return *this;
+                }
+            }
+
+            std::memcpy(m_buffer.data() + m_used, s.data(), s.size());
+            m_used += s.size();
+
+            return *this;
+        }
+
+        Writer& put(char c)
+        {
+            return put(std::string_view(&c, 1));
+        }
+
+        template <typename T>
+        Writer& put_number(T value)
+        {
+            constexpr std::size_t max_length = 32;
+
+            if (m_used + max_length > m_buffer.size())
+            {
+                flush();
+            }
+
+            char* first = m_buffer.data() + m_used;
+            const auto res = std::to_chars(first, first + max_length, value);
+            m_used += res.ptr - first;
+
+            return *this;
+        }
+
+        // Returns false if anything written so far was lost.
+        bool flush()
+        {
+            write_all(m_buffer.data(), m_used);
+            m_written += m_used;
+            m_used = 0;
+
+            return valid();
+        }
+
+    private:
+        void write_all(const char* data, std::size_t size)
+        {
+            while (size > 0 && valid())
+            {
+                const ssize_t n = ::write(m_fd, data, size);
+
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+
+                if (n <= 0)
+                {
+                    m_ok = false;
+                    break;
+                }
+
+                data += n;
+                size -= static_cast<std::size_t>(n);
+            }
+        }
+
+        std::vector<char> m_buffer;
+        std::size_t m_used = 0;
+        std::size_t m_written = 0;
+        int m_fd;
+        bool m_owned;
+        bool m_ok = true;
+    };
+
+    struct Stats
+    {
+        std::size_t jobs = 0;
+        std::size_t failed = 0;
+        std::size_t samples = 0;
+        std::size_t bytes = 0;
+        asl::mut_f64 seconds = 0.0;
+    };
+
+    namespace detail
+    {
+        // Samples evaluated for a job with an output, in order, from the
+        // evaluator to the writer.
+        struct Block
+        {
+            std::vector<double> values;
+            bool last = false;
+        };
+
+        // Samples streamed per block: enough to spread over the threads,
+        // few enough that the blocks in flight stay small.
+        constexpr std::size_t block_samples = 1 << 17;
+        constexpr std::size_t blocks_in_flight = 4;
+
+        struct Task
+        {
+            Job job;
+            const std::string* source = nullptr;
+            std::size_t line = 0;
+            bool valid = false;
+
+            bytecode::Program program;
+
+            // Why the job is not valid.
+            std::string_view error;
+
+            // Set before the last block is sent.
+            integration::Areas areas { 0.0, 0.0 };
+
+            // Only for jobs with an output.
+            std::unique_ptr<concurrency::SpscQueue<Block>> blocks;
+        };
+
+        using TaskPtr = std::unique_ptr<Task>;
+
+        // The grid of a job, lowest limit first like SampleBuffer.
+        struct Grid
+        {
+            asl::mut_f64 lower;
+            asl::mut_f64 upper;
+            asl::mut_f64 step;
+            std::size_t count;
+        };
+
+        inline Grid grid(const Job& job)
+        {
+            const double lower = std::min(job.lower, job.upper);
+            const double upper = std::max(job.lower, job.upper);
+
+            return Grid { lower, upper, (upper - lower) / job.divisions, job.divisions + 1 };
+        }
+
+        // A null task marks the end of the stream.
+        template <typename T>
+        void push(concurrency::SpscQueue<T>& queue, T item)
+        {
+            while (!queue.try_push(std::move(item)))
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        template <typename T>
+        T pop(concurrency::SpscQueue<T>& queue)
+        {
+            T item;
+
+            while (!queue.try_pop(item))
+            {
+                std::this_thread::yield();
+            }
+
+            return item;
+        }
+
+        // Evaluates the samples of `task` block by block into its queue,
+        // summing both areas on the way.
+        inline void stream_samples(Task& task)
+        {
+            const Grid g = grid(task.job);
+            const auto& program = task.program;
+
+            const instrument::Scope scope("sample", g.count);
+
+            asl::mut_f64 right = 0.0;
+            asl::mut_f64 both = 0.0;
+
+            for (std::size_t first = 0; first < g.count; first += block_samples)
+            {
+                Block block;
+                block.values.resize(std::min(block_samples, g.count - first));
+
+                parallel::for_chunks(block.values.size(), [&] (std::size_t, std::size_t begin, std::size_t end) {
+                    program.evaluate_grid(g.lower + (first + begin) * g.step, g.step, end - begin,
+                                          block.values.data() + begin);
+                });
+
+                for (std::size_t j = 0; j < block.values.size(); ++j)
+                {
+                    const std::size_t i = first + j;
+                    const double y = block.values[j];
+
+                    right += (i > 0) ? y : 0.0;
+                    both += (i == 0 || i == g.count - 1) ? y : 2.0 * y;
+                }
+
+                block.last = first + block.values.size() == g.count;
+
+                if (block.last)
+                {
+                    task.areas = integration::Areas { right * g.step, both * 0.5 * g.step };
+                }
+
+                push(*task.blocks, std::move(block));
+            }
+        }
+
+        // Writes the samples of `task` as they are streamed in, to its
+        // output or to `out` for "-". The blocks are drained even if the
+        // output cannot be written. Returns false on I/O errors.
+        inline bool write_samples(Task& task, Writer& out, Stats& stats)
+        {
+            const Job& job = task.job;
+            const Grid g = grid(job);
+
+            std::unique_ptr<samplefile::StreamWriter> sample_file;
+            std::unique_ptr<Writer> file;
+            Writer* dst = &out;
+
+            if (samplefile::has_extension(job.output))
+            {
+                const samplefile::Info info { job.expression, g.lower, g.upper, g.step };
+                sample_file = std::make_unique<samplefile::StreamWriter>(job.output, info, g.count);
+            }
+            else if (job.output != "-")
+            {
+                file = Writer::open(job.output);
+                dst = file.get();
+            }
+
+            std::size_t index = 0;
+            Block block;
+
+            do
+            {
+                block = pop(*task.blocks);
+
+                if (sample_file)
+                {
+                    sample_file->put(block.values.data(), block.values.size());
+                }
+                else if (dst->valid())
+                {
+                    for (const double y : block.values)
+                    {
+                        dst->put_number(g.lower + index++ * g.step).put('\t').put_number(y).put('\n');
+                    }
+                }
+            } while (!block.last);
+
+            bool ok = false;
+
+            if (sample_file)
+            {
+                ok = sample_file->finish();
+                stats.bytes += ok ? samplefile::file_size({ job.expression }, g.count, false) : 0;
+            }
+            else
+            {
+                ok = dst->flush();
+                stats.bytes += file ? file->written() : 0;
+            }
+
+            stats.samples += ok ? g.count : 0;
+
+            return ok;
+        }
+    }
+
+    // Runs the jobs in `lines` and then those in `job_file` ("-" for
+    // stdin, "" for none) through three stages, each on its own thread so
+    // they overlap from one job to the next:
+    //
+    //  - read: parses job lines and compiles the expressions;
+    //  - evaluate: integrates f with the batch evaluator, without keeping
+    //    the samples unless the job has an output;
+    //  - write (the calling thread): the samples to the job's output, if
+    //    any, as the evaluator streams them, then one summary line per job
+    //    on stdout.
+    //
+    // Only a few jobs, and a few blocks of samples, are in flight at once,
+    // so memory stays bounded whatever the divisions. Bad lines and
+    // outputs that cannot be written fail their job and are reported on
+    // stderr.
+    inline Stats run(const std::vector<std::string>& lines, const std::string& job_file)
+    {
+        using detail::Task;
+        using detail::TaskPtr;
+
+        constexpr std::size_t in_flight = 4;
+
+        concurrency::SpscQueue<TaskPtr> parsed(in_flight);
+        concurrency::SpscQueue<TaskPtr> evaluated(in_flight);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        const std::string arguments = "job argument";
+
+        std::thread reader([&] {
+            instrument::name_thread("batch reader");
+
+            const std::string* source = &arguments;
+            std::size_t line_number = 0;
+
+            const auto submit = [&] (const std::string& line) {
+                ++line_number;
+
+                const auto text = trim(line);
+
+                if (text.empty() || text.front() == '#')
+                {
+                    return;
+                }
+
+                auto task = std::make_unique<Task>();
+                task->source = source;
+                task->line = line_number;
+                task->valid = parse_job(text, task->job);
+
+                if (!task->valid)
+                {
+                    task->error = "expected \"expression; lower; upper; divisions[; output]\"";
+                }
+                else
+                {
+                    task->program = bytecode::compile(task->job.expression);
+                    task->valid = task->program.valid();
+                    task->error = "cannot parse the expression";
+                }
+
+                detail::push(parsed, std::move(task));
+            };
+
+            for (const auto& line : lines)
+            {
+                submit(line);
+            }
+
+            if (!job_file.empty())
+            {
+                source = &job_file;
+                line_number = 0;
+
+                std::ifstream file;
+
+                if (job_file != "-")
+                {
+                    file.open(job_file);
+
+                    if (!file)
+                    {
+                        std::cerr << "Cannot read " << job_file << '\n';
+                    }
+                }
+
+                std::istream& in = (job_file == "-") ? std::cin : file;
+
+                for (std::string line; std::getline(in, line); )
+                {
+                    submit(line);
+                }
+            }
+
+            detail::push(parsed, TaskPtr{});
+        });
+
+        std::thread evaluator([&] {
+            instrument::name_thread("batch evaluator");
+
+            while (TaskPtr task = detail::pop(parsed))
+            {
+                if (!task->valid)
+                {
+                    detail::push(evaluated, std::move(task));
+                    continue;
+                }
+
+                const auto g = detail::grid(task->job);
+
+                if (task->job.output.empty())
+                {
+                    task->areas = integration::program_area(task->program, g.lower, g.upper,
+                                                            task->job.divisions);
+                    detail::push(evaluated, std::move(task));
+                    continue;
+                }
+
+                // The writer owns the task from here, but keeps it until
+                // the last block.
+                task->blocks = std::make_unique<concurrency::SpscQueue<detail::Block>>(detail::blocks_in_flight);
+
+                Task& streamed = *task;
+                detail::push(evaluated, std::move(task));
+                detail::stream_samples(streamed);
+            }
+
+            detail::push(evaluated, TaskPtr{});
+        });
+
+        Stats stats;
+        Writer out(STDOUT_FILENO);
+
+        out.put("# expression\tlower\tupper\tdivisions\trectangles\ttrapezoids\n");
+
+        while (TaskPtr task = detail::pop(evaluated))
+        {
+            ++stats.jobs;
+
+            if (!task->valid)
+            {
+                ++stats.failed;
+                std::cerr << *task->source << ':' << task->line << ": " << task->error << '\n';
+                continue;
+            }
+
+            const Job& job = task->job;
+            const bool written = job.output.empty() || detail::write_samples(*task, out, stats);
+
+            out.put(job.expression).put('\t')
+               .put_number(job.lower).put('\t')
+               .put_number(job.upper).put('\t')
+               .put_number(job.divisions).put('\t')
+               .put_number(task->areas.rectangles).put('\t')
+               .put_number(task->areas.trapezoids).put('\n');
+
+            if (!written)
+            {
+                ++stats.failed;
+                std::cerr << *task->source << ':' << task->line << ": cannot write " << job.output << '\n';
+            }
+        }
+
+        reader.join();
+        evaluator.join();
+
+        if (!out.flush())
+        {
+            ++stats.failed;
+            std::cerr << "Cannot write the results to stdout\n";
+        }
+
+        stats.bytes += out.written();
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return stats;
+    }
+}
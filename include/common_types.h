@@ -1,5 +1,7 @@
 #pragma once
 
+#include <ostream>
+
 namespace types
 {
     enum class Operators
@@ -21,13 +23,13 @@ namespace types
         Sqrt, Cbrt
     };
 
-    std::ostream& operator<<(std::ostream& out, types::Operators op)
+    inline std::ostream& operator<<(std::ostream& out, types::Operators op)
     {
         out << (int)op;
         return out;
     }
 
-    std::ostream& operator<<(std::ostream& out, types::Functions fun)
+    inline std::ostream& operator<<(std::ostream& out, types::Functions fun)
     {
         out << (int)fun;
         return out;
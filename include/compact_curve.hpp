@@ -0,0 +1,262 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+
+// Curve sampled at x_i = origin + i * step, stored as its y values only.
+// Position and colour are rebuilt per vertex from the index and a few
+// per-curve values (uniforms on the GPU), so a vertex takes 4 or 2 bytes
+// instead of the 12 of a GraphPoint.
+//
+// Quantized curves store y as 16-bit fractions of [y_offset, y_offset +
+// y_scale]; float curves store y itself, with offset 0 and scale 1.
+// Undefined values are left out of `strips`, so they are never drawn.
+struct CompactView;
+
+struct CompactCurve
+{
+    // Double is only found in views of data stored elsewhere, such as
+    // a mapped sample file.
+    enum class Format
+    {
+        Float,
+        Quantized16,
+        Double
+    };
+
+    Format format = Format::Float;
+
+    asl::mut_f32 origin = 0.0f;
+    asl::mut_f32 step = 1.0f;
+    asl::mut_f32 y_offset = 0.0f;
+    asl::mut_f32 y_scale = 1.0f;
+
+    GraphPoint::Color color { 0, 0, 0, 255 };
+
+    std::vector<asl::mut_f32> y_float;
+    std::vector<std::uint16_t> y_quantized;
+
+    StripList strips;
+
+    std::size_t size() const
+    {
+        return (format == Format::Float) ? y_float.size() : y_quantized.size();
+    }
+
+    std::size_t bytes() const
+    {
+        return (format == Format::Float) ? y_float.size() * sizeof(float)
+                                         : y_quantized.size() * sizeof(std::uint16_t);
+    }
+
+    const void* data() const
+    {
+        return (format == Format::Float) ? static_cast<const void*>(y_float.data())
+                                         : static_cast<const void*>(y_quantized.data());
+    }
+
+    CompactView view() const;
+
+    asl::mut_f32 x(std::size_t i) const;
+    asl::mut_f32 y(std::size_t i) const;
+    GraphPoint vertex(std::size_t i) const;
+
+    // Parts of `strips` within vertices [first, last].
+    void clip_strips(std::size_t first, std::size_t last, StripList& out) const
+    {
+        out.clear();
+
+        for (std::size_t i = 0; i < strips.size(); ++i)
+        {
+            const auto begin = std::max<std::size_t>(strips.first[i], first);
+            const auto end = std::min<std::size_t>(strips.first[i] + strips.count[i], last + 1);
+
+            if (begin < end)
+            {
+                out.push_back(static_cast<asl::mut_i32>(begin), static_cast<asl::mut_i32>(end - begin));
+            }
+        }
+    }
+
+    // Packs `count` values sampled from `origin` every `step`. The 16-bit
+    // format is used when its rounding error, half a quantization step,
+    // stays within `max_error` (world units).
+    static CompactCurve from_samples(asl::f64 origin, asl::f64 step,
+                                     const double* ys, std::size_t count,
+                                     GraphPoint::Color color, asl::f64 max_error)
+    {
+        CompactCurve curve;
+        curve.origin = static_cast<float>(origin);
+        curve.step = static_cast<float>(step);
+        curve.color = color;
+
+        asl::mut_f64 lo = std::numeric_limits<double>::infinity();
+        asl::mut_f64 hi = -std::numeric_limits<double>::infinity();
+        bool open = false;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!std::isfinite(ys[i]))
+            {
+                open = false;
+                continue;
+            }
+
+            lo = std::min(lo, ys[i]);
+            hi = std::max(hi, ys[i]);
+
+            if (!open)
+            {
+                curve.strips.push_back(static_cast<asl::mut_i32>(i), 0);
+                open = true;
+            }
+
+            ++curve.strips.count.back();
+        }
+
+        const bool any = lo <= hi;
+        const asl::f64 range = any ? hi - lo : 0.0;
+
+        if (any && range / 65535.0 / 2.0 <= max_error)
+        {
+            curve.format = Format::Quantized16;
+            curve.y_offset = static_cast<float>(lo);
+            curve.y_scale = static_cast<float>(range);
+            curve.y_quantized.resize(count, 0);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (std::isfinite(ys[i]) && range > 0.0)
+                {
+                    curve.y_quantized[i] = static_cast<std::uint16_t>(
+                        std::lround((ys[i] - lo) / range * 65535.0));
+                }
+            }
+        }
+        else
+        {
+            curve.y_float.resize(count);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                curve.y_float[i] = static_cast<float>(ys[i]);
+            }
+        }
+
+        return curve;
+    }
+};
+
+// The y array of a compact curve and the values to rebuild its vertices,
+// without owning the array: what the renderers need, whether the data
+// is in a CompactCurve or somewhere else.
+struct CompactView
+{
+    CompactCurve::Format format = CompactCurve::Format::Float;
+
+    asl::mut_f32 origin = 0.0f;
+    asl::mut_f32 step = 1.0f;
+    asl::mut_f32 y_offset = 0.0f;
+    asl::mut_f32 y_scale = 1.0f;
+
+    GraphPoint::Color color { 0, 0, 0, 255 };
+
+    const void* data = nullptr;
+    std::size_t count = 0;
+
+    std::size_t size() const { return count; }
+
+    std::size_t bytes() const
+    {
+        switch (format)
+        {
+        case CompactCurve::Format::Quantized16: return count * sizeof(std::uint16_t);
+        case CompactCurve::Format::Double:      return count * sizeof(double);
+        default:                                return count * sizeof(float);
+        }
+    }
+
+    // Same arithmetic as the vertex shader.
+    asl::mut_f32 x(std::size_t i) const
+    {
+        return origin + static_cast<float>(i) * step;
+    }
+
+    asl::mut_f32 y(std::size_t i) const
+    {
+        switch (format)
+        {
+        case CompactCurve::Format::Quantized16:
+            return y_offset + (static_cast<const std::uint16_t*>(data)[i] / 65535.0f) * y_scale;
+
+        case CompactCurve::Format::Double:
+            return y_offset + static_cast<float>(static_cast<const double*>(data)[i]) * y_scale;
+
+        default:
+            return y_offset + static_cast<const float*>(data)[i] * y_scale;
+        }
+    }
+
+    GraphPoint vertex(std::size_t i) const
+    {
+        GraphPoint v;
+        v.pos.x = x(i);
+        v.pos.y = y(i);
+        v.color = color;
+
+        return v;
+    }
+
+    // Runs of defined values, as strips.
+    void finite_strips(StripList& out) const
+    {
+        out.clear();
+
+        bool open = false;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!std::isfinite(y(i)))
+            {
+                open = false;
+                continue;
+            }
+
+            if (!open)
+            {
+                out.push_back(static_cast<asl::mut_i32>(i), 0);
+                open = true;
+            }
+
+            ++out.count.back();
+        }
+    }
+};
+
+inline CompactView CompactCurve::view() const
+{
+    return CompactView { format, origin, step, y_offset, y_scale, color, data(), size() };
+}
+
+inline asl::mut_f32 CompactCurve::x(std::size_t i) const
+{
+    return view().x(i);
+}
+
+inline asl::mut_f32 CompactCurve::y(std::size_t i) const
+{
+    return view().y(i);
+}
+
+inline GraphPoint CompactCurve::vertex(std::size_t i) const
+{
+    return view().vertex(i);
+}
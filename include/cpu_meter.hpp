@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+
+namespace stats
+{
+    // Process CPU time (all threads) against wall time, summed over the
+    // intervals between start() and stop().
+    class CpuMeter
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        void start()
+        {
+            m_cpuStart = std::clock();
+            m_wallStart = Clock::now();
+        }
+
+        void stop()
+        {
+            m_cpu += static_cast<double>(std::clock() - m_cpuStart) / CLOCKS_PER_SEC;
+            m_wall += std::chrono::duration<double>(Clock::now() - m_wallStart).count();
+        }
+
+        double cpu_seconds() const { return m_cpu; }
+        double wall_seconds() const { return m_wall; }
+
+        // Fraction of one core used while measuring.
+        double usage() const
+        {
+            return (m_wall > 0.0) ? m_cpu / m_wall : 0.0;
+        }
+
+    private:
+        std::clock_t m_cpuStart = 0;
+        Clock::time_point m_wallStart;
+
+        double m_cpu = 0.0;
+        double m_wall = 0.0;
+    };
+}
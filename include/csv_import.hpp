@@ -0,0 +1,312 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+#include "instrument.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "stream_reader.hpp"
+
+namespace csv
+{
+    struct ImportOptions
+    {
+        GraphPoint::Color color { 0, 128, 0, 255 };
+
+        // Also integrate the samples, in file order, by the trapezoid rule.
+        bool integrate = false;
+    };
+
+    struct ImportStats
+    {
+        std::size_t bytes = 0;
+        std::size_t samples = 0;
+        std::size_t rejected = 0;
+
+        // Size of the parsed vertices: the memory the import keeps.
+        std::size_t vertex_bytes = 0;
+
+        asl::mut_f64 seconds = 0.0;
+
+        asl::mut_f64 mb_per_second() const
+        {
+            return bytes / 1e6 / std::max(seconds, 1e-9);
+        }
+    };
+
+    struct Imported
+    {
+        Curve curve;
+        ImportStats stats;
+
+        // Trapezoid integral of y over x, if asked for.
+        asl::mut_f64 area = 0.0;
+    };
+
+    namespace detail
+    {
+        // What a chunk of the file holds, once parsed.
+        struct Chunk
+        {
+            const char* begin = nullptr;
+            const char* end = nullptr;
+
+            // Vertices from `first` on in the output, `count` of them used.
+            std::size_t first = 0;
+            std::size_t count = 0;
+            std::size_t rejected = 0;
+
+            // Trapezoids between the chunk's own samples, in double; the
+            // ones between chunks are added when joining them.
+            asl::mut_f64 area = 0.0;
+            bool integrated = false;
+            asl::mut_f64 first_x = 0.0;
+            asl::mut_f64 first_y = 0.0;
+            asl::mut_f64 last_x = 0.0;
+            asl::mut_f64 last_y = 0.0;
+        };
+
+        inline const char* next_line(const char* p, const char* end)
+        {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            return nl ? nl + 1 : end;
+        }
+
+        inline bool single_column(const char* p, const char* end)
+        {
+            while (p != end)
+            {
+                const char* next = next_line(p, end);
+
+                double first = 0.0;
+                double second = 0.0;
+                const int fields = streaming::parse_fields(p, next, first, second);
+
+                if (fields > 0)
+                {
+                    return fields == 1;
+                }
+
+                p = next;
+            }
+
+            return false;
+        }
+
+        // Undefined samples are left out, so the trapezoid spans them.
+        inline void accumulate(Chunk& chunk, asl::f64 x, asl::f64 y)
+        {
+            if (!std::isfinite(x) || !std::isfinite(y))
+            {
+                return;
+            }
+
+            if (!chunk.integrated)
+            {
+                chunk.first_x = x;
+                chunk.first_y = y;
+                chunk.integrated = true;
+            }
+            else
+            {
+                chunk.area += (x - chunk.last_x) * (chunk.last_y + y) / 2.0;
+            }
+
+            chunk.last_x = x;
+            chunk.last_y = y;
+        }
+    }
+
+    // Imports "x, y" samples from a text file (any of the separators of
+    // streaming::parse_fields, "#" comments; a file of single values gets
+    // their index as x) into `out.curve`, ready to be drawn as strips.
+    //
+    // The file is mapped and split into one chunk per thread at line
+    // boundaries. Every chunk counts its lines, which places it in a
+    // vertex array allocated once, and then parses itself with
+    // std::from_chars straight into its part of the array. Chunks are
+    // then moved together over the slots of rejected lines. Nothing but
+    // the vertices is allocated per sample, so memory use is about their
+    // size: the mapped file lives in the page cache.
+    inline bool import(const std::string& path, const ImportOptions& opt, Imported& out)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        instrument::Scope scope("csv_import");
+
+        out = Imported {};
+
+        const MappedFile file(path);
+
+        if (!file.valid())
+        {
+            return false;
+        }
+
+        const char* const data = file.data();
+        const char* const data_end = data + file.size();
+
+        const std::size_t threads = parallel::thread_count();
+        std::vector<detail::Chunk> chunks(threads);
+
+        for (std::size_t i = 0; i < threads; ++i)
+        {
+            const char* begin = (i == 0) ? data : chunks[i - 1].end;
+            const char* end = (i + 1 == threads) ? data_end
+                            : std::max(begin, data + file.size() / threads * (i + 1));
+
+            chunks[i].begin = begin;
+            chunks[i].end = (end == data_end) ? end : detail::next_line(end, data_end);
+        }
+
+        // At most one sample per line, and one more for a last line
+        // without a newline.
+        parallel::for_chunks(threads, threads, [&] (std::size_t i, std::size_t, std::size_t)
+        {
+            detail::Chunk& chunk = chunks[i];
+            std::size_t lines = 0;
+
+            for (const char* p = chunk.begin; p != chunk.end; p = detail::next_line(p, chunk.end))
+            {
+                ++lines;
+            }
+
+            chunk.count = lines;
+        });
+
+        std::size_t total = 0;
+
+        for (auto& chunk : chunks)
+        {
+            chunk.first = total;
+            total += chunk.count;
+            chunk.count = 0;
+        }
+
+        auto& vertices = out.curve.vertices;
+        vertices.resize(total);
+
+        const bool indexed = detail::single_column(data, data_end);
+
+        parallel::for_chunks(threads, threads, [&] (std::size_t i, std::size_t, std::size_t)
+        {
+            detail::Chunk& chunk = chunks[i];
+            GraphPoint* dst = vertices.data() + chunk.first;
+
+            for (const char* p = chunk.begin; p != chunk.end; )
+            {
+                const char* next = detail::next_line(p, chunk.end);
+
+                double x = 0.0;
+                double y = 0.0;
+                const int fields = streaming::parse_fields(p, next, x, y);
+
+                p = next;
+
+                if (fields == 0)
+                {
+                    continue;
+                }
+
+                if (fields != (indexed ? 1 : 2))
+                {
+                    ++chunk.rejected;
+                    continue;
+                }
+
+                if (indexed)
+                {
+                    // The index within the chunk, until the chunks are joined.
+                    y = x;
+                    x = static_cast<double>(chunk.count);
+                }
+
+                GraphPoint& v = dst[chunk.count++];
+                v.pos = glm::vec2(x, y);
+                v.color = opt.color;
+
+                if (opt.integrate)
+                {
+                    detail::accumulate(chunk, x, y);
+                }
+            }
+        });
+
+        // Joins the chunks, in place, and finds the runs of defined values.
+        std::size_t used = 0;
+        bool open = false;
+        bool have_last = false;
+        asl::mut_f64 last_x = 0.0;
+        asl::mut_f64 last_y = 0.0;
+
+        for (auto& chunk : chunks)
+        {
+            if (chunk.first != used)
+            {
+                std::memmove(vertices.data() + used, vertices.data() + chunk.first,
+                             chunk.count * sizeof(GraphPoint));
+            }
+
+            for (std::size_t j = used; j < used + chunk.count; ++j)
+            {
+                GraphPoint& v = vertices[j];
+
+                if (indexed)
+                {
+                    v.pos.x = static_cast<float>(j);
+                }
+
+                if (!std::isfinite(v.pos.x) || !std::isfinite(v.pos.y))
+                {
+                    open = false;
+                    continue;
+                }
+
+                if (!open)
+                {
+                    out.curve.strips.push_back(static_cast<asl::mut_i32>(j), 0);
+                    open = true;
+                }
+
+                ++out.curve.strips.count.back();
+            }
+
+            if (chunk.integrated)
+            {
+                const asl::f64 shift = indexed ? static_cast<double>(used) : 0.0;
+
+                if (have_last)
+                {
+                    out.area += (chunk.first_x + shift - last_x) * (last_y + chunk.first_y) / 2.0;
+                }
+
+                out.area += chunk.area;
+                last_x = chunk.last_x + shift;
+                last_y = chunk.last_y;
+                have_last = true;
+            }
+
+            used += chunk.count;
+            out.stats.rejected += chunk.rejected;
+        }
+
+        vertices.resize(used);
+
+        out.stats.bytes = file.size();
+        out.stats.samples = used;
+        scope.set_ops(used);
+        out.stats.vertex_bytes = vertices.capacity() * sizeof(GraphPoint);
+        out.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+}
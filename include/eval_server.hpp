@@ -0,0 +1,840 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "asl/types"
+
+#include "integration.hpp"
+#include "parallel.hpp"
+#include "program.hpp"
+#include "instrument.hpp"
+
+// Evaluation over a Unix domain socket, for callers that make many small
+// requests and should not pay for starting a process, or for compiling
+// the same expression, every time.
+//
+// Every message is a frame: a RequestHeader or a ReplyHeader, then
+// `length` bytes, in the byte order of the host (the socket is local).
+// A request carries its expression text and then, for
+//
+//  - Evaluate: `count` x values (double);
+//  - Sample:   lower, upper (double) and divisions (u64);
+//  - Integrate: the same as Sample.
+//
+// The reply has the same id and `count` doubles: f(x) for each x,
+// the divisions + 1 samples, or the rectangle and trapezoid areas.
+// Replies to one connection come in the order of its requests. Requests
+// over the limits below get TooLarge, and text that is not an expression
+// BadRequest.
+namespace service
+{
+    enum class Op : std::uint8_t
+    {
+        Evaluate = 1,
+        Sample = 2,
+        Integrate = 3
+    };
+
+    enum class Status : std::uint8_t
+    {
+        Ok = 0,
+        BadRequest = 1,
+        TooLarge = 2
+    };
+
+    struct RequestHeader
+    {
+        std::uint32_t length;
+        std::uint32_t id;
+        Op op;
+        std::uint8_t reserved[3];
+        std::uint32_t expression_size;
+    };
+
+    struct ReplyHeader
+    {
+        std::uint32_t length;
+        std::uint32_t id;
+        Status status;
+        std::uint8_t reserved[3];
+        std::uint32_t count;
+    };
+
+    struct Range
+    {
+        double lower;
+        double upper;
+        std::uint64_t divisions;
+    };
+
+    static_assert(sizeof(RequestHeader) == 16 && sizeof(ReplyHeader) == 16 && sizeof(Range) == 24,
+                  "the frame layout is part of the protocol");
+
+    // Largest frame either way, and so the most samples in a reply.
+    constexpr std::size_t max_frame = std::size_t(1) << 27;
+    constexpr std::size_t max_values = (max_frame - sizeof(ReplyHeader)) / sizeof(double);
+
+    // Most divisions of an Integrate request. Requests are answered on
+    // the thread that polls, so none may hold it for more than about a
+    // second.
+    constexpr std::uint64_t max_divisions = std::uint64_t(1) << 28;
+
+    // Input and unsent replies kept per client. A client is not read while
+    // its input is full, and its requests wait while their replies would
+    // not fit, so a client that sends faster than it reads is slowed down
+    // to its own pace.
+    constexpr std::size_t max_input = max_frame + sizeof(RequestHeader);
+    constexpr std::size_t max_backlog = max_frame;
+
+    namespace detail
+    {
+        inline bool make_address(const std::string& path, sockaddr_un& addr)
+        {
+            if (path.size() >= sizeof(addr.sun_path))
+            {
+                return false;
+            }
+
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.data(), path.size());
+
+            return true;
+        }
+
+        template <typename T>
+        void append(std::vector<char>& out, const T& value)
+        {
+            const char* p = reinterpret_cast<const char*>(&value);
+            out.insert(out.end(), p, p + sizeof(T));
+        }
+    }
+
+    // Compiled programs by expression text. The table is small and
+    // requests name a handful of expressions, so it is emptied when full
+    // rather than tracking what was used last.
+    class ProgramCache
+    {
+    public:
+        explicit ProgramCache(std::size_t capacity = 1024)
+            : m_capacity(capacity)
+        {
+        }
+
+        // Text that does not parse gets an invalid program, kept like
+        // the others so it is not parsed again.
+        const bytecode::Program& get(std::string_view expression)
+        {
+            m_key.assign(expression.data(), expression.size());
+
+            auto it = m_programs.find(m_key);
+
+            if (it != m_programs.end())
+            {
+                ++m_hits;
+                return it->second;
+            }
+
+            if (m_programs.size() >= m_capacity)
+            {
+                m_programs.clear();
+            }
+
+            ++m_misses;
+            return m_programs.emplace(m_key, bytecode::compile(m_key)).first->second;
+        }
+
+        std::size_t hits() const { return m_hits; }
+        std::size_t misses() const { return m_misses; }
+
+    private:
+        std::unordered_map<std::string, bytecode::Program> m_programs;
+        std::string m_key;
+        std::size_t m_capacity;
+        std::size_t m_hits = 0;
+        std::size_t m_misses = 0;
+    };
+
+    struct ServerStats
+    {
+        std::size_t connections = 0;
+        std::size_t requests = 0;
+        std::size_t rejected = 0;
+
+        // Evaluate requests that shared one call of the evaluator with
+        // others for the same expression.
+        std::size_t batched = 0;
+    };
+
+    // Serves requests on a single thread with poll(); only sampling and
+    // integration of large ranges are spread over more threads.
+    //
+    // Every round reads whatever all clients have sent, then answers the
+    // requests by expression: each program is looked up once per round,
+    // and the x values of all Evaluate requests for it go through the
+    // evaluator in one call.
+    class Server
+    {
+    public:
+        // Listens on `path`, replacing a stale socket file. Check valid().
+        explicit Server(const std::string& path)
+            : m_path(path)
+        {
+            sockaddr_un addr;
+
+            if (!detail::make_address(path, addr))
+            {
+                return;
+            }
+
+            m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+            if (m_fd < 0)
+            {
+                return;
+            }
+
+            ::unlink(path.c_str());
+
+            if (::bind(m_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+                ::listen(m_fd, 64) != 0)
+            {
+                ::close(m_fd);
+                m_fd = -1;
+            }
+        }
+
+        ~Server()
+        {
+            for (auto& c : m_clients)
+            {
+                ::close(c.fd);
+            }
+
+            if (m_fd >= 0)
+            {
+                ::close(m_fd);
+                ::unlink(m_path.c_str());
+            }
+        }
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        bool valid() const { return m_fd >= 0; }
+
+        const ServerStats& stats() const { return m_stats; }
+        const ProgramCache& programs() const { return m_programs; }
+
+        // Serves until `stop` is set; it is looked at every 100 ms.
+        void run(const std::atomic<bool>& stop)
+        {
+            constexpr int poll_interval = 100; // ms
+
+            std::vector<pollfd> fds;
+
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                fds.clear();
+                fds.push_back({ m_fd, POLLIN, 0 });
+
+                for (const auto& c : m_clients)
+                {
+                    const bool pending = c.sent < c.out.size();
+                    const bool full = c.in.size() >= max_input;
+                    fds.push_back({ c.fd, static_cast<short>((full ? 0 : POLLIN) | (pending ? POLLOUT : 0)), 0 });
+                }
+
+                if (::poll(fds.data(), fds.size(), poll_interval) <= 0)
+                {
+                    continue;
+                }
+
+                for (std::size_t i = 0; i < m_clients.size(); ++i)
+                {
+                    const short events = fds[i + 1].revents;
+
+                    if (events & (POLLIN | POLLHUP | POLLERR))
+                    {
+                        receive(m_clients[i]);
+                    }
+                }
+
+                if (fds[0].revents & POLLIN)
+                {
+                    accept_clients();
+                }
+
+                {
+                    const instrument::Scope scope("serve_round");
+                    serve();
+                }
+
+                for (auto& c : m_clients)
+                {
+                    send(c);
+                }
+
+                m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(), [] (const Client& c) {
+                    if (c.closed && c.sent == c.out.size())
+                    {
+                        ::close(c.fd);
+                        return true;
+                    }
+
+                    return false;
+                }), m_clients.end());
+            }
+        }
+
+    private:
+        struct Client
+        {
+            int fd = -1;
+            std::vector<char> in;
+            std::vector<char> out;
+            std::size_t sent = 0;
+            bool closed = false;
+        };
+
+        // A request of this round. The payload stays in the input buffer
+        // of its client until the round is over.
+        struct Pending
+        {
+            std::size_t client;
+            RequestHeader header;
+            std::string_view expression;
+            const char* payload;
+            std::size_t payload_size;
+        };
+
+        void accept_clients()
+        {
+            for (;;)
+            {
+                const int fd = ::accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                if (fd < 0)
+                {
+                    break;
+                }
+
+                Client c;
+                c.fd = fd;
+                m_clients.push_back(std::move(c));
+                ++m_stats.connections;
+            }
+        }
+
+        void receive(Client& c)
+        {
+            while (!c.closed && c.in.size() < max_input)
+            {
+                const std::size_t used = c.in.size();
+                const std::size_t read_size = std::min<std::size_t>(1 << 16, max_input - used);
+                c.in.resize(used + read_size);
+
+                const ssize_t n = ::read(c.fd, c.in.data() + used, read_size);
+                c.in.resize(used + std::max<ssize_t>(n, 0));
+
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                    c.closed = true;
+                }
+
+                if (n < static_cast<ssize_t>(read_size))
+                {
+                    break;
+                }
+            }
+        }
+
+        void send(Client& c)
+        {
+            while (c.sent < c.out.size())
+            {
+                const ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+
+                if (n <= 0)
+                {
+                    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    {
+                        // The peer is gone: drop what it was owed.
+                        c.closed = true;
+                        c.sent = c.out.size();
+                    }
+
+                    break;
+                }
+
+                c.sent += static_cast<std::size_t>(n);
+            }
+
+            if (c.sent == c.out.size())
+            {
+                c.out.clear();
+                c.sent = 0;
+            }
+        }
+
+        // Splits the input of every client into requests, answers them,
+        // and drops the requests from the input.
+        void serve()
+        {
+            m_pending.clear();
+            m_consumed.assign(m_clients.size(), 0);
+
+            for (std::size_t i = 0; i < m_clients.size(); ++i)
+            {
+                Client& c = m_clients[i];
+                std::size_t offset = 0;
+                std::size_t backlog = c.out.size() - c.sent;
+
+                while (c.in.size() - offset >= sizeof(RequestHeader))
+                {
+                    RequestHeader header;
+                    std::memcpy(&header, c.in.data() + offset, sizeof(header));
+
+                    if (header.length > max_frame || header.expression_size > header.length)
+                    {
+                        // Out of step with the client: nothing after this can be read.
+                        c.closed = true;
+                        offset = c.in.size();
+                        ++m_stats.rejected;
+                        break;
+                    }
+
+                    if (c.in.size() - offset - sizeof(RequestHeader) < header.length)
+                    {
+                        break;
+                    }
+
+                    const char* body = c.in.data() + offset + sizeof(RequestHeader);
+
+                    const Pending p { i, header, std::string_view(body, header.expression_size),
+                                      body + header.expression_size,
+                                      header.length - header.expression_size };
+
+                    // The rest waits for the client to read its replies.
+                    const std::size_t reply = reply_size(p);
+
+                    if (backlog > 0 && backlog + reply > max_backlog)
+                    {
+                        break;
+                    }
+
+                    backlog += reply;
+                    m_pending.push_back(p);
+
+                    offset += sizeof(RequestHeader) + header.length;
+                }
+
+                m_consumed[i] = offset;
+            }
+
+            // Same expressions together, in arrival order otherwise.
+            m_order.resize(m_pending.size());
+
+            for (std::size_t i = 0; i < m_order.size(); ++i)
+            {
+                m_order[i] = i;
+            }
+
+            std::stable_sort(m_order.begin(), m_order.end(), [this] (std::size_t a, std::size_t b) {
+                return m_pending[a].expression < m_pending[b].expression;
+            });
+
+            m_replies.assign(m_pending.size(), Reply {});
+
+            for (std::size_t first = 0; first < m_order.size(); )
+            {
+                std::size_t last = first + 1;
+                const auto expression = m_pending[m_order[first]].expression;
+
+                while (last < m_order.size() && m_pending[m_order[last]].expression == expression)
+                {
+                    ++last;
+                }
+
+                const auto& program = m_programs.get(expression);
+
+                if (program.valid())
+                {
+                    answer(program, first, last);
+                }
+                else
+                {
+                    for (std::size_t k = first; k < last; ++k)
+                    {
+                        reject(m_order[k], Status::BadRequest);
+                    }
+                }
+
+                first = last;
+            }
+
+            // Replies go out in the order the requests came in.
+            for (std::size_t i = 0; i < m_pending.size(); ++i)
+            {
+                const Pending& p = m_pending[i];
+                const Reply& r = m_replies[i];
+                auto& out = m_clients[p.client].out;
+
+                ReplyHeader header {};
+                header.id = p.header.id;
+                header.status = r.status;
+                header.count = static_cast<std::uint32_t>(r.count);
+                header.length = static_cast<std::uint32_t>(r.count * sizeof(double));
+
+                detail::append(out, header);
+
+                const char* values = reinterpret_cast<const char*>(m_values.data() + r.first);
+                out.insert(out.end(), values, values + r.count * sizeof(double));
+            }
+
+            m_stats.requests += m_pending.size();
+            m_values.clear();
+
+            for (std::size_t i = 0; i < m_clients.size(); ++i)
+            {
+                auto& in = m_clients[i].in;
+                in.erase(in.begin(), in.begin() + m_consumed[i]);
+            }
+        }
+
+        // Bytes of the reply to `p`, at most.
+        static std::size_t reply_size(const Pending& p)
+        {
+            std::size_t values = 2;
+
+            if (p.header.op == Op::Evaluate)
+            {
+                values = p.payload_size / sizeof(double);
+            }
+            else if (p.header.op == Op::Sample && p.payload_size == sizeof(Range))
+            {
+                Range range;
+                std::memcpy(&range, p.payload, sizeof(range));
+
+                values = (range.divisions < max_values) ? static_cast<std::size_t>(range.divisions) + 1 : 0;
+            }
+
+            return sizeof(ReplyHeader) + values * sizeof(double);
+        }
+
+        // Where the reply to a request is in m_values.
+        struct Reply
+        {
+            Status status = Status::Ok;
+            std::size_t first = 0;
+            std::size_t count = 0;
+        };
+
+        // Answers the requests m_order[first, last), all for `program`.
+        void answer(const bytecode::Program& program, std::size_t first, std::size_t last)
+        {
+            // Evaluate requests share one run of the evaluator.
+            std::size_t xs = 0;
+            std::size_t evaluations = 0;
+
+            m_x.clear();
+
+            for (std::size_t k = first; k < last; ++k)
+            {
+                const Pending& p = m_pending[m_order[k]];
+
+                if (p.header.op != Op::Evaluate)
+                {
+                    continue;
+                }
+
+                if (p.payload_size % sizeof(double) != 0)
+                {
+                    reject(m_order[k], Status::BadRequest);
+                    continue;
+                }
+
+                const std::size_t n = p.payload_size / sizeof(double);
+
+                m_x.resize(xs + n);
+                std::memcpy(m_x.data() + xs, p.payload, p.payload_size);
+
+                m_replies[m_order[k]] = Reply { Status::Ok, m_values.size() + xs, n };
+                xs += n;
+                ++evaluations;
+            }
+
+            if (xs > 0)
+            {
+                const std::size_t base = m_values.size();
+                m_values.resize(base + xs);
+                program.evaluate(m_x.data(), nullptr, m_values.data() + base, xs);
+            }
+
+            if (evaluations > 1)
+            {
+                m_stats.batched += evaluations;
+            }
+
+            for (std::size_t k = first; k < last; ++k)
+            {
+                const std::size_t index = m_order[k];
+                const Pending& p = m_pending[index];
+
+                if (p.header.op == Op::Evaluate)
+                {
+                    continue;
+                }
+
+                if (p.payload_size != sizeof(Range) ||
+                    (p.header.op != Op::Sample && p.header.op != Op::Integrate))
+                {
+                    reject(index, Status::BadRequest);
+                    continue;
+                }
+
+                Range range;
+                std::memcpy(&range, p.payload, sizeof(range));
+
+                if (range.divisions == 0)
+                {
+                    reject(index, Status::BadRequest);
+                    continue;
+                }
+
+                // Large ranges are worth a few threads; small ones are not
+                // worth starting them.
+                constexpr std::uint64_t per_thread = 1 << 16;
+                const std::size_t chunks = static_cast<std::size_t>(std::min<std::uint64_t>(
+                    parallel::thread_count(), range.divisions / per_thread + 1));
+
+                const std::size_t base = m_values.size();
+
+                if (p.header.op == Op::Integrate)
+                {
+                    if (range.divisions > max_divisions)
+                    {
+                        reject(index, Status::TooLarge);
+                        continue;
+                    }
+
+                    const auto areas = integration::program_area(program, range.lower, range.upper,
+                                                                 range.divisions, chunks);
+
+                    m_values.push_back(areas.rectangles);
+                    m_values.push_back(areas.trapezoids);
+                    m_replies[index] = Reply { Status::Ok, base, 2 };
+                    continue;
+                }
+
+                if (range.divisions >= max_values)
+                {
+                    reject(index, Status::TooLarge);
+                    continue;
+                }
+
+                const std::size_t count = static_cast<std::size_t>(range.divisions) + 1;
+                const double step = (range.upper - range.lower) / range.divisions;
+
+                m_values.resize(base + count);
+
+                parallel::for_chunks(count, chunks, [&] (std::size_t, std::size_t begin, std::size_t end) {
+                    program.evaluate_grid(range.lower + begin * step, step, end - begin,
+                                          m_values.data() + base + begin);
+                });
+
+                m_replies[index] = Reply { Status::Ok, base, count };
+            }
+        }
+
+        void reject(std::size_t index, Status status)
+        {
+            m_replies[index] = Reply { status, 0, 0 };
+            ++m_stats.rejected;
+        }
+
+        std::string m_path;
+        int m_fd = -1;
+
+        std::vector<Client> m_clients;
+        ProgramCache m_programs;
+        ServerStats m_stats;
+
+        // Scratch space of a round, kept from one to the next.
+        std::vector<Pending> m_pending;
+        std::vector<std::size_t> m_consumed;
+        std::vector<std::size_t> m_order;
+        std::vector<Reply> m_replies;
+        std::vector<double> m_x;
+        std::vector<double> m_values;
+    };
+
+    // Blocking client of a Server. Requests can be sent ahead of reading
+    // their replies (submit, then receive), which lets the server batch
+    // them; evaluate, sample and integrate do one round trip each.
+    class Client
+    {
+    public:
+        explicit Client(const std::string& path)
+        {
+            sockaddr_un addr;
+
+            if (!detail::make_address(path, addr))
+            {
+                return;
+            }
+
+            m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+            if (m_fd >= 0 && ::connect(m_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+            {
+                ::close(m_fd);
+                m_fd = -1;
+            }
+        }
+
+        ~Client()
+        {
+            if (m_fd >= 0)
+            {
+                ::close(m_fd);
+            }
+        }
+
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        bool valid() const { return m_fd >= 0; }
+
+        // Sends a request and returns its id.
+        std::uint32_t submit(Op op, std::string_view expression, const void* payload, std::size_t size)
+        {
+            RequestHeader header {};
+            header.length = static_cast<std::uint32_t>(expression.size() + size);
+            header.id = ++m_id;
+            header.op = op;
+            header.expression_size = static_cast<std::uint32_t>(expression.size());
+
+            m_frame.clear();
+            detail::append(m_frame, header);
+            m_frame.insert(m_frame.end(), expression.begin(), expression.end());
+            m_frame.insert(m_frame.end(), static_cast<const char*>(payload),
+                           static_cast<const char*>(payload) + size);
+
+            write_all(m_frame.data(), m_frame.size());
+
+            return header.id;
+        }
+
+        std::uint32_t submit(Op op, std::string_view expression, const Range& range)
+        {
+            return submit(op, expression, &range, sizeof(range));
+        }
+
+        // The next reply, with its values in `values`. False if the
+        // connection is gone.
+        bool receive(ReplyHeader& header, std::vector<double>& values)
+        {
+            if (!read_all(&header, sizeof(header)))
+            {
+                return false;
+            }
+
+            values.resize(header.count);
+
+            return header.length == header.count * sizeof(double) &&
+                   read_all(values.data(), header.length);
+        }
+
+        bool evaluate(std::string_view expression, const double* x, std::size_t count,
+                      std::vector<double>& out)
+        {
+            submit(Op::Evaluate, expression, x, count * sizeof(double));
+            return receive_ok(out);
+        }
+
+        bool sample(std::string_view expression, double lower, double upper, std::uint64_t divisions,
+                    std::vector<double>& out)
+        {
+            submit(Op::Sample, expression, Range { lower, upper, divisions });
+            return receive_ok(out);
+        }
+
+        bool integrate(std::string_view expression, double lower, double upper, std::uint64_t divisions,
+                       integration::Areas& out)
+        {
+            submit(Op::Integrate, expression, Range { lower, upper, divisions });
+
+            if (!receive_ok(m_values) || m_values.size() != 2)
+            {
+                return false;
+            }
+
+            out = integration::Areas { m_values[0], m_values[1] };
+            return true;
+        }
+
+    private:
+        bool receive_ok(std::vector<double>& out)
+        {
+            ReplyHeader header;
+            return receive(header, out) && header.status == Status::Ok;
+        }
+
+        void write_all(const char* data, std::size_t size)
+        {
+            while (size > 0 && m_fd >= 0)
+            {
+                const ssize_t n = ::send(m_fd, data, size, MSG_NOSIGNAL);
+
+                if (n <= 0)
+                {
+                    break;
+                }
+
+                data += n;
+                size -= static_cast<std::size_t>(n);
+            }
+        }
+
+        bool read_all(void* dst, std::size_t size)
+        {
+            char* p = static_cast<char*>(dst);
+
+            while (size > 0)
+            {
+                const ssize_t n = ::read(m_fd, p, size);
+
+                if (n <= 0)
+                {
+                    return false;
+                }
+
+                p += n;
+                size -= static_cast<std::size_t>(n);
+            }
+
+            return true;
+        }
+
+        int m_fd = -1;
+        std::uint32_t m_id = 0;
+        std::vector<char> m_frame;
+        std::vector<double> m_values;
+    };
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "asl/types"
+#include "glm/glm.hpp"
+
+struct GraphPoint {
+    glm::vec2 pos;
+
+    struct Color
+    {
+        asl::mut_u8 r;
+        asl::mut_u8 g;
+        asl::mut_u8 b;
+        asl::mut_u8 a;
+    } color;
+};
+
+// Ranges of a vertex buffer, kept as two parallel arrays so they can go
+// straight to a multi-draw call.
+struct StripList
+{
+    std::vector<asl::mut_i32> first;
+    std::vector<asl::mut_i32> count;
+
+    std::size_t size() const
+    {
+        return first.size();
+    }
+
+    void push_back(asl::mut_i32 strip_first, asl::mut_i32 strip_count)
+    {
+        first.push_back(strip_first);
+        count.push_back(strip_count);
+    }
+
+    void clear()
+    {
+        first.clear();
+        count.clear();
+    }
+};
+
+// A vertex buffer made of one or more line strips, each one a contiguous
+// range of `vertices`.
+struct Curve
+{
+    std::vector<GraphPoint> vertices;
+    StripList strips;
+
+    void clear()
+    {
+        vertices.clear();
+        strips.clear();
+    }
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "raster.hpp"
+
+namespace raster
+{
+    namespace detail
+    {
+        inline std::uint32_t crc32(const std::uint8_t* data, std::size_t size,
+                                   std::uint32_t crc = 0)
+        {
+            static const auto table = [] {
+                std::array<std::uint32_t, 256> t {};
+
+                for (std::uint32_t n = 0; n < 256; ++n)
+                {
+                    std::uint32_t c = n;
+
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+
+                    t[n] = c;
+                }
+
+                return t;
+            }();
+
+            crc = ~crc;
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+
+            return ~crc;
+        }
+
+        inline void put_u32(std::vector<std::uint8_t>& out, std::uint32_t v)
+        {
+            out.push_back(static_cast<std::uint8_t>(v >> 24));
+            out.push_back(static_cast<std::uint8_t>(v >> 16));
+            out.push_back(static_cast<std::uint8_t>(v >> 8));
+            out.push_back(static_cast<std::uint8_t>(v));
+        }
+
+        inline void put_chunk(std::ofstream& file, const char* type,
+                              const std::vector<std::uint8_t>& payload)
+        {
+            std::vector<std::uint8_t> chunk;
+            chunk.reserve(payload.size() + 12);
+
+            put_u32(chunk, static_cast<std::uint32_t>(payload.size()));
+            chunk.insert(chunk.end(), type, type + 4);
+            chunk.insert(chunk.end(), payload.begin(), payload.end());
+            put_u32(chunk, crc32(chunk.data() + 4, payload.size() + 4));
+
+            file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+        }
+    }
+
+    // Binary PPM (P6); alpha is dropped.
+    inline bool write_ppm(const Framebuffer& fb, const std::string& path)
+    {
+        std::ofstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        file << "P6\n" << fb.width() << ' ' << fb.height() << "\n255\n";
+
+        std::vector<char> line(static_cast<std::size_t>(fb.width()) * 3);
+
+        for (asl::mut_i32 y = 0; y < fb.height(); ++y)
+        {
+            const std::uint32_t* src = fb.row(y);
+
+            for (asl::mut_i32 x = 0; x < fb.width(); ++x)
+            {
+                line[3 * x + 0] = static_cast<char>(src[x] & 0xFF);
+                line[3 * x + 1] = static_cast<char>((src[x] >> 8) & 0xFF);
+                line[3 * x + 2] = static_cast<char>((src[x] >> 16) & 0xFF);
+            }
+
+            file.write(line.data(), line.size());
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    // 8-bit RGBA PNG. The zlib stream uses stored (uncompressed) deflate
+    // blocks, so no compression library is needed; plots compress well
+    // with any PNG optimizer afterwards if size matters.
+    inline bool write_png(const Framebuffer& fb, const std::string& path)
+    {
+        std::ofstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        std::vector<std::uint8_t> header;
+        detail::put_u32(header, static_cast<std::uint32_t>(fb.width()));
+        detail::put_u32(header, static_cast<std::uint32_t>(fb.height()));
+        header.insert(header.end(), { 8, 6, 0, 0, 0 });
+        detail::put_chunk(file, "IHDR", header);
+
+        // Filter type 0 (none) in front of every row.
+        const std::size_t stride = static_cast<std::size_t>(fb.width()) * 4 + 1;
+        std::vector<std::uint8_t> raw(stride * fb.height());
+
+        for (asl::mut_i32 y = 0; y < fb.height(); ++y)
+        {
+            std::uint8_t* dst = raw.data() + stride * y;
+            const std::uint32_t* src = fb.row(y);
+
+            dst[0] = 0;
+
+            for (asl::mut_i32 x = 0; x < fb.width(); ++x)
+            {
+                dst[1 + 4 * x + 0] = static_cast<std::uint8_t>(src[x]);
+                dst[1 + 4 * x + 1] = static_cast<std::uint8_t>(src[x] >> 8);
+                dst[1 + 4 * x + 2] = static_cast<std::uint8_t>(src[x] >> 16);
+                dst[1 + 4 * x + 3] = static_cast<std::uint8_t>(src[x] >> 24);
+            }
+        }
+
+        std::vector<std::uint8_t> zlib { 0x78, 0x01 };
+        zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+
+        std::uint32_t s1 = 1;
+        std::uint32_t s2 = 0;
+
+        for (std::size_t pos = 0; pos < raw.size() || pos == 0; )
+        {
+            const std::size_t len = std::min<std::size_t>(raw.size() - pos, 65535);
+            const bool final = pos + len == raw.size();
+
+            zlib.push_back(final ? 1 : 0);
+            zlib.push_back(static_cast<std::uint8_t>(len));
+            zlib.push_back(static_cast<std::uint8_t>(len >> 8));
+            zlib.push_back(static_cast<std::uint8_t>(~len));
+            zlib.push_back(static_cast<std::uint8_t>(~len >> 8));
+            zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+
+            for (std::size_t i = pos; i < pos + len; ++i)
+            {
+                s1 = (s1 + raw[i]) % 65521;
+                s2 = (s2 + s1) % 65521;
+            }
+
+            pos += len;
+
+            if (final)
+            {
+                break;
+            }
+        }
+
+        detail::put_u32(zlib, (s2 << 16) | s1);
+        detail::put_chunk(file, "IDAT", zlib);
+        detail::put_chunk(file, "IEND", {});
+
+        return static_cast<bool>(file);
+    }
+
+    // Picks the format from the extension: .ppm, anything else is PNG.
+    inline bool write_image(const Framebuffer& fb, const std::string& path)
+    {
+        const std::string_view view(path);
+
+        if (view.size() >= 4 && view.substr(view.size() - 4) == ".ppm")
+        {
+            return write_ppm(fb, path);
+        }
+
+        return write_png(fb, path);
+    }
+}
@@ -0,0 +1,465 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+#include "axis_grid.hpp"
+#include "parallel.hpp"
+#include "program.hpp"
+#include "instrument.hpp"
+
+namespace implicit
+{
+    struct ContourOptions
+    {
+        // Side of a grid cell on screen (pixels).
+        asl::mut_f64 cell_pixels = 4.0;
+
+        // Cells per side of a tile, the unit of work of a thread.
+        std::size_t tile_cells = 32;
+
+        // Cells between the points of the coarse pass that decides
+        // whether a tile can be skipped.
+        std::size_t coarse_cells = 8;
+
+        // Regula falsi steps on each edge crossing.
+        asl::mut_i32 refine_steps = 3;
+    };
+
+    struct ContourStats
+    {
+        std::size_t tiles = 0;
+        std::size_t skipped_tiles = 0;
+        std::size_t evaluations = 0;
+        std::size_t segments = 0;
+    };
+
+    namespace detail
+    {
+        // Segments of a marching squares cell, as pairs of edges: 0 bottom,
+        // 1 right, 2 top, 3 left. The case is the sign bits of the corners
+        // (x0,y0), (x1,y0), (x1,y1), (x0,y1). For the saddles (5 and 10)
+        // the table assumes a negative centre; `saddles` has the segments
+        // for a positive one.
+        struct Case
+        {
+            asl::mut_i32 count;
+            asl::mut_i32 edges[4];
+        };
+
+        constexpr Case cases[16] = {
+            { 0, { } },
+            { 1, { 3, 0 } },
+            { 1, { 0, 1 } },
+            { 1, { 3, 1 } },
+            { 1, { 1, 2 } },
+            { 2, { 3, 0, 1, 2 } },
+            { 1, { 0, 2 } },
+            { 1, { 3, 2 } },
+            { 1, { 2, 3 } },
+            { 1, { 0, 2 } },
+            { 2, { 0, 1, 2, 3 } },
+            { 1, { 1, 2 } },
+            { 1, { 3, 1 } },
+            { 1, { 0, 1 } },
+            { 1, { 3, 0 } },
+            { 0, { } },
+        };
+
+        constexpr Case saddles[2] = {
+            { 2, { 0, 1, 2, 3 } },  // case 5
+            { 2, { 3, 0, 1, 2 } },  // case 10
+        };
+
+        // A point where f changes sign along a cell edge, bracketed by
+        // [t0, t1] from endpoint a to endpoint b.
+        struct Crossing
+        {
+            asl::mut_f64 ax, ay, bx, by;
+            asl::mut_f64 t0, t1;
+            asl::mut_f64 f0, f1;
+            asl::mut_f64 limit;
+            bool valid;
+
+            asl::mut_f64 t() const { return t0 - f0 * (t1 - t0) / (f1 - f0); }
+        };
+
+        // Per-thread buffers, reused from tile to tile.
+        struct Workspace
+        {
+            std::vector<double> xs;
+            std::vector<double> ys;
+            std::vector<double> values;
+
+            std::vector<std::int32_t> horizontal;
+            std::vector<std::int32_t> vertical;
+            std::vector<Crossing> crossings;
+            std::vector<std::int32_t> segments;
+
+            std::vector<double> qx;
+            std::vector<double> qy;
+            std::vector<double> qv;
+        };
+
+        struct Lattice
+        {
+            asl::mut_f64 x_from;
+            asl::mut_f64 y_from;
+            asl::mut_f64 cell_w;
+            asl::mut_f64 cell_h;
+            std::size_t columns;
+            std::size_t rows;
+        };
+
+        // f at the points of columns c0, c0 + stride, ... c1 and rows
+        // alike, row by row. Returns the number of columns.
+        inline std::size_t sample(const bytecode::Program& f, const Lattice& lat,
+                                  std::size_t c0, std::size_t c1, std::size_t r0, std::size_t r1,
+                                  std::size_t stride, Workspace& ws)
+        {
+            const std::size_t nc = (c1 - c0 + stride - 1) / stride + 1;
+            const std::size_t nr = (r1 - r0 + stride - 1) / stride + 1;
+
+            ws.xs.resize(nc * nr);
+            ws.ys.resize(nc * nr);
+            ws.values.resize(nc * nr);
+
+            for (std::size_t j = 0; j < nr; ++j)
+            {
+                const std::size_t r = std::min(r0 + j * stride, r1);
+
+                for (std::size_t i = 0; i < nc; ++i)
+                {
+                    const std::size_t c = std::min(c0 + i * stride, c1);
+
+                    ws.xs[j * nc + i] = lat.x_from + c * lat.cell_w;
+                    ws.ys[j * nc + i] = lat.y_from + r * lat.cell_h;
+                }
+            }
+
+            f.evaluate(ws.xs.data(), ws.ys.data(), ws.values.data(), nc * nr);
+
+            return nc;
+        }
+
+        // True when the coarse samples say f keeps one sign over the
+        // tile: all of them share a sign and none is closer to zero than
+        // the largest step between neighbours, so f cannot get there in
+        // between unless it has detail finer than the coarse grid.
+        inline bool one_sign(const std::vector<double>& values, std::size_t columns)
+        {
+            const std::size_t rows = values.size() / columns;
+
+            asl::mut_f64 nearest = std::abs(values[0]);
+            asl::mut_f64 slope = 0.0;
+
+            for (std::size_t j = 0; j < rows; ++j)
+            {
+                for (std::size_t i = 0; i < columns; ++i)
+                {
+                    const double v = values[j * columns + i];
+
+                    if (!std::isfinite(v) || (v > 0.0) != (values[0] > 0.0))
+                    {
+                        return false;
+                    }
+
+                    nearest = std::min(nearest, std::abs(v));
+
+                    if (i > 0)
+                    {
+                        slope = std::max(slope, std::abs(v - values[j * columns + i - 1]));
+                    }
+
+                    if (j > 0)
+                    {
+                        slope = std::max(slope, std::abs(v - values[(j - 1) * columns + i]));
+                    }
+                }
+            }
+
+            return nearest > slope;
+        }
+
+        // Contour of f in cells [c0, c1) x [r0, r1), appended to `out`.
+        inline void trace_tile(const bytecode::Program& f, const Lattice& lat, const ContourOptions& opt,
+                               std::size_t c0, std::size_t c1, std::size_t r0, std::size_t r1,
+                               GraphPoint::Color color, Workspace& ws, std::vector<GraphPoint>& out,
+                               ContourStats& stats)
+        {
+            ++stats.tiles;
+
+            const std::size_t coarse = sample(f, lat, c0, c1, r0, r1, opt.coarse_cells, ws);
+            stats.evaluations += ws.values.size();
+
+            if (one_sign(ws.values, coarse))
+            {
+                ++stats.skipped_tiles;
+                return;
+            }
+
+            const std::size_t nc = sample(f, lat, c0, c1, r0, r1, 1, ws);
+            const std::size_t cells_x = c1 - c0;
+            const std::size_t cells_y = r1 - r0;
+
+            stats.evaluations += ws.values.size();
+
+            const auto value = [&] (std::size_t i, std::size_t j) { return ws.values[j * nc + i]; };
+            const auto px = [&] (std::size_t i) { return lat.x_from + (c0 + i) * lat.cell_w; };
+            const auto py = [&] (std::size_t j) { return lat.y_from + (r0 + j) * lat.cell_h; };
+
+            // Crossings are found once per edge, shared by the two cells
+            // around it.
+            ws.horizontal.assign(cells_x * (cells_y + 1), -1);
+            ws.vertical.assign((cells_x + 1) * cells_y, -1);
+            ws.crossings.clear();
+
+            const auto crossing = [&] (std::size_t i0, std::size_t j0, std::size_t i1, std::size_t j1) {
+                const double fa = value(i0, j0);
+                const double fb = value(i1, j1);
+
+                Crossing c { px(i0), py(j0), px(i1), py(j1), 0.0, 1.0, fa, fb,
+                             std::max(std::abs(fa), std::abs(fb)), true };
+                ws.crossings.push_back(c);
+
+                return static_cast<std::int32_t>(ws.crossings.size() - 1);
+            };
+
+            const auto edge = [&] (std::size_t i, std::size_t j, asl::i32 side) -> std::int32_t {
+                switch (side)
+                {
+                case 0:
+                {
+                    auto& slot = ws.horizontal[j * cells_x + i];
+                    return (slot < 0) ? (slot = crossing(i, j, i + 1, j)) : slot;
+                }
+
+                case 1:
+                {
+                    auto& slot = ws.vertical[j * (cells_x + 1) + i + 1];
+                    return (slot < 0) ? (slot = crossing(i + 1, j, i + 1, j + 1)) : slot;
+                }
+
+                case 2:
+                {
+                    auto& slot = ws.horizontal[(j + 1) * cells_x + i];
+                    return (slot < 0) ? (slot = crossing(i, j + 1, i + 1, j + 1)) : slot;
+                }
+
+                default:
+                {
+                    auto& slot = ws.vertical[j * (cells_x + 1) + i];
+                    return (slot < 0) ? (slot = crossing(i, j, i, j + 1)) : slot;
+                }
+                }
+            };
+
+            // Cells first, as pairs of crossing indices; the saddle
+            // centres are evaluated along the way, being few.
+            auto& segments = ws.segments;
+            segments.clear();
+
+            for (std::size_t j = 0; j < cells_y; ++j)
+            {
+                for (std::size_t i = 0; i < cells_x; ++i)
+                {
+                    const double v[4] = { value(i, j), value(i + 1, j), value(i + 1, j + 1), value(i, j + 1) };
+
+                    if (!std::isfinite(v[0]) || !std::isfinite(v[1]) ||
+                        !std::isfinite(v[2]) || !std::isfinite(v[3]))
+                    {
+                        continue;
+                    }
+
+                    const asl::i32 index = (v[0] > 0.0) | (v[1] > 0.0) << 1 | (v[2] > 0.0) << 2 | (v[3] > 0.0) << 3;
+                    const Case* c = &cases[index];
+
+                    if (index == 5 || index == 10)
+                    {
+                        const double centre = f(px(i) + lat.cell_w / 2.0, py(j) + lat.cell_h / 2.0);
+                        ++stats.evaluations;
+
+                        if (centre > 0.0)
+                        {
+                            c = &saddles[index == 5 ? 0 : 1];
+                        }
+                    }
+
+                    for (asl::mut_i32 s = 0; s < c->count; ++s)
+                    {
+                        segments.push_back(edge(i, j, c->edges[2 * s]));
+                        segments.push_back(edge(i, j, c->edges[2 * s + 1]));
+                    }
+                }
+            }
+
+            // Then every crossing is refined at once, one batch per step.
+            const std::size_t count = ws.crossings.size();
+
+            ws.qx.resize(count);
+            ws.qy.resize(count);
+            ws.qv.resize(count);
+
+            for (asl::mut_i32 step = 0; step < opt.refine_steps; ++step)
+            {
+                for (std::size_t k = 0; k < count; ++k)
+                {
+                    const Crossing& c = ws.crossings[k];
+                    const double t = c.t();
+
+                    ws.qx[k] = c.ax + (c.bx - c.ax) * t;
+                    ws.qy[k] = c.ay + (c.by - c.ay) * t;
+                }
+
+                f.evaluate(ws.qx.data(), ws.qy.data(), ws.qv.data(), count);
+                stats.evaluations += count;
+
+                for (std::size_t k = 0; k < count; ++k)
+                {
+                    Crossing& c = ws.crossings[k];
+                    const double t = c.t();
+                    const double v = ws.qv[k];
+
+                    if (!std::isfinite(v))
+                    {
+                        c.valid = false;
+                        continue;
+                    }
+
+                    // Illinois: the end kept twice in a row counts half.
+                    if ((v > 0.0) == (c.f0 > 0.0))
+                    {
+                        c.t0 = t;
+                        c.f0 = v;
+                        c.f1 /= 2.0;
+                    }
+                    else
+                    {
+                        c.t1 = t;
+                        c.f1 = v;
+                        c.f0 /= 2.0;
+                    }
+
+                    // Growing instead of shrinking: a pole, not a root.
+                    if (std::abs(v) > c.limit)
+                    {
+                        c.valid = false;
+                    }
+                }
+            }
+
+            for (std::size_t k = 0; k < segments.size(); k += 2)
+            {
+                const Crossing& a = ws.crossings[segments[k]];
+                const Crossing& b = ws.crossings[segments[k + 1]];
+
+                if (!a.valid || !b.valid)
+                {
+                    continue;
+                }
+
+                GraphPoint p;
+                p.color = color;
+
+                const double ta = a.t();
+                p.pos = glm::vec2(a.ax + (a.bx - a.ax) * ta, a.ay + (a.by - a.ay) * ta);
+                out.push_back(p);
+
+                const double tb = b.t();
+                p.pos = glm::vec2(b.ax + (b.bx - b.ax) * tb, b.ay + (b.by - b.ay) * tb);
+                out.push_back(p);
+
+                ++stats.segments;
+            }
+        }
+    }
+
+    // The curve f(x, y) = 0 over `view`, as line segments (GL_LINES
+    // vertices) appended to `out`. f is sampled on a grid of cells a few
+    // pixels wide, split in tiles that are traced in parallel; each tile
+    // is first sampled coarsely, and left out when f clearly keeps one
+    // sign on it. The contour is found by marching squares, with saddles
+    // resolved by the cell centre, and every edge crossing is refined by
+    // a few regula falsi steps. Sign changes through a pole are dropped.
+    inline ContourStats trace(const bytecode::Program& f, const grid::Viewport& view,
+                              const ContourOptions& opt, GraphPoint::Color color,
+                              std::vector<GraphPoint>& out)
+    {
+        const instrument::Scope scope("implicit");
+
+        const auto columns = static_cast<std::size_t>(
+            std::max(1.0, std::ceil((view.x_to - view.x_from) * view.x_scale / opt.cell_pixels)));
+        const auto rows = static_cast<std::size_t>(
+            std::max(1.0, std::ceil((view.y_to - view.y_from) * view.y_scale / opt.cell_pixels)));
+
+        const detail::Lattice lat { view.x_from, view.y_from,
+                                    (view.x_to - view.x_from) / columns,
+                                    (view.y_to - view.y_from) / rows,
+                                    columns, rows };
+
+        const std::size_t tiles_x = (columns + opt.tile_cells - 1) / opt.tile_cells;
+        const std::size_t tiles_y = (rows + opt.tile_cells - 1) / opt.tile_cells;
+        const std::size_t tiles = tiles_x * tiles_y;
+
+        // Tiles are traced in contiguous runs, one per thread, each into
+        // the buffer of its thread: how many segments a tile has is only
+        // known once its crossings are refined.
+        std::vector<std::vector<GraphPoint>> chunk_out(std::min<std::size_t>(parallel::thread_count(), tiles));
+        std::vector<ContourStats> chunk_stats(chunk_out.size());
+
+        parallel::for_chunks(tiles, chunk_out.size(),
+                             [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+        {
+            detail::Workspace ws;
+
+            for (std::size_t t = begin; t < end; ++t)
+            {
+                const std::size_t c0 = (t % tiles_x) * opt.tile_cells;
+                const std::size_t r0 = (t / tiles_x) * opt.tile_cells;
+
+                detail::trace_tile(f, lat, opt,
+                                   c0, std::min(c0 + opt.tile_cells, columns),
+                                   r0, std::min(r0 + opt.tile_cells, rows),
+                                   color, ws, chunk_out[chunk], chunk_stats[chunk]);
+            }
+        });
+
+        ContourStats stats;
+
+        for (const auto& s : chunk_stats)
+        {
+            stats.tiles += s.tiles;
+            stats.skipped_tiles += s.skipped_tiles;
+            stats.evaluations += s.evaluations;
+            stats.segments += s.segments;
+        }
+
+        // Then `out` grows once, and every thread fills its own range of
+        // it, at the prefix sum of the counts before it.
+        std::vector<std::size_t> offsets(chunk_out.size() + 1, out.size());
+
+        for (std::size_t c = 0; c < chunk_out.size(); ++c)
+        {
+            offsets[c + 1] = offsets[c] + chunk_out[c].size();
+        }
+
+        out.resize(offsets.back());
+
+        parallel::for_chunks(chunk_out.size(), chunk_out.size(),
+                             [&] (std::size_t, std::size_t begin, std::size_t end)
+        {
+            for (std::size_t c = begin; c < end; ++c)
+            {
+                std::copy(chunk_out[c].begin(), chunk_out[c].end(), out.begin() + offsets[c]);
+            }
+        });
+
+        return stats;
+    }
+}
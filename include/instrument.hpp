@@ -0,0 +1,486 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <time.h>
+
+// Counters and scoped timers on the hot paths, summarised by --stats and
+// exported as a Chrome trace (chrome://tracing, Perfetto) by --trace.
+// Built in unless compiled with SAMPLE_PLOTTER_INSTRUMENT=0, which leaves
+// every hook empty.
+#ifndef SAMPLE_PLOTTER_INSTRUMENT
+#define SAMPLE_PLOTTER_INSTRUMENT 1
+#endif
+
+namespace instrument
+{
+    constexpr bool enabled = SAMPLE_PLOTTER_INSTRUMENT != 0;
+
+    enum class Counter
+    {
+        Tokens,
+        AstNodes,
+
+        // Global operator new, counted by the program that replaces it.
+        Allocations,
+        BytesAllocated,
+
+        // Calls of an expression tree and points run through a program.
+        Evaluations,
+        Frames,
+    };
+
+    constexpr std::size_t counter_count = 6;
+
+    inline const char* counter_name(Counter c)
+    {
+        switch (c)
+        {
+        case Counter::Tokens:         return "tokens";
+        case Counter::AstNodes:       return "ast_nodes";
+        case Counter::Allocations:    return "allocations";
+        case Counter::BytesAllocated: return "bytes_allocated";
+        case Counter::Evaluations:    return "evaluations";
+        case Counter::Frames:         return "frames";
+        }
+
+        return "unknown";
+    }
+
+    // Totals of the scopes of one name. `ops` is the work they reported,
+    // e.g. evaluations, and gives a rate over their wall time.
+    struct ScopeStats
+    {
+        std::string_view name;
+        std::uint64_t calls = 0;
+        std::uint64_t ops = 0;
+        double wall = 0.0;
+        double max_wall = 0.0;
+        double cpu = 0.0;
+    };
+
+#if SAMPLE_PLOTTER_INSTRUMENT
+
+    namespace detail
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // Zeroed before any constructor runs, so an operator new called
+        // during static initialization can already count.
+        inline std::atomic<std::uint64_t> g_counters[counter_count];
+
+        inline std::atomic<bool> g_tracing { false };
+
+        // Trace events kept at most; later ones are dropped and counted.
+        constexpr std::size_t max_events = 1 << 21;
+
+        struct Event
+        {
+            const char* name;
+            std::uint32_t thread;
+
+            // Nanoseconds since the first timestamp of the process.
+            std::uint64_t start;
+            std::uint64_t duration;
+
+            std::uint64_t ops;
+        };
+
+        struct CounterSample
+        {
+            std::uint32_t thread;
+            std::uint64_t time;
+            std::array<std::uint64_t, counter_count> values;
+        };
+
+        struct LocalCounters;
+
+        struct Registry
+        {
+            std::mutex mutex;
+            std::vector<ScopeStats> scopes;
+            std::vector<Event> events;
+            std::vector<CounterSample> samples;
+            std::vector<std::pair<std::uint32_t, std::string>> thread_names;
+            std::vector<const LocalCounters*> locals;
+            std::uint64_t dropped = 0;
+        };
+
+        inline Registry& registry()
+        {
+            static Registry r;
+            return r;
+        }
+
+        // The counters of one thread, for add_local(). Only their thread
+        // writes them; they are read under the registry lock and added to
+        // the shared ones when the thread exits.
+        struct LocalCounters
+        {
+            std::atomic<std::uint64_t> values[counter_count] {};
+
+            LocalCounters()
+            {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+
+                r.locals.push_back(this);
+            }
+
+            ~LocalCounters()
+            {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+
+                for (std::size_t i = 0; i < counter_count; ++i)
+                {
+                    g_counters[i].fetch_add(values[i].load(std::memory_order_relaxed),
+                                            std::memory_order_relaxed);
+                }
+
+                r.locals.erase(std::find(r.locals.begin(), r.locals.end(), this));
+            }
+
+            LocalCounters(const LocalCounters&) = delete;
+            LocalCounters& operator=(const LocalCounters&) = delete;
+        };
+
+        inline std::uint64_t now()
+        {
+            static const Clock::time_point epoch = Clock::now();
+
+            return static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count());
+        }
+
+        inline double thread_cpu_seconds()
+        {
+            timespec ts {};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+            return ts.tv_sec + ts.tv_nsec * 1e-9;
+        }
+
+        // Small, stable thread numbers in order of first use.
+        inline std::uint32_t thread_id()
+        {
+            static std::atomic<std::uint32_t> next { 0 };
+            thread_local const std::uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+
+            return id;
+        }
+
+        inline void record(const char* name, std::uint64_t ops, std::uint64_t start,
+                           std::uint64_t end, double cpu)
+        {
+            const double wall = (end - start) * 1e-9;
+            const std::uint32_t thread = thread_id();
+
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+
+            auto it = std::find_if(r.scopes.begin(), r.scopes.end(),
+                                   [name] (const ScopeStats& s) { return s.name == name; });
+
+            if (it == r.scopes.end())
+            {
+                r.scopes.push_back(ScopeStats { name });
+                it = r.scopes.end() - 1;
+            }
+
+            ++it->calls;
+            it->ops += ops;
+            it->wall += wall;
+            it->max_wall = std::max(it->max_wall, wall);
+            it->cpu += cpu;
+
+            if (g_tracing.load(std::memory_order_relaxed))
+            {
+                if (r.events.size() < max_events)
+                {
+                    r.events.push_back(Event { name, thread, start, end - start, ops });
+                }
+                else
+                {
+                    ++r.dropped;
+                }
+            }
+        }
+    }
+
+    inline void add(Counter c, std::uint64_t n = 1)
+    {
+        detail::g_counters[static_cast<std::size_t>(c)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Same as add, for counts made on every call of something cheap from
+    // many threads at once, such as evaluations: each thread adds to its
+    // own counter instead of contending for the shared one.
+    inline void add_local(Counter c, std::uint64_t n = 1)
+    {
+        thread_local detail::LocalCounters local;
+
+        auto& v = local.values[static_cast<std::size_t>(c)];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t value(Counter c)
+    {
+        const auto i = static_cast<std::size_t>(c);
+        std::uint64_t total = detail::g_counters[i].load(std::memory_order_relaxed);
+
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        for (const auto* local : r.locals)
+        {
+            total += local->values[i].load(std::memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+    // For a replacement of the global operator new.
+    inline void note_allocation(std::size_t bytes)
+    {
+        add(Counter::Allocations);
+        add(Counter::BytesAllocated, bytes);
+    }
+
+    // Times the enclosing scope, wall and CPU time of the calling thread,
+    // under `name`, which must be a string literal.
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name, std::uint64_t ops = 0)
+            : m_name(name),
+              m_ops(ops),
+              m_start(detail::now()),
+              m_cpu(detail::thread_cpu_seconds())
+        {
+        }
+
+        ~Scope()
+        {
+            const double cpu = detail::thread_cpu_seconds() - m_cpu;
+            detail::record(m_name, m_ops, m_start, detail::now(), cpu);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Work done in the scope, if only known at its end.
+        void set_ops(std::uint64_t ops) { m_ops = ops; }
+
+    private:
+        const char* m_name;
+        std::uint64_t m_ops;
+        std::uint64_t m_start;
+        double m_cpu;
+    };
+
+    // Names the calling thread in the trace.
+    inline void name_thread(const char* name)
+    {
+        const std::uint32_t thread = detail::thread_id();
+
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        r.thread_names.emplace_back(thread, name);
+    }
+
+    // Records trace events from now on, as well as the totals.
+    inline void start_trace()
+    {
+        detail::now();
+        detail::g_tracing.store(true, std::memory_order_relaxed);
+    }
+
+    // Adds the counters, as they are now, to the trace.
+    inline void sample_counters()
+    {
+        if (!detail::g_tracing.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        detail::CounterSample s { detail::thread_id(), detail::now(), {} };
+
+        for (std::size_t i = 0; i < counter_count; ++i)
+        {
+            s.values[i] = value(static_cast<Counter>(i));
+        }
+
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        if (r.samples.size() < detail::max_events)
+        {
+            r.samples.push_back(s);
+        }
+    }
+
+    inline std::vector<ScopeStats> scope_stats()
+    {
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        return r.scopes;
+    }
+
+    inline void write_stats(std::ostream& out)
+    {
+        out << "Counters:\n";
+
+        for (std::size_t i = 0; i < counter_count; ++i)
+        {
+            const auto c = static_cast<Counter>(i);
+            out << "  " << std::left << std::setw(18) << counter_name(c) << std::right
+                << value(c) << '\n';
+        }
+
+        auto scopes = scope_stats();
+        std::sort(scopes.begin(), scopes.end(),
+                  [] (const ScopeStats& a, const ScopeStats& b) { return a.wall > b.wall; });
+
+        out << "Scopes (ms):\n"
+            << "  " << std::left << std::setw(18) << "name" << std::right
+            << std::setw(10) << "calls" << std::setw(12) << "total" << std::setw(12) << "mean"
+            << std::setw(12) << "max" << std::setw(12) << "cpu/call" << std::setw(14) << "ops/s" << '\n';
+
+        const auto flags = out.flags();
+        out << std::fixed << std::setprecision(3);
+
+        for (const auto& s : scopes)
+        {
+            out << "  " << std::left << std::setw(18) << s.name << std::right
+                << std::setw(10) << s.calls
+                << std::setw(12) << s.wall * 1e3
+                << std::setw(12) << s.wall * 1e3 / s.calls
+                << std::setw(12) << s.max_wall * 1e3
+                << std::setw(12) << s.cpu * 1e3 / s.calls;
+
+            if (s.ops > 0 && s.wall > 0.0)
+            {
+                out << std::setw(14) << std::setprecision(0) << s.ops / s.wall << std::setprecision(3);
+            }
+
+            out << '\n';
+        }
+
+        out.flags(flags);
+    }
+
+    // Writes the trace in the Chrome trace-event format: one complete
+    // ("X") event per scope, counter ("C") events from sample_counters()
+    // and the thread names. Times are in microseconds.
+    inline bool write_trace(const std::string& path)
+    {
+        std::ofstream out(path);
+
+        if (!out)
+        {
+            return false;
+        }
+
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << r.dropped
+            << "},\"traceEvents\":[\n";
+
+        out << std::fixed << std::setprecision(3);
+
+        bool first = true;
+
+        const auto separator = [&] {
+            out << (first ? "" : ",\n");
+            first = false;
+        };
+
+        for (const auto& [thread, name] : r.thread_names)
+        {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+                << ",\"args\":{\"name\":\"" << name << "\"}}";
+        }
+
+        for (const auto& e : r.events)
+        {
+            separator();
+            out << "{\"name\":\"" << e.name << "\",\"cat\":\"sample_plotter\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << e.thread << ",\"ts\":" << e.start * 1e-3 << ",\"dur\":" << e.duration * 1e-3;
+
+            if (e.ops > 0)
+            {
+                out << ",\"args\":{\"ops\":" << e.ops << '}';
+            }
+
+            out << '}';
+        }
+
+        for (const auto& s : r.samples)
+        {
+            separator();
+            out << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":" << s.thread
+                << ",\"ts\":" << s.time * 1e-3 << ",\"args\":{";
+
+            for (std::size_t i = 0; i < counter_count; ++i)
+            {
+                out << (i > 0 ? "," : "") << '"' << counter_name(static_cast<Counter>(i))
+                    << "\":" << s.values[i];
+            }
+
+            out << "}}";
+        }
+
+        out << "\n]}\n";
+
+        return static_cast<bool>(out);
+    }
+
+#else
+
+    inline void add(Counter, std::uint64_t = 1) { }
+    inline void add_local(Counter, std::uint64_t = 1) { }
+    inline std::uint64_t value(Counter) { return 0; }
+    inline void note_allocation(std::size_t) { }
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char*, std::uint64_t = 0) { }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void set_ops(std::uint64_t) { }
+    };
+
+    inline void name_thread(const char*) { }
+    inline void start_trace() { }
+    inline void sample_counters() { }
+    inline std::vector<ScopeStats> scope_stats() { return {}; }
+
+    inline void write_stats(std::ostream& out)
+    {
+        out << "Instrumentation is not built in (SAMPLE_PLOTTER_INSTRUMENT=0)\n";
+    }
+
+    inline bool write_trace(const std::string&) { return false; }
+
+#endif
+}
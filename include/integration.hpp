@@ -0,0 +1,563 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <numeric>
+#include <cmath>
+
+#include "parallel.hpp"
+#include "sampling.hpp"
+#include "program.hpp"
+#include "instrument.hpp"
+
+namespace integration
+{
+    template <typename F>
+    double function_area(const double divisions,
+                          double lower_limit,
+                          double upper_limit,
+                          F&& fun)
+    {
+        if (upper_limit < lower_limit)
+        {
+            std::swap(lower_limit, upper_limit);
+        }
+
+        const instrument::Scope scope("function_area", static_cast<std::uint64_t>(divisions));
+
+        const double deltax = (upper_limit - lower_limit) / divisions;
+
+        double res = 0.0;
+        double curr = lower_limit;
+
+        for (int i = 0; i < divisions; ++i)
+        {
+            curr += deltax;
+            res += fun(curr);
+        }
+
+        return res * deltax;
+    }
+
+    // Same rectangle rule as above, reading the right endpoints from an
+    // already sampled grid.
+    inline double function_area(const sampling::SampleBuffer& samples)
+    {
+        const instrument::Scope scope("sample_area", samples.divisions());
+
+        const std::size_t chunks = parallel::thread_count();
+        std::vector<double> sums(chunks, 0.0);
+
+        parallel::for_chunks(samples.divisions(), chunks,
+                             [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+        {
+            double sum = 0.0;
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                sum += samples[i + 1];
+            }
+            sums[chunk] = sum;
+        });
+
+        return std::accumulate(sums.begin(), sums.end(), 0.0) * samples.step();
+    }
+
+    // Trapezoid rule over an already sampled grid.
+    inline double trapezoid_area(const sampling::SampleBuffer& samples)
+    {
+        const instrument::Scope scope("sample_area", samples.divisions());
+
+        const std::size_t chunks = parallel::thread_count();
+        std::vector<double> sums(chunks, 0.0);
+
+        parallel::for_chunks(samples.divisions(), chunks,
+                             [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+        {
+            double sum = 0.0;
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                sum += samples[i] + samples[i + 1];
+            }
+            sums[chunk] = sum;
+        });
+
+        return std::accumulate(sums.begin(), sums.end(), 0.0) * 0.5 * samples.step();
+    }
+
+    // Tabulated running integral F(x) = integral of f from `lower` to x.
+    //
+    // F is built from f sampled on a uniform grid with a three-phase
+    // parallel prefix sum over the trapezoid increments:
+    // every chunk sums its increments, the chunk totals are scanned into
+    // offsets and finally every chunk runs its local scan from its offset.
+    // Lookups interpolate linearly between grid points, so any sub-area
+    // costs two lookups.
+    class CumulativeIntegral
+    {
+    public:
+        explicit CumulativeIntegral(const sampling::SampleBuffer& samples)
+            : m_lower(samples.lower()),
+              m_upper(samples.upper()),
+              m_step(samples.step()),
+              m_values(samples.size())
+        {
+            build(samples.values());
+        }
+
+        template <typename F>
+        CumulativeIntegral(F&& fun, double lower, double upper,
+                           std::size_t divisions)
+            : CumulativeIntegral(sampling::SampleBuffer(fun, lower, upper, divisions))
+        {
+        }
+
+        // A table already integrated: values[i] = F(lower + i * step), with
+        // values.size() - 1 steps over [lower, upper].
+        CumulativeIntegral(double lower, double upper, std::vector<double> values)
+            : m_lower(lower),
+              m_upper(upper),
+              m_step((upper - lower) / std::max<std::size_t>(values.size() - 1, 1)),
+              m_values(std::move(values))
+        {
+        }
+
+        double lower() const { return m_lower; }
+        double upper() const { return m_upper; }
+        double step() const { return m_step; }
+        double total() const { return m_values.back(); }
+
+        const std::vector<double>& values() const { return m_values; }
+
+        // F(x), clamped to the tabulated range.
+        double operator()(double x) const
+        {
+            if (x <= m_lower)
+            {
+                return 0.0;
+            }
+
+            if (x >= m_upper)
+            {
+                return total();
+            }
+
+            const double pos = (x - m_lower) / m_step;
+            const std::size_t i = std::min(static_cast<std::size_t>(pos),
+                                           m_values.size() - 2);
+            const double t = pos - i;
+
+            return m_values[i] + (m_values[i + 1] - m_values[i]) * t;
+        }
+
+        // Signed integral of f over [from, to].
+        double area(double from, double to) const
+        {
+            return (*this)(to) - (*this)(from);
+        }
+
+    private:
+        void build(const std::vector<double>& samples)
+        {
+            const std::size_t segments = samples.size() - 1;
+            const std::size_t chunks = std::min<std::size_t>(parallel::thread_count(),
+                                                             segments);
+
+            std::vector<double> chunk_sums(chunks + 1, 0.0);
+
+            const auto increment = [&] (std::size_t i) {
+                return (samples[i] + samples[i + 1]) * 0.5 * m_step;
+            };
+
+            parallel::for_chunks(segments, chunks,
+                                 [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+            {
+                double sum = 0.0;
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    sum += increment(i);
+                }
+                chunk_sums[chunk + 1] = sum;
+            });
+
+            for (std::size_t i = 1; i < chunk_sums.size(); ++i)
+            {
+                chunk_sums[i] += chunk_sums[i - 1];
+            }
+
+            m_values[0] = 0.0;
+
+            parallel::for_chunks(segments, chunks,
+                                 [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+            {
+                double running = chunk_sums[chunk];
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    running += increment(i);
+                    m_values[i + 1] = running;
+                }
+            });
+        }
+
+        double m_lower;
+        double m_upper;
+        double m_step;
+        std::vector<double> m_values;
+    };
+
+    struct Areas
+    {
+        double rectangles;
+        double trapezoids;
+    };
+
+    // Table points kept by a sweep at most: the memory it needs, whatever
+    // the number of divisions.
+    constexpr std::size_t max_table_points = 1 << 20;
+
+    // Steps of a `divisions`-step grid between consecutive points of a
+    // table of at most `max_points` intervals: the least count from
+    // ceil(divisions / max_points) to twice that which divides
+    // `divisions`, or ceil(divisions / max_points) if none does. Round
+    // numbers of divisions always find one.
+    inline std::size_t table_stride(std::size_t divisions, std::size_t max_points)
+    {
+        const std::size_t least = (divisions + max_points - 1) / max_points;
+
+        for (std::size_t stride = least; stride <= 2 * least; ++stride)
+        {
+            if (divisions % stride == 0)
+            {
+                return stride;
+            }
+        }
+
+        return least;
+    }
+
+    // f swept once over a grid: both areas at the resolution of the grid,
+    // and f and F at the points of a coarser table.
+    struct Sweep
+    {
+        Areas areas;
+        CumulativeIntegral integral;
+
+        // At most max_points + 1 samples, enough for the plot and the
+        // analysis; all of them when the grid is not finer than that.
+        sampling::SampleBuffer samples;
+    };
+
+    // Integrates f over exactly `divisions` steps of [lower, upper] by
+    // both rules without storing the samples, and tabulates f and F on a
+    // uniform table of at most `max_points` intervals. The table intervals
+    // span table_stride() steps when that divides `divisions`; otherwise
+    // their ends fall between grid points, where f is evaluated once more
+    // and F adds the trapezoid from the grid point before. The intervals
+    // are split in one chunk per thread, at most `threads`; every chunk
+    // evaluates each grid point once and keeps only f at the table points,
+    // the trapezoid sum of each interval and its own rectangle sum. The
+    // interval sums are then scanned into F. Memory is bounded by
+    // `max_points`, not by `divisions`.
+    template <typename F>
+    Sweep sweep(F&& fun, double lower, double upper, std::size_t divisions,
+                std::size_t max_points = max_table_points,
+                std::size_t threads = parallel::thread_count())
+    {
+        if (upper < lower)
+        {
+            std::swap(lower, upper);
+        }
+
+        divisions = std::max<std::size_t>(divisions, 1);
+        max_points = std::max<std::size_t>(max_points, 1);
+
+        const instrument::Scope scope("sweep", divisions);
+
+        const std::size_t stride = table_stride(divisions, max_points);
+        const std::size_t intervals = (divisions + stride - 1) / stride;
+        const std::size_t chunks = std::min(std::max<std::size_t>(threads, 1), intervals);
+        const double step = (upper - lower) / divisions;
+        const double table_step = (upper - lower) / intervals;
+
+        // Table point j: the grid point at or before it, and whether it
+        // is that grid point.
+        const auto grid_index = [&] (std::size_t j) { return j * divisions / intervals; };
+        const auto on_grid = [&] (std::size_t j) { return j * divisions % intervals == 0; };
+
+        std::vector<double> table(intervals + 1, 0.0);
+        std::vector<double> values(intervals + 1, 0.0);
+        std::vector<double> rectangles(chunks, 0.0);
+
+        parallel::for_chunks(intervals, chunks,
+                             [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+        {
+            std::size_t calls = grid_index(end) - grid_index(begin) + 1;
+
+            for (std::size_t j = begin; j <= end; ++j)
+            {
+                calls += on_grid(j) ? 0 : 1;
+            }
+
+            const auto& f = sampling::count_calls(fun, calls);
+
+            // f at table point j, and the trapezoid from the grid point
+            // before it when it is not one.
+            double left = f(lower + grid_index(begin) * step);
+            double right_sum = 0.0;
+
+            const auto at_table = [&] (std::size_t j, double& partial) {
+                if (on_grid(j))
+                {
+                    partial = 0.0;
+                    return left;
+                }
+
+                const double x = lower + j * table_step;
+                const double y = f(x);
+
+                partial = (x - (lower + grid_index(j) * step)) * (left + y) * 0.5;
+                return y;
+            };
+
+            double partial = 0.0;
+            values[begin] = at_table(begin, partial);
+
+            for (std::size_t j = begin; j < end; ++j)
+            {
+                double both = 0.0;
+
+                for (std::size_t i = grid_index(j) + 1; i <= grid_index(j + 1); ++i)
+                {
+                    const double y = f(lower + i * step);
+
+                    both += left + y;
+                    right_sum += y;
+                    left = y;
+                }
+
+                double next = 0.0;
+                const double y = at_table(j + 1, next);
+
+                // The next chunk starts on the same point.
+                if (j + 1 < end || end == intervals)
+                {
+                    values[j + 1] = y;
+                }
+
+                table[j + 1] = both * 0.5 * step + next - partial;
+                partial = next;
+            }
+
+            rectangles[chunk] = right_sum;
+        });
+
+        for (std::size_t j = 1; j < table.size(); ++j)
+        {
+            table[j] += table[j - 1];
+        }
+
+        const Areas areas { std::accumulate(rectangles.begin(), rectangles.end(), 0.0) * step,
+                            table.back() };
+
+        return Sweep { areas, CumulativeIntegral(lower, upper, std::move(table)),
+                       sampling::SampleBuffer(lower, upper, std::move(values)) };
+    }
+
+    struct Lobe
+    {
+        double from;
+        double to;
+        double signed_area;
+        double abs_area;
+    };
+
+    // Splits the range of the table at the given points (usually the roots
+    // of f) and reports the area of every piece. Each lobe is two lookups.
+    inline std::vector<Lobe> lobe_areas(const CumulativeIntegral& integral,
+                                        std::vector<double> splits)
+    {
+        std::sort(splits.begin(), splits.end());
+
+        std::vector<double> bounds { integral.lower() };
+
+        for (double x : splits)
+        {
+            if (x > bounds.back() && x < integral.upper())
+            {
+                bounds.push_back(x);
+            }
+        }
+
+        bounds.push_back(integral.upper());
+
+        std::vector<Lobe> lobes;
+
+        for (std::size_t i = 0; i + 1 < bounds.size(); ++i)
+        {
+            const double area = integral.area(bounds[i], bounds[i + 1]);
+
+            lobes.push_back({ bounds[i], bounds[i + 1], area, std::abs(area) });
+        }
+
+        return lobes;
+    }
+
+    // Sums of both rules over steps [begin, end) of `step` from `lower`,
+    // not yet multiplied by the step: f at right ends, and f at both
+    // ends of every step. Runs on the calling thread and allocates
+    // nothing.
+    inline Areas area_sums(const bytecode::Program& f, double lower, double step,
+                           std::size_t begin, std::size_t end)
+    {
+        double right = 0.0;
+        double both = 0.0;
+
+        // Points begin .. end.
+        f.for_each_block(lower + begin * step, step, end - begin + 1,
+                         [&] (std::size_t first, std::size_t n, const double* const* y)
+        {
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                const bool left_end = first + j == 0;
+                const bool right_end = first + j == end - begin;
+
+                if (!left_end)
+                {
+                    right += y[0][j];
+                }
+
+                both += (left_end || right_end) ? y[0][j] : 2.0 * y[0][j];
+            }
+        });
+
+        return Areas { right, both };
+    }
+
+    // Both rules of function_area and trapezoid_area, for f on
+    // `divisions` steps of [lower, upper], without storing the samples:
+    // each chunk sums the blocks of the program as they are evaluated.
+    // At most `chunks` threads are used.
+    inline Areas program_area(const bytecode::Program& f, double lower, double upper,
+                              std::size_t divisions, std::size_t chunks = parallel::thread_count())
+    {
+        divisions = std::max<std::size_t>(divisions, 1);
+        chunks = std::clamp<std::size_t>(chunks, 1, divisions);
+
+        const instrument::Scope scope("program_area", divisions);
+
+        const double step = (upper - lower) / divisions;
+
+        std::vector<Areas> sums(chunks, Areas { 0.0, 0.0 });
+
+        parallel::for_chunks(divisions, chunks,
+                             [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+        {
+            sums[chunk] = area_sums(f, lower, step, begin, end);
+        });
+
+        Areas total { 0.0, 0.0 };
+
+        for (const auto& sum : sums)
+        {
+            total.rectangles += sum.rectangles;
+            total.trapezoids += sum.trapezoids;
+        }
+
+        return Areas { total.rectangles * step, total.trapezoids * 0.5 * step };
+    }
+
+    namespace detail
+    {
+        // Sum of term(x0, y0, x1, y1) over the segments of the polyline
+        // through the path of a two-output program at `divisions` + 1
+        // evenly spaced t in [from, to]. Segments with an undefined end
+        // are left out.
+        template <typename Term>
+        double path_sum(const bytecode::Program& path, double from, double to,
+                        std::size_t divisions, Term&& term)
+        {
+            divisions = std::max<std::size_t>(divisions, 1);
+
+            const double step = (to - from) / divisions;
+            const std::size_t chunks = std::min<std::size_t>(parallel::thread_count(), divisions);
+
+            std::vector<double> sums(chunks, 0.0);
+
+            parallel::for_chunks(divisions, chunks,
+                                 [&] (std::size_t chunk, std::size_t begin, std::size_t end)
+            {
+                double sum = 0.0;
+                double px = 0.0;
+                double py = 0.0;
+                bool have_prev = false;
+
+                // Points begin .. end: the chunk owns segments [begin, end).
+                path.for_each_block(from + begin * step, step, end - begin + 1,
+                                    [&] (std::size_t, std::size_t n, const double* const* xy)
+                {
+                    for (std::size_t j = 0; j < n; ++j)
+                    {
+                        const double x = xy[0][j];
+                        const double y = xy[1][j];
+                        const bool defined = std::isfinite(x) && std::isfinite(y);
+
+                        if (defined && have_prev)
+                        {
+                            sum += term(px, py, x, y);
+                        }
+
+                        px = x;
+                        py = y;
+                        have_prev = defined;
+                    }
+                });
+
+                sums[chunk] = sum;
+            });
+
+            return std::accumulate(sums.begin(), sums.end(), 0.0);
+        }
+    }
+
+    // Length of the path (x(t), y(t)), t in [from, to], of a two-output
+    // program (bytecode::Program::parametric or ::polar), as the length of
+    // the polyline through `divisions` + 1 points on it.
+    inline double arc_length(const bytecode::Program& path, double from, double to,
+                             std::size_t divisions)
+    {
+        return detail::path_sum(path, from, to, divisions,
+                                [] (double x0, double y0, double x1, double y1) {
+            return std::hypot(x1 - x0, y1 - y0);
+        });
+    }
+
+    // Signed area enclosed by the same polyline, closed by the segment
+    // from its last point back to the first (shoelace formula): positive
+    // when it runs counter-clockwise. For a polar curve over a whole turn
+    // this is the integral of r^2 / 2.
+    inline double enclosed_area(const bytecode::Program& path, double from, double to,
+                                std::size_t divisions)
+    {
+        const double open = detail::path_sum(path, from, to, divisions,
+                                             [] (double x0, double y0, double x1, double y1) {
+            return x0 * y1 - x1 * y0;
+        });
+
+        double ends[2][2] = {};
+
+        path.for_each_block(from, to - from, 2,
+                            [&] (std::size_t, std::size_t n, const double* const* xy)
+        {
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                ends[j][0] = xy[0][j];
+                ends[j][1] = xy[1][j];
+            }
+        });
+
+        const double closing = ends[1][0] * ends[0][1] - ends[0][0] * ends[1][1];
+
+        return (open + (std::isfinite(closing) ? closing : 0.0)) / 2.0;
+    }
+}
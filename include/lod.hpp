@@ -0,0 +1,338 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+#include "graph_point.hpp"
+#include "parallel.hpp"
+
+namespace lod
+{
+    // First, last, minimum and maximum point of a bucket of samples
+    // (M4 aggregation). Drawing a line through these four points per pixel
+    // column gives the same pixels as drawing every sample.
+    struct Bucket
+    {
+        glm::vec2 first;
+        glm::vec2 last;
+        glm::vec2 min;
+        glm::vec2 max;
+        bool empty = true;
+
+        void add(glm::vec2 p)
+        {
+            if (!std::isfinite(p.y))
+            {
+                return;
+            }
+
+            if (empty)
+            {
+                first = last = min = max = p;
+                empty = false;
+                return;
+            }
+
+            last = p;
+
+            if (p.y < min.y)
+            {
+                min = p;
+            }
+
+            if (p.y > max.y)
+            {
+                max = p;
+            }
+        }
+
+        // `other` must come after this bucket on the x axis.
+        void merge(const Bucket& other)
+        {
+            if (other.empty)
+            {
+                return;
+            }
+
+            if (empty)
+            {
+                *this = other;
+                return;
+            }
+
+            last = other.last;
+
+            if (other.min.y < min.y)
+            {
+                min = other.min;
+            }
+
+            if (other.max.y > max.y)
+            {
+                max = other.max;
+            }
+        }
+    };
+
+    // Level-of-detail pyramid of a series sorted by x. Level 0 has about
+    // `points_per_bucket` samples per bucket, every following level
+    // merges pairs of buckets of the previous one. Both the first level
+    // and the merges are computed in parallel, each thread owning a
+    // contiguous range of buckets.
+    //
+    // The series is not copied: `point` must stay valid for the lifetime
+    // of the pyramid, as it is used to draw raw samples when zoomed in
+    // past level 0.
+    class M4Pyramid
+    {
+    public:
+        using PointFunction = std::function<glm::vec2(std::size_t)>;
+
+        M4Pyramid(std::size_t size, PointFunction point,
+                  std::size_t points_per_bucket = 4)
+            : m_point(std::move(point)),
+              m_size(size)
+        {
+            if (m_size == 0)
+            {
+                return;
+            }
+
+            m_origin = m_point(0).x;
+
+            const double span = std::max(m_point(m_size - 1).x - m_origin, 1e-30);
+
+            std::size_t buckets = 1;
+            while (buckets * points_per_bucket < m_size)
+            {
+                buckets *= 2;
+            }
+
+            // Slightly wider than span / buckets so that the last sample
+            // still falls in the last bucket.
+            m_width0 = std::nextafter(span / buckets, span);
+
+            build_first_level(buckets);
+
+            while (m_levels.back().size() > 1)
+            {
+                build_next_level();
+            }
+        }
+
+        std::size_t size() const { return m_size; }
+        std::size_t levels() const { return m_levels.size(); }
+
+        double bucket_width(std::size_t level) const
+        {
+            return m_width0 * std::exp2(static_cast<double>(level));
+        }
+
+        // Coarsest level whose buckets are at most one pixel wide, or -1
+        // if even level 0 is coarser than that and raw samples are needed.
+        int level_for(double pixels_per_unit) const
+        {
+            const double pixel = 1.0 / pixels_per_unit;
+
+            int level = -1;
+            while (level + 1 < static_cast<int>(m_levels.size()) &&
+                   bucket_width(level + 1) <= pixel)
+            {
+                ++level;
+            }
+
+            return level;
+        }
+
+        // Appends the points of [from, to] to `out`, at most four per pixel
+        // column: the buckets of the matching level are merged per column.
+        void emit(double from, double to, double pixels_per_unit,
+                  GraphPoint::Color color, std::vector<GraphPoint>& out) const
+        {
+            if (m_size == 0)
+            {
+                return;
+            }
+
+            const auto push = [&] (glm::vec2 p) {
+                GraphPoint v;
+                v.pos = p;
+                v.color = color;
+                out.push_back(v);
+            };
+
+            const int level = level_for(pixels_per_unit);
+
+            if (level < 0)
+            {
+                emit_raw(from, to, push);
+                return;
+            }
+
+            const auto& buckets = m_levels[level];
+            const double width = bucket_width(level);
+
+            // One bucket of margin on each side keeps the line connected
+            // to the points just outside the view.
+            const auto clamp_index = [&] (double x) {
+                const double i = std::floor((x - m_origin) / width);
+                return static_cast<std::int64_t>(
+                    std::clamp(i, 0.0, static_cast<double>(buckets.size() - 1)));
+            };
+
+            const std::int64_t first = std::max<std::int64_t>(clamp_index(from) - 1, 0);
+            const std::int64_t last = std::min<std::int64_t>(clamp_index(to) + 1,
+                                                             buckets.size() - 1);
+
+            Bucket column;
+            std::int64_t column_index = 0;
+
+            const auto flush = [&] {
+                if (column.empty)
+                {
+                    return;
+                }
+
+                glm::vec2 pts[4] = { column.first, column.min, column.max, column.last };
+                std::sort(std::begin(pts), std::end(pts),
+                          [] (glm::vec2 a, glm::vec2 b) { return a.x < b.x; });
+
+                push(pts[0]);
+
+                for (int i = 1; i < 4; ++i)
+                {
+                    if (pts[i].x != pts[i - 1].x || pts[i].y != pts[i - 1].y)
+                    {
+                        push(pts[i]);
+                    }
+                }
+
+                column = Bucket{};
+            };
+
+            for (std::int64_t i = first; i <= last; ++i)
+            {
+                const Bucket& b = buckets[i];
+
+                if (b.empty)
+                {
+                    continue;
+                }
+
+                const auto col = static_cast<std::int64_t>(std::floor(b.first.x * pixels_per_unit));
+
+                if (col != column_index)
+                {
+                    flush();
+                    column_index = col;
+                }
+
+                column.merge(b);
+            }
+
+            flush();
+        }
+
+    private:
+        std::size_t bucket_of(double x) const
+        {
+            return static_cast<std::size_t>((x - m_origin) / m_width0);
+        }
+
+        // First sample with x >= value.
+        std::size_t lower_bound(double value) const
+        {
+            std::size_t lo = 0;
+            std::size_t hi = m_size;
+
+            while (lo < hi)
+            {
+                const std::size_t mid = lo + (hi - lo) / 2;
+
+                if (m_point(mid).x < value)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            return lo;
+        }
+
+        template <typename Push>
+        void emit_raw(double from, double to, Push&& push) const
+        {
+            std::size_t begin = lower_bound(from);
+            std::size_t end = lower_bound(to);
+
+            begin = (begin > 0) ? begin - 1 : 0;
+            end = std::min(end + 1, m_size);
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                push(m_point(i));
+            }
+        }
+
+        void build_first_level(std::size_t buckets)
+        {
+            m_levels.emplace_back(buckets);
+            auto& level = m_levels.back();
+
+            parallel::for_chunks(buckets,
+                                 [&] (std::size_t, std::size_t bucket_begin, std::size_t bucket_end)
+            {
+                const std::size_t first = (bucket_begin == 0)
+                    ? 0 : lower_bound(m_origin + bucket_begin * m_width0);
+                const std::size_t last = (bucket_end == buckets)
+                    ? m_size : lower_bound(m_origin + bucket_end * m_width0);
+
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    const glm::vec2 p = m_point(i);
+                    const std::size_t b = std::clamp(bucket_of(p.x), bucket_begin, bucket_end - 1);
+
+                    level[b].add(p);
+                }
+            });
+        }
+
+        void build_next_level()
+        {
+            const auto& prev = m_levels.back();
+            std::vector<Bucket> next((prev.size() + 1) / 2);
+
+            parallel::for_chunks(next.size(),
+                                 [&] (std::size_t, std::size_t begin, std::size_t end)
+            {
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    next[i] = prev[2 * i];
+
+                    if (2 * i + 1 < prev.size())
+                    {
+                        next[i].merge(prev[2 * i + 1]);
+                    }
+                }
+            });
+
+            m_levels.push_back(std::move(next));
+        }
+
+        PointFunction m_point;
+        std::size_t m_size;
+
+        double m_origin = 0.0;
+        double m_width0 = 1.0;
+
+        std::vector<std::vector<Bucket>> m_levels;
+    };
+}
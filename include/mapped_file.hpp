@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A whole file mapped read-only. Pages are read on first access, by
+// whichever thread touches them, and belong to the page cache: a large
+// file costs address space, not memory of the process.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            return;
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            m_size = static_cast<std::size_t>(st.st_size);
+            void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p != MAP_FAILED)
+            {
+                m_data = static_cast<const char*>(p);
+                ::madvise(p, m_size, MADV_SEQUENTIAL);
+            }
+        }
+
+        ::close(fd);
+
+        if (!m_data)
+        {
+            m_size = 0;
+        }
+    }
+
+    ~MappedFile()
+    {
+        if (m_data)
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file could not be opened or is empty.
+    bool valid() const { return m_data != nullptr; }
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+};
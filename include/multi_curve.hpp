@@ -0,0 +1,329 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+#include "adaptive.hpp"
+#include "parallel.hpp"
+
+namespace overlay
+{
+    struct CurveStyle
+    {
+        GraphPoint::Color color { 0, 0, 0, 255 };
+        bool visible = true;
+    };
+
+    // Many curves packed in one vertex array, each in its own slice, so a
+    // whole chart goes out with a single multi-draw call. Changing a curve
+    // rewrites only its slice; slices of removed curves are reused by
+    // later ones, and the array only grows when no free slice fits.
+    //
+    // Changed ranges are handed out by flush(), in the same
+    // write(offset, data, count) form used by TiledCurve.
+    class CurveBuffer
+    {
+    public:
+        using Id = std::size_t;
+
+        Id add(const Curve& curve, CurveStyle style)
+        {
+            Id id;
+
+            if (!m_freeIds.empty())
+            {
+                id = m_freeIds.back();
+                m_freeIds.pop_back();
+            }
+            else
+            {
+                id = m_slices.size();
+                m_slices.emplace_back();
+            }
+
+            m_slices[id].used = true;
+            m_slices[id].style = style;
+
+            store(id, curve);
+
+            return id;
+        }
+
+        void replace(Id id, const Curve& curve)
+        {
+            store(id, curve);
+        }
+
+        void set_style(Id id, CurveStyle style)
+        {
+            Slice& slice = m_slices[id];
+            slice.style = style;
+
+            for (std::size_t i = 0; i < slice.count; ++i)
+            {
+                m_vertices[slice.offset + i].color = style.color;
+            }
+
+            mark(slice.offset, slice.count);
+            m_stripsChanged = true;
+        }
+
+        void remove(Id id)
+        {
+            Slice& slice = m_slices[id];
+
+            release(slice.offset, slice.capacity);
+
+            slice = Slice{};
+            m_freeIds.push_back(id);
+            m_stripsChanged = true;
+        }
+
+        bool contains(Id id) const
+        {
+            return id < m_slices.size() && m_slices[id].used;
+        }
+
+        const CurveStyle& style(Id id) const { return m_slices[id].style; }
+
+        // Size of the vertex array, holes included.
+        std::size_t size() const { return m_vertices.size(); }
+
+        const std::vector<GraphPoint>& vertices() const { return m_vertices; }
+
+        // Strips of every visible curve, in buffer coordinates.
+        const StripList& strips()
+        {
+            if (m_stripsChanged)
+            {
+                m_strips.clear();
+
+                for (const auto& slice : m_slices)
+                {
+                    if (!slice.used || !slice.style.visible)
+                    {
+                        continue;
+                    }
+
+                    for (std::size_t i = 0; i < slice.strips.size(); ++i)
+                    {
+                        m_strips.push_back(static_cast<asl::mut_i32>(slice.offset) + slice.strips.first[i],
+                                           slice.strips.count[i]);
+                    }
+                }
+
+                m_stripsChanged = false;
+            }
+
+            return m_strips;
+        }
+
+        // Calls write(offset, data, count) for every range changed since
+        // the last flush.
+        template <typename Write>
+        void flush(Write&& write)
+        {
+            for (const auto& range : m_dirty)
+            {
+                write(static_cast<asl::mut_i32>(range.offset),
+                      m_vertices.data() + range.offset,
+                      static_cast<asl::mut_i32>(range.count));
+            }
+
+            m_dirty.clear();
+        }
+
+    private:
+        struct Range
+        {
+            std::size_t offset;
+            std::size_t count;
+        };
+
+        struct Slice
+        {
+            bool used = false;
+            std::size_t offset = 0;
+            std::size_t capacity = 0;
+            std::size_t count = 0;
+            StripList strips;
+            CurveStyle style;
+        };
+
+        void store(Id id, const Curve& curve)
+        {
+            Slice& slice = m_slices[id];
+            const std::size_t count = curve.vertices.size();
+
+            if (count > slice.capacity)
+            {
+                release(slice.offset, slice.capacity);
+
+                // Some headroom, so that resampling at a similar density
+                // stays in place.
+                slice.capacity = count + count / 4;
+                slice.offset = allocate(slice.capacity);
+            }
+
+            std::copy(curve.vertices.begin(), curve.vertices.end(),
+                      m_vertices.begin() + slice.offset);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                m_vertices[slice.offset + i].color = slice.style.color;
+            }
+
+            slice.count = count;
+            slice.strips = curve.strips;
+
+            mark(slice.offset, count);
+            m_stripsChanged = true;
+        }
+
+        // First fit among the free ranges, else at the end of the array.
+        std::size_t allocate(std::size_t count)
+        {
+            for (auto it = m_free.begin(); it != m_free.end(); ++it)
+            {
+                if (it->count >= count)
+                {
+                    const std::size_t offset = it->offset;
+
+                    it->offset += count;
+                    it->count -= count;
+
+                    if (it->count == 0)
+                    {
+                        m_free.erase(it);
+                    }
+
+                    return offset;
+                }
+            }
+
+            const std::size_t offset = m_vertices.size();
+            m_vertices.resize(offset + count);
+
+            return offset;
+        }
+
+        // Returns a range to the free list, merging it with its neighbours.
+        void release(std::size_t offset, std::size_t count)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+
+            auto it = std::lower_bound(m_free.begin(), m_free.end(), offset,
+                                       [] (const Range& r, std::size_t o) { return r.offset < o; });
+
+            it = m_free.insert(it, { offset, count });
+
+            if (auto next = it + 1; next != m_free.end() && it->offset + it->count == next->offset)
+            {
+                it->count += next->count;
+                m_free.erase(next);
+            }
+
+            if (it != m_free.begin())
+            {
+                if (auto prev = it - 1; prev->offset + prev->count == it->offset)
+                {
+                    prev->count += it->count;
+                    m_free.erase(it);
+                }
+            }
+        }
+
+        void mark(std::size_t offset, std::size_t count)
+        {
+            if (count > 0)
+            {
+                m_dirty.push_back({ offset, count });
+            }
+        }
+
+        std::vector<GraphPoint> m_vertices;
+        std::vector<Slice> m_slices;
+        std::vector<Id> m_freeIds;
+
+        std::vector<Range> m_free;
+        std::vector<Range> m_dirty;
+
+        StripList m_strips;
+        bool m_stripsChanged = true;
+    };
+
+    // Distinct colours for any number of curves: hues spaced by the
+    // golden angle.
+    inline CurveStyle palette(std::size_t index)
+    {
+        const double hue = std::fmod(index * 0.618033988749895, 1.0) * 6.0;
+        const double f = hue - std::floor(hue);
+
+        const double v = 0.85;
+        const double p = v * 0.25;
+        const double q = v * (1.0 - 0.75 * f);
+        const double t = v * (1.0 - 0.75 * (1.0 - f));
+
+        double rgb[3];
+
+        switch (static_cast<int>(hue))
+        {
+        case 0:  rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+        case 1:  rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+        case 2:  rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+        case 3:  rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+        case 4:  rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+        default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+        }
+
+        CurveStyle style;
+        style.color = { static_cast<asl::mut_u8>(rgb[0] * 255),
+                        static_cast<asl::mut_u8>(rgb[1] * 255),
+                        static_cast<asl::mut_u8>(rgb[2] * 255),
+                        255 };
+
+        return style;
+    }
+
+    using Function = std::function<double(double)>;
+
+    // Samples every function over [from, to] with sample_adaptive, the
+    // curves split among threads.
+    inline void sample_curves(const std::vector<Function>& funs, double from, double to,
+                              const sampling::AdaptiveOptions& opt, double seed_spacing,
+                              std::vector<Curve>& out)
+    {
+        out.resize(funs.size());
+
+        const double seed_step = seed_spacing / opt.pixels_per_unit;
+        const auto seed_count = static_cast<std::size_t>(std::ceil((to - from) / seed_step)) + 1;
+
+        parallel::for_chunks(funs.size(),
+                             [&] (std::size_t, std::size_t begin, std::size_t end)
+        {
+            std::vector<sampling::SamplePoint> seeds(seed_count);
+
+            for (std::size_t c = begin; c < end; ++c)
+            {
+                for (std::size_t i = 0; i < seed_count; ++i)
+                {
+                    const double x = from + i * seed_step;
+                    seeds[i] = { x, funs[c](x) };
+                }
+
+                out[c].clear();
+                sampling::sample_adaptive(funs[c], seeds, opt, out[c]);
+            }
+        });
+    }
+}
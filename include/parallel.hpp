@@ -0,0 +1,61 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+#include "instrument.hpp"
+
+namespace parallel
+{
+    inline unsigned thread_count()
+    {
+        const unsigned hw = std::thread::hardware_concurrency();
+        return (hw == 0) ? 1 : hw;
+    }
+
+    // Splits [0, size) in `chunks` contiguous ranges and calls
+    // fun(chunk_index, begin, end) for each one on its own thread.
+    // The calling thread takes the first chunk. Each chunk is timed as
+    // "chunk", so the trace shows every thread's share.
+    template <typename F>
+    void for_chunks(std::size_t size, std::size_t chunks, F&& fun)
+    {
+        chunks = std::max<std::size_t>(1, std::min(chunks, size));
+
+        const std::size_t chunk_size = size / chunks;
+        const std::size_t remainder = size % chunks;
+
+        const auto chunk_begin = [&] (std::size_t i) {
+            return i * chunk_size + std::min(i, remainder);
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(chunks - 1);
+
+        for (std::size_t i = 1; i < chunks; ++i)
+        {
+            workers.emplace_back([&, i] {
+                const instrument::Scope scope("chunk", chunk_begin(i + 1) - chunk_begin(i));
+                fun(i, chunk_begin(i), chunk_begin(i + 1));
+            });
+        }
+
+        {
+            const instrument::Scope scope("chunk", chunk_begin(1));
+            fun(std::size_t{0}, chunk_begin(0), chunk_begin(1));
+        }
+
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    template <typename F>
+    void for_chunks(std::size_t size, F&& fun)
+    {
+        for_chunks(size, thread_count(), std::forward<F>(fun));
+    }
+}
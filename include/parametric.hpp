@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+#include "parallel.hpp"
+#include "program.hpp"
+#include "instrument.hpp"
+
+namespace parametric
+{
+    // Samples the path (x(t), y(t)) of a two-output program, such as
+    // bytecode::Program::parametric or ::polar, at `count` evenly spaced t
+    // in [from, to]. Each block of t is evaluated for both coordinates at
+    // once and written straight into the vertices of `out`; runs of
+    // defined points become its strips.
+    inline void sample(const bytecode::Program& path, asl::f64 from, asl::f64 to, std::size_t count,
+                       GraphPoint::Color color, Curve& out)
+    {
+        out.clear();
+
+        count = std::max<std::size_t>(count, 2);
+        out.vertices.resize(count);
+
+        const instrument::Scope scope("parametric", count);
+
+        const asl::f64 step = (to - from) / (count - 1);
+
+        parallel::for_chunks(count, [&] (std::size_t, std::size_t begin, std::size_t end)
+        {
+            GraphPoint* dst = out.vertices.data() + begin;
+
+            path.for_each_block(from + begin * step, step, end - begin,
+                                [&] (std::size_t first, std::size_t n, const double* const* xy)
+            {
+                for (std::size_t j = 0; j < n; ++j)
+                {
+                    GraphPoint& p = dst[first + j];
+                    p.pos.x = static_cast<float>(xy[0][j]);
+                    p.pos.y = static_cast<float>(xy[1][j]);
+                    p.color = color;
+                }
+            });
+        });
+
+        bool open = false;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const glm::vec2 p = out.vertices[i].pos;
+
+            if (!std::isfinite(p.x) || !std::isfinite(p.y))
+            {
+                open = false;
+                continue;
+            }
+
+            if (!open)
+            {
+                out.strips.push_back(static_cast<asl::mut_i32>(i), 0);
+                open = true;
+            }
+
+            ++out.strips.count.back();
+        }
+    }
+}
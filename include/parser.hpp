@@ -10,6 +10,7 @@
 #include "common_types.h"
 
 #include "tokenizer.hpp"
+#include "instrument.hpp"
 
 namespace parser
 {
@@ -41,26 +42,60 @@ namespace parser
                 types::Functions fun;
             } ptr;
         } data;
+
+        // Nodes start zeroed (make_unique value-initializes them), so the
+        // children of an operator or function are valid, if empty, even
+        // where only one was set.
+        ~ExprAST()
+        {
+            if (type == Type::Operator || type == Type::UnaryOperator || type == Type::Function)
+            {
+                data.ptr.~Ptrs();
+            }
+        }
     };
 
 
-    std::ostream& operator<<(std::ostream& out, ExprAST::Type type)
+    inline std::ostream& operator<<(std::ostream& out, ExprAST::Type type)
     {
         out << (int)type;
         return out;
     }
 
 
-    std::unique_ptr<ExprAST> read_factor(std::queue<tokenizer::Token>& tokens);
-    std::unique_ptr<ExprAST> read_term(std::queue<tokenizer::Token>& tokens);
-    std::unique_ptr<ExprAST> read_expr(std::queue<tokenizer::Token>& tokens);
+    inline std::unique_ptr<ExprAST> read_factor(std::queue<tokenizer::Token>& tokens);
+    inline std::unique_ptr<ExprAST> read_term(std::queue<tokenizer::Token>& tokens);
+    inline std::unique_ptr<ExprAST> read_expr(std::queue<tokenizer::Token>& tokens);
+
+    // Where a factor is missing. A tree still holding one after parsing
+    // is not a whole expression (see create_ast).
+    inline std::unique_ptr<ExprAST> make_nothing()
+    {
+        auto node = std::make_unique<ExprAST>();
+        node->type = ExprAST::Type::Nothing;
+
+        return node;
+    }
+
+    // Pops the token closing a factor, if it is next.
+    inline bool close_factor(std::queue<tokenizer::Token>& tokens, tokenizer::Token::Type type)
+    {
+        if (tokens.empty() || tokens.front().type != type)
+        {
+            return false;
+        }
+
+        tokens.pop();
+        return true;
+    }
 
     // factor: NUM
     // |       VAR
     // |       ( expr )
+    // |       | expr |
     // |       function: NAME( expr )
     // ;
-    std::unique_ptr<ExprAST> read_factor(std::queue<tokenizer::Token>& tokens)
+    inline std::unique_ptr<ExprAST> read_factor(std::queue<tokenizer::Token>& tokens)
     {
         if (!tokens.empty())
         {
@@ -71,7 +106,6 @@ namespace parser
             bool is_par = curr_token.type == tokenizer::Token::Type::LeftPar;
             bool is_fun = curr_token.type == tokenizer::Token::Type::Function;
             bool is_pipe = curr_token.type == tokenizer::Token::Type::Pipe;
-            bool is_err = curr_token.type == tokenizer::Token::Type::Error;
 
             if (is_num)
             {
@@ -97,7 +131,11 @@ namespace parser
             {
                 tokens.pop();
                 auto node = read_expr(tokens);
-                tokens.pop();
+
+                if (!close_factor(tokens, tokenizer::Token::Type::RightPar))
+                {
+                    return make_nothing();
+                }
 
                 return node;
             }
@@ -121,23 +159,24 @@ namespace parser
 
                 node->type = ExprAST::Type::UnaryOperator;
                 node->data.ptr.op = types::Operators::Abs;
-                node->data.ptr.left = std::move(read_factor(tokens));
+                node->data.ptr.left = std::move(read_expr(tokens));
 
-                tokens.pop();
+                if (!close_factor(tokens, tokenizer::Token::Type::Pipe))
+                {
+                    return make_nothing();
+                }
 
                 return node;
             }
         }
 
-        auto node = std::make_unique<ExprAST>();
-        node->type = ExprAST::Type::Nothing;
-
-        return node;
+        // Error tokens stop here too, and are left over.
+        return make_nothing();
     }
 
 
     // exp: factor ^ factor ;
-    std::unique_ptr<ExprAST> read_exp(std::queue<tokenizer::Token>& tokens)
+    inline std::unique_ptr<ExprAST> read_exp(std::queue<tokenizer::Token>& tokens)
     {
         auto node = read_factor(tokens);
 
@@ -172,11 +211,12 @@ namespace parser
     // % priority = exp
     // ;
     // 
-    std::unique_ptr<ExprAST> read_term(std::queue<tokenizer::Token>& tokens)
+    inline std::unique_ptr<ExprAST> read_term(std::queue<tokenizer::Token>& tokens)
     {
         auto node = read_exp(tokens);
 
-        if (!tokens.empty())
+        // Left to right: a / b * c is (a / b) * c.
+        while (!tokens.empty())
         {
             auto curr_token = tokens.front();
 
@@ -185,18 +225,20 @@ namespace parser
             bool is_div = is_op && curr_token.op == types::Operators::Div;
             bool is_mod = is_op && curr_token.op == types::Operators::Mod;
 
-            if (is_mul || is_div || is_mod)
+            if (!(is_mul || is_div || is_mod))
             {
-                tokens.pop();
+                break;
+            }
 
-                auto new_node = std::make_unique<ExprAST>();
-                new_node->type = ExprAST::Type::Operator;
-                new_node->data.ptr.left = std::move(node);
-                new_node->data.ptr.right = std::move(read_exp(tokens));
-                new_node->data.ptr.op = curr_token.op;
+            tokens.pop();
 
-                return new_node;
-            }
+            auto new_node = std::make_unique<ExprAST>();
+            new_node->type = ExprAST::Type::Operator;
+            new_node->data.ptr.left = std::move(node);
+            new_node->data.ptr.right = std::move(read_exp(tokens));
+            new_node->data.ptr.op = curr_token.op;
+
+            node = std::move(new_node);
         }
 
         return node;
@@ -206,11 +248,13 @@ namespace parser
     // |     term + term
     // |     term - term
     // ;
-    std::unique_ptr<ExprAST> read_expr(std::queue<tokenizer::Token>& tokens)
+    inline std::unique_ptr<ExprAST> read_expr(std::queue<tokenizer::Token>& tokens)
     {
         auto node = read_term(tokens);
 
-        if (!tokens.empty())
+        // Left to right: a - b + c is (a - b) + c. A sign with nothing
+        // before it is unary.
+        while (!tokens.empty())
         {
             auto curr_token = tokens.front();
 
@@ -218,56 +262,111 @@ namespace parser
             bool is_add = is_op && curr_token.op == types::Operators::Add;
             bool is_sub = is_op && curr_token.op == types::Operators::Sub;
 
-            if (is_add || is_sub)
+            if (!(is_add || is_sub))
             {
+                break;
+            }
 
-                tokens.pop();
-
-                if (node->type == ExprAST::Type::Operator ||
-                    node->type == ExprAST::Type::UnaryOperator ||
-                    node->type == ExprAST::Type::Nothing)
-                {
-                    auto new_node = std::make_unique<ExprAST>();
-
-                    new_node->type = ExprAST::Type::UnaryOperator;
-                    new_node->data.ptr.left = std::move(read_term(tokens));
-                    new_node->data.ptr.op = curr_token.op;
+            tokens.pop();
 
-                    return new_node;
-                }
+            auto new_node = std::make_unique<ExprAST>();
+            new_node->data.ptr.op = curr_token.op;
 
-                auto new_node = std::make_unique<ExprAST>();
+            if (node->type == ExprAST::Type::Nothing)
+            {
+                new_node->type = ExprAST::Type::UnaryOperator;
+                new_node->data.ptr.left = std::move(read_term(tokens));
+            }
+            else
+            {
                 new_node->type = ExprAST::Type::Operator;
                 new_node->data.ptr.left = std::move(node);
                 new_node->data.ptr.right = std::move(read_term(tokens));
-                new_node->data.ptr.op = curr_token.op;
-
-                return new_node;
             }
 
+            node = std::move(new_node);
         }
 
         return node;
     }
 
 
+    // Nodes in the tree under `node`, itself included.
+    inline std::size_t node_count(const ExprAST& node)
+    {
+        if (node.type != ExprAST::Type::Operator && node.type != ExprAST::Type::UnaryOperator
+            && node.type != ExprAST::Type::Function)
+        {
+            return 1;
+        }
+
+        const auto& children = node.data.ptr;
+
+        return 1 + (children.left ? node_count(*children.left) : 0)
+                 + (children.right ? node_count(*children.right) : 0);
+    }
+
+    // False if a factor is missing anywhere under `node`.
+    inline bool complete(const ExprAST& node)
+    {
+        if (node.type == ExprAST::Type::Nothing)
+        {
+            return false;
+        }
+
+        if (node.type != ExprAST::Type::Operator && node.type != ExprAST::Type::UnaryOperator
+            && node.type != ExprAST::Type::Function)
+        {
+            return true;
+        }
+
+        const auto& children = node.data.ptr;
+
+        return children.left && complete(*children.left) &&
+               (node.type != ExprAST::Type::Operator || (children.right && complete(*children.right)));
+    }
+
+    // The tree of the expression in `tokens`, or null if they are not
+    // exactly one whole expression: empty, with an error token, an
+    // operand missing, a parenthesis or bar left open, or anything left
+    // over at the end.
     template <typename Container>
     std::unique_ptr<ExprAST> create_ast(Container& tokens)
     {
-        return read_expr(tokens);
+        const instrument::Scope scope("parse");
+
+        auto ast = read_expr(tokens);
+
+        // Trailing blanks.
+        while (!tokens.empty() && tokens.front().type == tokenizer::Token::Type::EOL)
+        {
+            tokens.pop();
+        }
+
+        if (!tokens.empty() || !complete(*ast))
+        {
+            return nullptr;
+        }
+
+        if constexpr (instrument::enabled)
+        {
+            instrument::add(instrument::Counter::AstNodes, ast ? node_count(*ast) : 0);
+        }
+
+        return ast;
     }
 
     constexpr auto visit(ExprAST& node);
-    std::function<double(double)> visit_op(ExprAST& node);
-    std::function<double(double)> visit_uop(ExprAST& node);
-    std::function<double(double)> visit_fun(ExprAST& node);
+    inline std::function<double(double)> visit_op(ExprAST& node);
+    inline std::function<double(double)> visit_uop(ExprAST& node);
+    inline std::function<double(double)> visit_fun(ExprAST& node);
 
     constexpr auto visit_num(ExprAST& node)
     {
         return [&] (double x) { return node.data.value; };
     }
 
-    std::function<double(double)> visit_var(ExprAST& node)
+    inline std::function<double(double)> visit_var(ExprAST& node)
     {
         switch (node.data.variable)
         {
@@ -308,7 +407,7 @@ namespace parser
         };
     }
 
-    std::function<double(double)> visit_fun(ExprAST& node)
+    inline std::function<double(double)> visit_fun(ExprAST& node)
     {
         auto& left = *node.data.ptr.left.get();
 
@@ -367,7 +466,7 @@ namespace parser
     }
 
 
-    std::function<double(double)> visit_op(ExprAST& node)
+    inline std::function<double(double)> visit_op(ExprAST& node)
     {
         auto& left = *node.data.ptr.left.get();
         auto& right = *node.data.ptr.right.get();
@@ -406,7 +505,7 @@ namespace parser
         }
     }
 
-    std::function<double(double)> visit_uop(ExprAST& node)
+    inline std::function<double(double)> visit_uop(ExprAST& node)
     {
         auto& left = *node.data.ptr.left.get();
 
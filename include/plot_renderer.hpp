@@ -1,5 +1,10 @@
 #pragma once
 
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
 #include "tewi/Video/API/API.h"
 #include "tewi/Video/Renderer2D.hpp"
 #include "tewi/Video/BatchRenderer2D.hpp"
@@ -8,94 +13,356 @@
 #include "asl/types"
 #include "glm/glm.hpp"
 
-struct GraphPoint {
-    glm::vec2 pos;
-
-    struct Color
-    {
-        asl::mut_u8 r;
-        asl::mut_u8 g;
-        asl::mut_u8 b;
-        asl::mut_u8 a;
-    } color;
-};
-
-template <typename APITag, asl::i32 NumElem = 2000>
-class PlotRenderer2D { };
+#include "graph_point.hpp"
+#include "compact_curve.hpp"
+#include "plot_renderer_fwd.hpp"
 
+// The vertex buffer is allocated once with immutable storage, mapped
+// persistently and split in three regions used round-robin by consecutive
+// frames, each guarded by a fence. Writes go to a CPU-side copy and only
+// the ranges that changed are copied into a region when it comes up
+// again, so there are no map/unmap calls and no full uploads per frame.
+// Requires GL 4.4 or ARB_buffer_storage.
 template <asl::i32 NumElem>
 class PlotRenderer2D<tewi::API::OpenGLTag, NumElem>
 {
 public:
+    static constexpr asl::i32 regions = 3;
+
     PlotRenderer2D(const std::array<GraphPoint, NumElem>& data)
+        : PlotRenderer2D(data.data(), NumElem)
     {
-        glGenVertexArrays(1, &m_VAO);
-        glGenBuffers(1, &m_VBO);
+    }
 
-        glBindVertexArray(m_VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    PlotRenderer2D(const std::vector<GraphPoint>& data)
+        : PlotRenderer2D(data.data(), static_cast<asl::i32>(data.size()))
+    {
+    }
 
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
+    PlotRenderer2D(const GraphPoint* data, asl::i32 size)
+        : PlotRenderer2D(size)
+    {
+        update(0, data, size);
+        resize(size);
+    }
+
+    explicit PlotRenderer2D(asl::i32 capacity)
+        : m_capacity(std::max(capacity, 1)),
+          m_shadow(m_capacity)
+    {
+        create_storage();
+    }
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GraphPoint), (const void*)0);
-        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GraphPoint), (const void*)offsetof(GraphPoint, color));
+    ~PlotRenderer2D()
+    {
+        destroy_storage();
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GraphPoint) * NumElem, &data[0], GL_STATIC_DRAW);
+    PlotRenderer2D(const PlotRenderer2D&) = delete;
+    PlotRenderer2D& operator=(const PlotRenderer2D&) = delete;
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
+    asl::i32 capacity() const { return m_capacity; }
+    asl::i32 size() const { return m_size; }
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    // Number of vertices drawn by draw(rend_type).
+    void resize(asl::i32 size)
+    {
+        m_size = std::min(size, m_capacity);
     }
 
-    void begin()
+    // Grows the buffer to hold at least `capacity` vertices. Immutable
+    // storage cannot be resized, so the storage is recreated and every
+    // region gets the whole content again.
+    void reserve(asl::i32 capacity)
     {
-        glBindVertexArray(m_VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        if (capacity <= m_capacity)
+        {
+            return;
+        }
+
+        destroy_storage();
+
+        m_capacity = std::max(capacity, m_capacity + m_capacity / 2);
+        m_shadow.resize(m_capacity);
 
-        m_lastPoint = reinterpret_cast<GraphPoint*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+        for (auto& dirty : m_dirty)
+        {
+            dirty.assign(1, { 0, m_capacity });
+        }
+
+        m_region = 0;
+        m_drawn = false;
+
+        create_storage();
     }
 
-    void add(GraphPoint* begin, asl::i32 size)
+    // Writes `count` vertices starting at `offset`. The range reaches the
+    // GPU copies at the next begin() of each region.
+    void update(asl::i32 offset, const GraphPoint* data, asl::i32 count)
     {
-        for (asl::mut_i32 i = 0; i < size; ++i)
+        const asl::i32 clamped = std::min(count, m_capacity - offset);
+
+        if (clamped <= 0)
         {
-            m_lastPoint->pos = begin[i].pos;
-            m_lastPoint->color = begin[i].color;
-            tewi::Log::info(std::to_string(m_lastPoint->pos.y));
-            ++m_lastPoint;
+            return;
         }
+
+        std::copy(data, data + clamped, m_shadow.begin() + offset);
+
+        for (auto& dirty : m_dirty)
+        {
+            dirty.push_back({ offset, clamped });
+        }
+    }
+
+    // Moves to the next region, waits until the GPU is done with it and
+    // copies in the ranges changed since it was last used.
+    void begin()
+    {
+        if (m_drawn)
+        {
+            m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            m_region = (m_region + 1) % regions;
+            m_drawn = false;
+        }
+
+        if (GLsync fence = m_fences[m_region])
+        {
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+
+            glDeleteSync(fence);
+            m_fences[m_region] = nullptr;
+        }
+
+        GraphPoint* region = m_mapped + m_capacity * m_region;
+
+        for (const auto& range : m_dirty[m_region])
+        {
+            std::copy(m_shadow.begin() + range.offset,
+                      m_shadow.begin() + range.offset + range.count,
+                      region + range.offset);
+        }
+
+        m_dirty[m_region].clear();
     }
 
     void end()
     {
-        glUnmapBuffer(GL_ARRAY_BUFFER);
+        m_drawn = true;
+    }
+
+    void draw(asl::mut_num rend_type)
+    {
+        draw(rend_type, 0, m_size);
+    }
+
+    // Draws several ranges of the buffer with a single call.
+    void draw_strips(asl::mut_num rend_type, const StripList& strips)
+    {
+        glBindVertexArray(m_VAO[m_region]);
+
+        glMultiDrawArrays(rend_type, strips.first.data(), strips.count.data(),
+                          static_cast<GLsizei>(strips.size()));
+
+        glBindVertexArray(0);
+    }
+
+    void draw(asl::mut_num rend_type, asl::mut_num start, asl::mut_num end)
+    {
+        glBindVertexArray(m_VAO[m_region]);
+
+        glDrawArrays(rend_type, start, end);
+
+        glBindVertexArray(0);
+    }
+
+private:
+    struct Range
+    {
+        asl::mut_i32 offset;
+        asl::mut_i32 count;
+    };
+
+    void create_storage()
+    {
+        glGenVertexArrays(regions, m_VAO.data());
+        glGenBuffers(1, &m_VBO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr bytes = sizeof(GraphPoint) * m_capacity * regions;
+
+        glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+        m_mapped = reinterpret_cast<GraphPoint*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+
+        // One VAO per region, so draws use the same indices whatever
+        // region is current. The attribute state is set up here once;
+        // draws only bind the VAO.
+        for (asl::mut_i32 r = 0; r < regions; ++r)
+        {
+            const auto base = sizeof(GraphPoint) * m_capacity * r;
+
+            glBindVertexArray(m_VAO[r]);
+
+            glEnableVertexAttribArray(0);
+            glEnableVertexAttribArray(1);
+
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GraphPoint), (const void*)(base));
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GraphPoint), (const void*)(base + offsetof(GraphPoint, color)));
+        }
+
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
     }
 
-    void draw(asl::mut_num rend_type, asl::mut_num start = 0, asl::mut_num end = NumElem)
+    void destroy_storage()
     {
-        glBindVertexArray(m_VAO);
+        for (auto& fence : m_fences)
+        {
+            if (fence)
+            {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glDeleteBuffers(1, &m_VBO);
+        glDeleteVertexArrays(regions, m_VAO.data());
+    }
 
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
+    asl::mut_i32 m_capacity;
+    asl::mut_i32 m_size = 0;
 
+    std::vector<GraphPoint> m_shadow;
+    std::array<std::vector<Range>, regions> m_dirty;
+    std::array<GLsync, regions> m_fences {};
 
-        glDrawArrays(rend_type, start, end);
+    GraphPoint* m_mapped = nullptr;
+    asl::mut_i32 m_region = 0;
+    bool m_drawn = false;
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
+    std::array<GLuint, regions> m_VAO;
+    GLuint m_VBO;
+};
+
+// Draws a CompactCurve with g_vertsrc in implicitX mode. The y array is
+// uploaded once into immutable storage; the per-curve values go in
+// uniforms at every draw.
+template <>
+class CompactRenderer2D<tewi::API::OpenGLTag>
+{
+public:
+    struct Locations
+    {
+        GLint implicit_x;
+        GLint x_origin;
+        GLint x_step;
+        GLint y_offset;
+        GLint y_scale;
+        GLint curve_color;
+    };
+
+    template <typename Program>
+    static Locations locate(Program& shader)
+    {
+        return { shader.getUniformLocation("implicitX"),
+                 shader.getUniformLocation("xOrigin"),
+                 shader.getUniformLocation("xStep"),
+                 shader.getUniformLocation("yOffset"),
+                 shader.getUniformLocation("yScale"),
+                 shader.getUniformLocation("curveColor") };
+    }
 
+    explicit CompactRenderer2D(const CompactCurve& curve)
+        : CompactRenderer2D(curve.view())
+    {
+    }
+
+    // The y array is read from the view at construction only, so it may
+    // be mapped memory that is unmapped afterwards.
+    explicit CompactRenderer2D(const CompactView& curve)
+        : m_origin(curve.origin),
+          m_step(curve.step),
+          m_yOffset(curve.y_offset),
+          m_yScale(curve.y_scale),
+          m_color(curve.color)
+    {
+        const bool quantized = curve.format == CompactCurve::Format::Quantized16;
+        const GLenum type = quantized ? GL_UNSIGNED_SHORT :
+                            (curve.format == CompactCurve::Format::Double) ? GL_DOUBLE : GL_FLOAT;
+
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+
+        glBufferStorage(GL_ARRAY_BUFFER, std::max<GLsizeiptr>(curve.bytes(), 1), curve.data, 0);
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, type, quantized ? GL_TRUE : GL_FALSE, 0, nullptr);
+
+        glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~CompactRenderer2D()
+    {
+        glDeleteBuffers(1, &m_VBO);
+        glDeleteVertexArrays(1, &m_VAO);
+    }
+
+    CompactRenderer2D(const CompactRenderer2D&) = delete;
+    CompactRenderer2D& operator=(const CompactRenderer2D&) = delete;
+
+    void draw(const Locations& loc, asl::mut_num rend_type, asl::mut_num start, asl::mut_num count)
+    {
+        set_uniforms(loc);
+
+        glBindVertexArray(m_VAO);
+        glDrawArrays(rend_type, start, count);
         glBindVertexArray(0);
+
+        glUniform1i(loc.implicit_x, 0);
+    }
+
+    void draw_strips(const Locations& loc, asl::mut_num rend_type, const StripList& strips)
+    {
+        set_uniforms(loc);
+
+        glBindVertexArray(m_VAO);
+        glMultiDrawArrays(rend_type, strips.first.data(), strips.count.data(),
+                          static_cast<GLsizei>(strips.size()));
+        glBindVertexArray(0);
+
+        glUniform1i(loc.implicit_x, 0);
     }
 
 private:
-    GraphPoint* m_lastPoint;
+    void set_uniforms(const Locations& loc)
+    {
+        glUniform1i(loc.implicit_x, 1);
+        glUniform1f(loc.x_origin, m_origin);
+        glUniform1f(loc.x_step, m_step);
+        glUniform1f(loc.y_offset, m_yOffset);
+        glUniform1f(loc.y_scale, m_yScale);
+        glUniform4f(loc.curve_color, m_color.r / 255.0f, m_color.g / 255.0f,
+                    m_color.b / 255.0f, m_color.a / 255.0f);
+    }
+
+    asl::mut_f32 m_origin;
+    asl::mut_f32 m_step;
+    asl::mut_f32 m_yOffset;
+    asl::mut_f32 m_yScale;
+    GraphPoint::Color m_color;
+
     GLuint m_VAO;
     GLuint m_VBO;
 };
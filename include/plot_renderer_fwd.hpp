@@ -0,0 +1,12 @@
+#pragma once
+
+#include "asl/types"
+
+// Specialized once per backend: OpenGL in plot_renderer.hpp, the software
+// rasterizer in software_renderer.hpp.
+template <typename APITag, asl::i32 NumElem = 2000>
+class PlotRenderer2D { };
+
+// Renderer of a CompactCurve, specialized alongside PlotRenderer2D.
+template <typename APITag>
+class CompactRenderer2D { };
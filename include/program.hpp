@@ -0,0 +1,413 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+
+#include "common_types.h"
+#include "parser.hpp"
+#include "instrument.hpp"
+
+namespace bytecode
+{
+    enum class Op : std::uint8_t
+    {
+        Constant,
+        X,
+        Y,
+
+        Add, Sub, Mul, Div, Pow, Mod,
+        Neg, Abs,
+
+        Sin, Cos, Tan,
+        Asin, Acos, Atan,
+        Log, Ln,
+        Sqrt, Cbrt
+    };
+
+    // One register per instruction: operands are the registers of earlier
+    // instructions, so the program is a DAG in evaluation order.
+    struct Instruction
+    {
+        Op op;
+        std::uint32_t a;
+        std::uint32_t b;
+        double value;
+    };
+
+    // An expression compiled to a flat list of instructions, evaluated a
+    // block of points at a time: every instruction runs over the whole
+    // block before the next one, instead of walking the tree once per
+    // point. Equal subexpressions are compiled once and constant ones are
+    // folded.
+    //
+    // A program may have several outputs, computed together: the two
+    // coordinates of a parametric curve share the instructions they have
+    // in common.
+    //
+    // Variables follow parser::visit: 'y' is the second input when there
+    // is one and x otherwise, 'z' and 't' are x, 'e' and 'p' are the
+    // constants. Evaluation does not change the program, so one program
+    // can be evaluated from many threads.
+    class Program
+    {
+    public:
+        static constexpr std::size_t block_size = 64;
+
+        // A function, or the two coordinates of a path.
+        static constexpr std::size_t max_outputs = 2;
+
+        Program() = default;
+
+        explicit Program(const parser::ExprAST& ast)
+        {
+            m_outputs.push_back(compile(ast));
+        }
+
+        // The curve (x(t), y(t)), as two outputs.
+        static Program parametric(const parser::ExprAST& x, const parser::ExprAST& y)
+        {
+            Program p;
+            p.m_outputs.push_back(p.compile(x));
+            p.m_outputs.push_back(p.compile(y));
+
+            return p;
+        }
+
+        // The polar curve r(t), as the two outputs r cos t and r sin t.
+        static Program polar(const parser::ExprAST& r)
+        {
+            Program p;
+            const auto radius = p.compile(r);
+            const auto angle = p.emit(Op::X, 0, 0);
+
+            p.m_outputs.push_back(p.emit(Op::Mul, radius, p.emit(Op::Cos, angle, 0)));
+            p.m_outputs.push_back(p.emit(Op::Mul, radius, p.emit(Op::Sin, angle, 0)));
+
+            return p;
+        }
+
+        // False for a default program, or the result of compiling text
+        // that is not an expression: it must not be evaluated.
+        bool valid() const { return !m_outputs.empty(); }
+
+        std::size_t size() const { return m_code.size(); }
+        std::size_t outputs() const { return m_outputs.size(); }
+        const std::vector<Instruction>& code() const { return m_code; }
+
+        // True when the expression reads the second input.
+        bool uses_y() const { return m_usesY; }
+
+        // out[i] = f(x[i], y[i]) for i < count, from the first output; y
+        // may be null.
+        void evaluate(const double* x, const double* y, double* out, std::size_t count) const
+        {
+            instrument::add_local(instrument::Counter::Evaluations, count);
+
+            std::vector<double>& regs = scratch();
+
+            for (std::size_t first = 0; first < count; first += block_size)
+            {
+                const std::size_t n = std::min(block_size, count - first);
+
+                run(regs.data(), x + first, (y != nullptr) ? y + first : x + first, n);
+                std::memcpy(out + first, reg(regs.data(), m_outputs[0]), n * sizeof(double));
+            }
+        }
+
+        // out[i] = f(from + i * step) for i < count, from the first
+        // output. Fits sampling::SampleBuffer's batched constructor.
+        void evaluate_grid(double from, double step, std::size_t count, double* out) const
+        {
+            for_each_block(from, step, count,
+                           [out] (std::size_t first, std::size_t n, const double* const* outputs) {
+                std::memcpy(out + first, outputs[0], n * sizeof(double));
+            });
+        }
+
+        // Evaluates every output at x_i = from + i * step, i < count, a
+        // block at a time, and calls sink(first, n, outputs) for each
+        // block: outputs[k][j] is output k at x_(first + j). The values
+        // live in the registers, so they are only valid during the call.
+        template <typename Sink>
+        void for_each_block(double from, double step, std::size_t count, Sink&& sink) const
+        {
+            instrument::add_local(instrument::Counter::Evaluations, count);
+
+            std::vector<double>& regs = scratch();
+            const double* outputs[max_outputs] = {};
+
+            for (std::size_t k = 0; k < m_outputs.size(); ++k)
+            {
+                outputs[k] = reg(regs.data(), m_outputs[k]);
+            }
+
+            double x[block_size];
+
+            for (std::size_t first = 0; first < count; first += block_size)
+            {
+                const std::size_t n = std::min(block_size, count - first);
+
+                for (std::size_t j = 0; j < n; ++j)
+                {
+                    x[j] = from + (first + j) * step;
+                }
+
+                run(regs.data(), x, x, n);
+                sink(first, n, static_cast<const double* const*>(outputs));
+            }
+        }
+
+        double operator()(double x, double y) const
+        {
+            double out = 0.0;
+            evaluate(&x, &y, &out, 1);
+
+            return out;
+        }
+
+        double operator()(double x) const
+        {
+            return (*this)(x, x);
+        }
+
+    private:
+        struct Key
+        {
+            Op op;
+            std::uint32_t a;
+            std::uint32_t b;
+            double value;
+
+            bool operator==(const Key& other) const
+            {
+                return op == other.op && a == other.a && b == other.b &&
+                       std::memcmp(&value, &other.value, sizeof(double)) == 0;
+            }
+        };
+
+        struct KeyHash
+        {
+            std::size_t operator()(const Key& k) const
+            {
+                std::uint64_t bits = 0;
+                std::memcpy(&bits, &k.value, sizeof(bits));
+
+                std::size_t h = static_cast<std::size_t>(k.op);
+                h = h * 1000003u ^ k.a;
+                h = h * 1000003u ^ k.b;
+                h = h * 1000003u ^ static_cast<std::size_t>(bits ^ (bits >> 32));
+
+                return h;
+            }
+        };
+
+        static double* reg(double* regs, std::uint32_t index)
+        {
+            return regs + static_cast<std::size_t>(index) * block_size;
+        }
+
+        std::vector<double>& scratch() const
+        {
+            thread_local std::vector<double> regs;
+
+            if (regs.size() < m_code.size() * block_size)
+            {
+                regs.resize(m_code.size() * block_size);
+            }
+
+            return regs;
+        }
+
+        std::uint32_t compile(const parser::ExprAST& node)
+        {
+            switch (node.type)
+            {
+            case parser::ExprAST::Type::Nothing:
+                return constant(0.0);
+
+            case parser::ExprAST::Type::Number:
+                return constant(node.data.value);
+
+            case parser::ExprAST::Type::Variable:
+                switch (node.data.variable)
+                {
+                case 'e':
+                    return constant(2.71828);
+
+                case 'p':
+                    return constant(3.14);
+
+                case 'y':
+                    m_usesY = true;
+                    return emit(Op::Y, 0, 0);
+
+                default:
+                    return emit(Op::X, 0, 0);
+                }
+
+            case parser::ExprAST::Type::Operator:
+            {
+                const auto a = compile(*node.data.ptr.left);
+                const auto b = compile(*node.data.ptr.right);
+
+                switch (node.data.ptr.op)
+                {
+                case types::Operators::Add: return emit(Op::Add, a, b);
+                case types::Operators::Sub: return emit(Op::Sub, a, b);
+                case types::Operators::Mul: return emit(Op::Mul, a, b);
+                case types::Operators::Div: return emit(Op::Div, a, b);
+                case types::Operators::Exp: return emit(Op::Pow, a, b);
+                case types::Operators::Mod: return emit(Op::Mod, a, b);
+                default:                    return constant(0.0);
+                }
+            }
+
+            case parser::ExprAST::Type::UnaryOperator:
+            {
+                const auto a = compile(*node.data.ptr.left);
+
+                switch (node.data.ptr.op)
+                {
+                case types::Operators::Sub: return emit(Op::Neg, a, 0);
+                case types::Operators::Abs: return emit(Op::Abs, a, 0);
+                default:                    return a;
+                }
+            }
+
+            case parser::ExprAST::Type::Function:
+            {
+                const auto a = compile(*node.data.ptr.left);
+
+                switch (node.data.ptr.fun)
+                {
+                case types::Functions::Sin:  return emit(Op::Sin, a, 0);
+                case types::Functions::Cos:  return emit(Op::Cos, a, 0);
+                case types::Functions::Tan:  return emit(Op::Tan, a, 0);
+                case types::Functions::Asin: return emit(Op::Asin, a, 0);
+                case types::Functions::Acos: return emit(Op::Acos, a, 0);
+                case types::Functions::Atan: return emit(Op::Atan, a, 0);
+                case types::Functions::Log:  return emit(Op::Log, a, 0);
+                case types::Functions::Ln:   return emit(Op::Ln, a, 0);
+                case types::Functions::Sqrt: return emit(Op::Sqrt, a, 0);
+                case types::Functions::Cbrt: return emit(Op::Cbrt, a, 0);
+                default:                     return constant(0.0);
+                }
+            }
+            }
+
+            return constant(0.0);
+        }
+
+        std::uint32_t constant(double value)
+        {
+            return intern({ Op::Constant, 0, 0, value });
+        }
+
+        // Folds the instruction if its operands are constants. X and Y
+        // have no operands.
+        std::uint32_t emit(Op op, std::uint32_t a, std::uint32_t b)
+        {
+            if (op != Op::X && op != Op::Y &&
+                m_code[a].op == Op::Constant && (!binary(op) || m_code[b].op == Op::Constant))
+            {
+                const double lhs = m_code[a].value;
+                const double rhs = binary(op) ? m_code[b].value : 0.0;
+                double result = 0.0;
+
+                step({ op, 0, 0, 0.0 }, &lhs, &rhs, &result, nullptr, nullptr, 1);
+
+                return constant(result);
+            }
+
+            return intern({ op, a, binary(op) ? b : 0, 0.0 });
+        }
+
+        std::uint32_t intern(const Key& key)
+        {
+            if (const auto it = m_index.find(key); it != m_index.end())
+            {
+                return it->second;
+            }
+
+            const auto index = static_cast<std::uint32_t>(m_code.size());
+
+            m_code.push_back({ key.op, key.a, key.b, key.value });
+            m_index.emplace(key, index);
+
+            return index;
+        }
+
+        static bool binary(Op op)
+        {
+            return op >= Op::Add && op <= Op::Mod;
+        }
+
+        // Every instruction over `n` points.
+        void run(double* regs, const double* x, const double* y, std::size_t n) const
+        {
+            for (std::size_t i = 0; i < m_code.size(); ++i)
+            {
+                const Instruction& in = m_code[i];
+
+                step(in, reg(regs, in.a), reg(regs, in.b),
+                     reg(regs, static_cast<std::uint32_t>(i)), x, y, n);
+            }
+        }
+
+        static void step(const Instruction& in, const double* a, const double* b, double* out,
+                         const double* x, const double* y, std::size_t n)
+        {
+            switch (in.op)
+            {
+            case Op::Constant: std::fill(out, out + n, in.value); break;
+            case Op::X:        std::copy(x, x + n, out); break;
+            case Op::Y:        std::copy(y, y + n, out); break;
+
+            case Op::Add: for (std::size_t i = 0; i < n; ++i) out[i] = a[i] + b[i]; break;
+            case Op::Sub: for (std::size_t i = 0; i < n; ++i) out[i] = a[i] - b[i]; break;
+            case Op::Mul: for (std::size_t i = 0; i < n; ++i) out[i] = a[i] * b[i]; break;
+            case Op::Div: for (std::size_t i = 0; i < n; ++i) out[i] = a[i] / b[i]; break;
+            case Op::Pow: for (std::size_t i = 0; i < n; ++i) out[i] = std::pow(a[i], b[i]); break;
+            case Op::Mod: for (std::size_t i = 0; i < n; ++i) out[i] = std::fmod(a[i], b[i]); break;
+
+            case Op::Neg: for (std::size_t i = 0; i < n; ++i) out[i] = -a[i]; break;
+            case Op::Abs: for (std::size_t i = 0; i < n; ++i) out[i] = std::abs(a[i]); break;
+
+            case Op::Sin:  for (std::size_t i = 0; i < n; ++i) out[i] = std::sin(a[i]); break;
+            case Op::Cos:  for (std::size_t i = 0; i < n; ++i) out[i] = std::cos(a[i]); break;
+            case Op::Tan:  for (std::size_t i = 0; i < n; ++i) out[i] = std::tan(a[i]); break;
+            case Op::Asin: for (std::size_t i = 0; i < n; ++i) out[i] = std::asin(a[i]); break;
+            case Op::Acos: for (std::size_t i = 0; i < n; ++i) out[i] = std::acos(a[i]); break;
+            case Op::Atan: for (std::size_t i = 0; i < n; ++i) out[i] = std::atan(a[i]); break;
+            case Op::Log:  for (std::size_t i = 0; i < n; ++i) out[i] = std::log10(a[i]); break;
+            case Op::Ln:   for (std::size_t i = 0; i < n; ++i) out[i] = std::log(a[i]); break;
+            case Op::Sqrt: for (std::size_t i = 0; i < n; ++i) out[i] = std::sqrt(a[i]); break;
+            case Op::Cbrt: for (std::size_t i = 0; i < n; ++i) out[i] = std::cbrt(a[i]); break;
+            }
+        }
+
+        std::vector<Instruction> m_code;
+        std::unordered_map<Key, std::uint32_t, KeyHash> m_index;
+        std::vector<std::uint32_t> m_outputs;
+        bool m_usesY = false;
+    };
+
+    // Tokenizes, parses and compiles `str` in one go. The program keeps
+    // nothing of the tree.
+    // An invalid program if `str` does not parse.
+    inline Program compile(const std::string& str)
+    {
+        const instrument::Scope scope("compile");
+
+        auto tokens = tokenizer::tokenize(str);
+        const auto ast = parser::create_ast(tokens);
+
+        return ast ? Program(*ast) : Program();
+    }
+}
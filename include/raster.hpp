@@ -0,0 +1,393 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "asl/types"
+#include "glm/glm.hpp"
+
+#include "graph_point.hpp"
+
+namespace raster
+{
+    using Color = GraphPoint::Color;
+
+    // Rectangle of pixels a pass may write to, [x0, x1) x [y0, y1).
+    struct Clip
+    {
+        asl::mut_i32 x0;
+        asl::mut_i32 y0;
+        asl::mut_i32 x1;
+        asl::mut_i32 y1;
+    };
+
+    // RGBA8 image, row 0 at the top. Pixels are packed as r | g << 8 |
+    // b << 16 | a << 24, which is r, g, b, a in memory on little-endian
+    // machines.
+    class Framebuffer
+    {
+    public:
+        Framebuffer(asl::i32 width, asl::i32 height)
+            : m_width(std::max(width, 1)),
+              m_height(std::max(height, 1)),
+              m_pixels(static_cast<std::size_t>(m_width) * m_height, 0)
+        {
+        }
+
+        asl::i32 width() const { return m_width; }
+        asl::i32 height() const { return m_height; }
+
+        Clip bounds() const { return { 0, 0, m_width, m_height }; }
+
+        static std::uint32_t pack(Color c)
+        {
+            return static_cast<std::uint32_t>(c.r) |
+                   static_cast<std::uint32_t>(c.g) << 8 |
+                   static_cast<std::uint32_t>(c.b) << 16 |
+                   static_cast<std::uint32_t>(c.a) << 24;
+        }
+
+        static Color unpack(std::uint32_t p)
+        {
+            return { static_cast<asl::mut_u8>(p & 0xFF),
+                     static_cast<asl::mut_u8>((p >> 8) & 0xFF),
+                     static_cast<asl::mut_u8>((p >> 16) & 0xFF),
+                     static_cast<asl::mut_u8>(p >> 24) };
+        }
+
+        Color pixel(asl::i32 x, asl::i32 y) const
+        {
+            return unpack(m_pixels[index(x, y)]);
+        }
+
+        const std::uint32_t* row(asl::i32 y) const { return m_pixels.data() + index(0, y); }
+        std::uint32_t* row(asl::i32 y) { return m_pixels.data() + index(0, y); }
+
+        void clear(Color c)
+        {
+            std::fill(m_pixels.begin(), m_pixels.end(), pack(c));
+        }
+
+        // Blends `c` over [x0, x1) of row y with `coverage` in [0, 1].
+        // Opaque spans are plain stores; translucent ones are blended four
+        // pixels at a time with SSE2 where available.
+        void fill_span(asl::i32 y, asl::mut_i32 x0, asl::mut_i32 x1, Color c,
+                       asl::f32 coverage = 1.0f)
+        {
+            if (y < 0 || y >= m_height)
+            {
+                return;
+            }
+
+            x0 = std::max(x0, 0);
+            x1 = std::min(x1, m_width);
+
+            const auto alpha = static_cast<std::uint32_t>(c.a * std::clamp(coverage, 0.0f, 1.0f) + 0.5f);
+
+            if (x0 >= x1 || alpha == 0)
+            {
+                return;
+            }
+
+            std::uint32_t* dst = row(y) + x0;
+            std::size_t count = x1 - x0;
+
+            if (alpha == 255)
+            {
+                std::fill_n(dst, count, pack(c));
+                return;
+            }
+
+            const std::uint32_t inv = 255 - alpha;
+
+#if defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i inv16 = _mm_set1_epi16(static_cast<short>(inv));
+            const __m128i src16 = _mm_set_epi16(
+                static_cast<short>(255 * alpha), static_cast<short>(c.b * alpha),
+                static_cast<short>(c.g * alpha), static_cast<short>(c.r * alpha),
+                static_cast<short>(255 * alpha), static_cast<short>(c.b * alpha),
+                static_cast<short>(c.g * alpha), static_cast<short>(c.r * alpha));
+            const __m128i half = _mm_set1_epi16(128);
+
+            const auto blend8 = [&] (__m128i d) {
+                __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(d, inv16), src16), half);
+                return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            };
+
+            for (; count >= 4; count -= 4, dst += 4)
+            {
+                const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+                const __m128i lo = blend8(_mm_unpacklo_epi8(d, zero));
+                const __m128i hi = blend8(_mm_unpackhi_epi8(d, zero));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+            }
+#endif
+
+            const std::uint32_t src[4] = { c.r * alpha, c.g * alpha, c.b * alpha, 255 * alpha };
+
+            for (; count > 0; --count, ++dst)
+            {
+                std::uint32_t out = 0;
+
+                for (asl::mut_i32 k = 0; k < 4; ++k)
+                {
+                    const std::uint32_t d = (*dst >> (8 * k)) & 0xFF;
+                    const std::uint32_t t = d * inv + src[k] + 128;
+
+                    out |= ((t + (t >> 8)) >> 8) << (8 * k);
+                }
+
+                *dst = out;
+            }
+        }
+
+        void blend(asl::i32 x, asl::i32 y, Color c, asl::f32 coverage)
+        {
+            fill_span(y, x, x + 1, c, coverage);
+        }
+
+    private:
+        std::size_t index(asl::i32 x, asl::i32 y) const
+        {
+            return static_cast<std::size_t>(y) * m_width + x;
+        }
+
+        asl::mut_i32 m_width;
+        asl::mut_i32 m_height;
+        std::vector<std::uint32_t> m_pixels;
+    };
+
+    namespace detail
+    {
+        inline Color mix(Color a, Color b, asl::f32 t)
+        {
+            const auto lerp = [t] (asl::mut_u8 u, asl::mut_u8 v) {
+                return static_cast<asl::mut_u8>(u + (v - u) * t + 0.5f);
+            };
+
+            return { lerp(a.r, b.r), lerp(a.g, b.g), lerp(a.b, b.b), lerp(a.a, b.a) };
+        }
+
+        // Liang-Barsky: shrinks a-b to the part inside the rectangle.
+        inline bool clip_segment(glm::vec2& a, glm::vec2& b, asl::mut_f32& ta, asl::mut_f32& tb,
+                                 asl::f32 x0, asl::f32 y0, asl::f32 x1, asl::f32 y1)
+        {
+            const asl::f32 dx = b.x - a.x;
+            const asl::f32 dy = b.y - a.y;
+
+            asl::mut_f32 t0 = 0.0f;
+            asl::mut_f32 t1 = 1.0f;
+
+            const asl::f32 p[4] = { -dx, dx, -dy, dy };
+            const asl::f32 q[4] = { a.x - x0, x1 - a.x, a.y - y0, y1 - a.y };
+
+            for (asl::mut_i32 i = 0; i < 4; ++i)
+            {
+                if (p[i] == 0.0f)
+                {
+                    if (q[i] < 0.0f)
+                    {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                const asl::f32 r = q[i] / p[i];
+
+                if (p[i] < 0.0f)
+                {
+                    t0 = std::max(t0, r);
+                }
+                else
+                {
+                    t1 = std::min(t1, r);
+                }
+            }
+
+            if (t0 > t1)
+            {
+                return false;
+            }
+
+            const glm::vec2 start = a;
+
+            a = glm::vec2(start.x + t0 * dx, start.y + t0 * dy);
+            b = glm::vec2(start.x + t1 * dx, start.y + t1 * dy);
+            ta = t0;
+            tb = t1;
+
+            return true;
+        }
+    }
+
+    // One pixel wide antialiased line (Xiaolin Wu), with the colour
+    // interpolated between the endpoints. Only pixels inside `clip` are
+    // written, so disjoint clips can be drawn from different threads; the
+    // line is clipped to the whole framebuffer first, so the pixels do not
+    // depend on how the image is split.
+    inline void draw_line(Framebuffer& fb, Clip clip, glm::vec2 a, glm::vec2 b,
+                          Color ca, Color cb)
+    {
+        asl::mut_f32 ta = 0.0f;
+        asl::mut_f32 tb = 1.0f;
+
+        if (!std::isfinite(a.x) || !std::isfinite(a.y) ||
+            !std::isfinite(b.x) || !std::isfinite(b.y) ||
+            !detail::clip_segment(a, b, ta, tb, -2.0f, -2.0f,
+                                  fb.width() + 2.0f, fb.height() + 2.0f))
+        {
+            return;
+        }
+
+        const Color c0 = detail::mix(ca, cb, ta);
+        const Color c1 = detail::mix(ca, cb, tb);
+
+        const auto plot = [&] (asl::i32 x, asl::i32 y, asl::f32 coverage, asl::f32 t) {
+            if (x >= clip.x0 && x < clip.x1 && y >= clip.y0 && y < clip.y1)
+            {
+                fb.blend(x, y, detail::mix(c0, c1, t), coverage);
+            }
+        };
+
+        // Pixel centres are at integer + 0.5.
+        asl::mut_f32 x0 = a.x - 0.5f;
+        asl::mut_f32 y0 = a.y - 0.5f;
+        asl::mut_f32 x1 = b.x - 0.5f;
+        asl::mut_f32 y1 = b.y - 0.5f;
+
+        const bool steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+
+        if (steep)
+        {
+            std::swap(x0, y0);
+            std::swap(x1, y1);
+        }
+
+        const bool reversed = x0 > x1;
+
+        if (reversed)
+        {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+        }
+
+        const asl::f32 dx = x1 - x0;
+        const asl::f32 gradient = (dx == 0.0f) ? 1.0f : (y1 - y0) / dx;
+
+        const auto put = [&] (asl::i32 major, asl::i32 minor, asl::f32 coverage) {
+            const asl::f32 t = (dx == 0.0f) ? 0.0f : std::clamp((major - x0) / dx, 0.0f, 1.0f);
+
+            if (steep)
+            {
+                plot(minor, major, coverage, reversed ? 1.0f - t : t);
+            }
+            else
+            {
+                plot(major, minor, coverage, reversed ? 1.0f - t : t);
+            }
+        };
+
+        const auto first = static_cast<asl::mut_i32>(std::round(x0));
+        const auto last = static_cast<asl::mut_i32>(std::round(x1));
+
+        // Only walk the part of the line that can reach the clip rows.
+        asl::mut_i32 from = first;
+        asl::mut_i32 to = last;
+
+        if (steep)
+        {
+            from = std::max(from, clip.y0 - 1);
+            to = std::min(to, clip.y1);
+        }
+        else if (gradient != 0.0f)
+        {
+            const asl::f32 xa = x0 + (clip.y0 - 2 - y0) / gradient;
+            const asl::f32 xb = x0 + (clip.y1 + 1 - y0) / gradient;
+
+            from = std::max(from, static_cast<asl::mut_i32>(std::floor(std::min(xa, xb))));
+            to = std::min(to, static_cast<asl::mut_i32>(std::ceil(std::max(xa, xb))));
+        }
+
+        for (asl::mut_i32 x = from; x <= to; ++x)
+        {
+            // Endpoints only cover the part of their pixel inside the line.
+            asl::mut_f32 weight = 1.0f;
+
+            if (x == first)
+            {
+                weight = std::min(1.0f, 1.0f - (x0 + 0.5f - first));
+            }
+
+            if (x == last)
+            {
+                weight = (first == last) ? std::max(dx, 0.1f)
+                                         : std::min(1.0f, x1 + 0.5f - last);
+            }
+
+            const asl::f32 y = y0 + gradient * (x - x0);
+            const asl::f32 base = std::floor(y);
+            const asl::f32 frac = y - base;
+            const auto iy = static_cast<asl::mut_i32>(base);
+
+            put(x, iy, (1.0f - frac) * weight);
+            put(x, iy + 1, frac * weight);
+        }
+    }
+
+    // Square point of side `size` centred on p, like GL_POINTS; the
+    // border rows and columns are blended by how much of them it covers.
+    inline void draw_point(Framebuffer& fb, Clip clip, glm::vec2 p, asl::f32 size, Color c)
+    {
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || size <= 0.0f)
+        {
+            return;
+        }
+
+        const asl::f32 half = std::max(size, 1.0f) / 2.0f;
+        const asl::f32 density = std::min(size, 1.0f) * std::min(size, 1.0f);
+
+        const asl::f32 left = p.x - half;
+        const asl::f32 right = p.x + half;
+        const asl::f32 top = p.y - half;
+        const asl::f32 bottom = p.y + half;
+
+        const auto cover = [] (asl::f32 lo, asl::f32 hi, asl::i32 i) {
+            return std::max(0.0f, std::min(hi, i + 1.0f) - std::max(lo, static_cast<float>(i)));
+        };
+
+        const auto x_first = std::max(static_cast<asl::mut_i32>(std::floor(left)), clip.x0);
+        const auto x_last = std::min(static_cast<asl::mut_i32>(std::ceil(right)), clip.x1);
+        const auto y_first = std::max(static_cast<asl::mut_i32>(std::floor(top)), clip.y0);
+        const auto y_last = std::min(static_cast<asl::mut_i32>(std::ceil(bottom)), clip.y1);
+
+        if (x_first >= x_last)
+        {
+            return;
+        }
+
+        for (asl::mut_i32 y = y_first; y < y_last; ++y)
+        {
+            const asl::f32 row = cover(top, bottom, y) * density;
+
+            // Partially covered columns at the ends, a full span inside.
+            fb.blend(x_first, y, c, row * cover(left, right, x_first));
+
+            if (x_last - 1 > x_first)
+            {
+                fb.fill_span(y, x_first + 1, x_last - 1, c, row);
+                fb.blend(x_last - 1, y, c, row * cover(left, right, x_last - 1));
+            }
+        }
+    }
+}
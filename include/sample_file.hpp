@@ -0,0 +1,482 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "asl/types"
+
+#include "compact_curve.hpp"
+#include "mapped_file.hpp"
+
+// Sample sets stored column by column, ready to be used in place:
+//
+//     [header | expression text]  padded to a block
+//     [x column]                  padded to a block, only if not uniform
+//     [y column]
+//
+// Numbers are in the byte order of the machine that wrote them. Columns
+// start on a block boundary, so a mapped file gives aligned arrays of
+// doubles or floats without any parsing, and whole blocks can be written
+// straight from an aligned buffer with O_DIRECT.
+namespace samplefile
+{
+    constexpr char magic[8] = { 'S', 'P', 'L', 'O', 'T', 'S', 'M', 'P' };
+    constexpr std::uint32_t version = 1;
+    constexpr std::size_t block_size = 4096;
+    constexpr std::string_view extension = ".spsm";
+
+    inline bool has_extension(std::string_view path)
+    {
+        return path.size() > extension.size() &&
+               path.substr(path.size() - extension.size()) == extension;
+    }
+
+    enum class DType : std::uint32_t
+    {
+        F64 = 0,
+        F32 = 1
+    };
+
+    inline std::size_t dtype_size(DType dtype)
+    {
+        return (dtype == DType::F32) ? sizeof(float) : sizeof(double);
+    }
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        DType dtype;
+
+        // 1: y only, at x_i = lower + i * step. 2: x and y.
+        std::uint32_t columns;
+        std::uint32_t expression_size;
+
+        std::uint64_t count;
+        double lower;
+        double upper;
+        double step;
+
+        // From the start of the file; x_offset is 0 with one column.
+        std::uint64_t x_offset;
+        std::uint64_t y_offset;
+    };
+
+    static_assert(sizeof(Header) == 72, "the header layout is part of the format");
+
+    // What a file describes. `expression` is only for reference: it is not
+    // needed to read the samples back.
+    struct Info
+    {
+        std::string_view expression;
+        asl::mut_f64 lower = 0.0;
+        asl::mut_f64 upper = 0.0;
+        asl::mut_f64 step = 0.0;
+        DType dtype = DType::F64;
+    };
+
+    namespace detail
+    {
+        inline std::uint64_t align_up(std::uint64_t n)
+        {
+            return (n + block_size - 1) / block_size * block_size;
+        }
+
+        // Whole blocks from an aligned buffer, with O_DIRECT where the file
+        // system takes it, so large sample sets do not go through (and
+        // evict) the page cache.
+        class BlockWriter
+        {
+        public:
+            static constexpr std::size_t capacity = std::size_t(1) << 22;
+
+            explicit BlockWriter(const std::string& path)
+            {
+#ifdef O_DIRECT
+                m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+#endif
+                if (m_fd < 0)
+                {
+                    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                }
+
+                m_buffer = static_cast<char*>(std::aligned_alloc(block_size, capacity));
+            }
+
+            ~BlockWriter()
+            {
+                std::free(m_buffer);
+
+                if (m_fd >= 0)
+                {
+                    ::close(m_fd);
+                }
+            }
+
+            BlockWriter(const BlockWriter&) = delete;
+            BlockWriter& operator=(const BlockWriter&) = delete;
+
+            bool valid() const { return m_fd >= 0 && m_buffer && m_ok; }
+
+            // Space for at least one more byte.
+            char* reserve(std::size_t& available)
+            {
+                if (m_used == capacity)
+                {
+                    drain();
+                }
+
+                available = capacity - m_used;
+                return m_buffer + m_used;
+            }
+
+            void commit(std::size_t bytes) { m_used += bytes; }
+
+            // Zeros up to the next block boundary.
+            void pad()
+            {
+                const std::size_t end = detail::align_up(m_used);
+                std::memset(m_buffer + m_used, 0, end - m_used);
+                m_used = end;
+            }
+
+            // Writes what is buffered and cuts the file at `size` bytes,
+            // dropping the padding of the last block.
+            bool finish(std::uint64_t size)
+            {
+                pad();
+                drain();
+
+                return valid() && ::ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+            }
+
+        private:
+            void drain()
+            {
+                const char* data = m_buffer;
+                std::size_t size = m_used;
+
+                while (size > 0 && valid())
+                {
+                    const ssize_t n = ::write(m_fd, data, size);
+
+                    if (n < 0 && errno == EINVAL && !m_buffered)
+                    {
+                        // O_DIRECT was accepted at open but not for writes.
+#ifdef O_DIRECT
+                        ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+#endif
+                        m_buffered = true;
+                        continue;
+                    }
+
+                    if (n <= 0)
+                    {
+                        m_ok = false;
+                        break;
+                    }
+
+                    data += n;
+                    size -= static_cast<std::size_t>(n);
+                }
+
+                m_used = 0;
+            }
+
+            char* m_buffer = nullptr;
+            std::size_t m_used = 0;
+            int m_fd = -1;
+            bool m_buffered = false;
+            bool m_ok = true;
+        };
+
+        template <typename T>
+        void put_values(BlockWriter& out, const double* values, std::size_t count)
+        {
+            while (count > 0)
+            {
+                std::size_t available = 0;
+                char* dst = out.reserve(available);
+
+                const std::size_t n = std::min(count, available / sizeof(T));
+
+                if constexpr (sizeof(T) == sizeof(double))
+                {
+                    std::memcpy(dst, values, n * sizeof(T));
+                }
+                else
+                {
+                    T* typed = reinterpret_cast<T*>(dst);
+
+                    for (std::size_t i = 0; i < n; ++i)
+                    {
+                        typed[i] = static_cast<T>(values[i]);
+                    }
+                }
+
+                out.commit(n * sizeof(T));
+                values += n;
+                count -= n;
+            }
+        }
+
+        template <typename T>
+        void put_column(BlockWriter& out, const double* values, std::size_t count)
+        {
+            put_values<T>(out, values, count);
+            out.pad();
+        }
+
+        // The header and the expression text, padded to a block.
+        inline void put_header(BlockWriter& out, const Info& info, bool with_x, std::size_t count)
+        {
+            const std::uint64_t column_bytes = align_up(count * dtype_size(info.dtype));
+
+            Header header {};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.dtype = info.dtype;
+            header.columns = with_x ? 2 : 1;
+            header.expression_size = static_cast<std::uint32_t>(info.expression.size());
+            header.count = count;
+            header.lower = info.lower;
+            header.upper = info.upper;
+            header.step = info.step;
+            header.x_offset = with_x ? align_up(sizeof(Header) + info.expression.size()) : 0;
+            header.y_offset = align_up(sizeof(Header) + info.expression.size()) +
+                              (with_x ? column_bytes : 0);
+
+            // The header and the text go through the buffer like the columns.
+            const std::string_view parts[2] = {
+                std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)),
+                info.expression
+            };
+
+            for (std::string_view part : parts)
+            {
+                while (!part.empty())
+                {
+                    std::size_t available = 0;
+                    char* dst = out.reserve(available);
+
+                    const std::size_t n = std::min(part.size(), available);
+                    std::memcpy(dst, part.data(), n);
+                    out.commit(n);
+                    part.remove_prefix(n);
+                }
+            }
+
+            out.pad();
+        }
+    }
+
+    // Bytes taken by a file of `count` samples.
+    inline std::uint64_t file_size(const Info& info, std::size_t count, bool with_x)
+    {
+        const std::uint64_t column = count * dtype_size(info.dtype);
+
+        return detail::align_up(sizeof(Header) + info.expression.size()) +
+               (with_x ? detail::align_up(column) : 0) + column;
+    }
+
+    // Writes `count` samples to `path`: y only when `xs` is null (x is
+    // then lower + i * step), x and y otherwise. Returns false on I/O
+    // errors.
+    inline bool write(const std::string& path, const Info& info,
+                      const double* xs, const double* ys, std::size_t count)
+    {
+        detail::BlockWriter out(path);
+
+        if (!out.valid())
+        {
+            return false;
+        }
+
+        detail::put_header(out, info, xs != nullptr, count);
+
+        const auto put = (info.dtype == DType::F32) ? detail::put_column<float>
+                                                     : detail::put_column<double>;
+
+        if (xs)
+        {
+            put(out, xs, count);
+        }
+
+        put(out, ys, count);
+
+        return out.finish(file_size(info, count, xs != nullptr));
+    }
+
+    // A file of `count` uniform samples (y only) written as they come, in
+    // any number of put() calls, so they never have to be held at once.
+    // Check valid().
+    class StreamWriter
+    {
+    public:
+        StreamWriter(const std::string& path, const Info& info, std::size_t count)
+            : m_out(path),
+              m_info(info),
+              m_count(count)
+        {
+            if (m_out.valid())
+            {
+                detail::put_header(m_out, m_info, false, m_count);
+            }
+        }
+
+        bool valid() const { return m_out.valid(); }
+
+        void put(const double* ys, std::size_t count)
+        {
+            count = std::min(count, m_count - m_put);
+
+            if (m_info.dtype == DType::F32)
+            {
+                detail::put_values<float>(m_out, ys, count);
+            }
+            else
+            {
+                detail::put_values<double>(m_out, ys, count);
+            }
+
+            m_put += count;
+        }
+
+        // Returns false on I/O errors, or if fewer than `count` samples
+        // were put.
+        bool finish()
+        {
+            return m_out.finish(file_size(m_info, m_count, false)) && m_put == m_count;
+        }
+
+    private:
+        detail::BlockWriter m_out;
+        Info m_info;
+        std::size_t m_count;
+        std::size_t m_put = 0;
+    };
+
+    // A sample file mapped read-only. The columns point into the mapping
+    // and are valid as long as the object is.
+    class MappedSamples
+    {
+    public:
+        explicit MappedSamples(const std::string& path)
+            : m_file(path)
+        {
+            if (!m_file.valid() || m_file.size() < sizeof(Header))
+            {
+                m_error = path + " is not a sample file";
+                return;
+            }
+
+            std::memcpy(&m_header, m_file.data(), sizeof(Header));
+            m_valid = check();
+
+            if (!m_valid)
+            {
+                m_error = path + " is not a valid sample file";
+            }
+        }
+
+        MappedSamples(const MappedSamples&) = delete;
+        MappedSamples& operator=(const MappedSamples&) = delete;
+
+        bool valid() const { return m_valid; }
+        const std::string& error() const { return m_error; }
+
+        const Header& header() const { return m_header; }
+        DType dtype() const { return m_header.dtype; }
+        bool uniform() const { return m_header.columns == 1; }
+
+        std::size_t size() const { return static_cast<std::size_t>(m_header.count); }
+        asl::f64 lower() const { return m_header.lower; }
+        asl::f64 upper() const { return m_header.upper; }
+        asl::f64 step() const { return m_header.step; }
+
+        std::string_view expression() const
+        {
+            return std::string_view(m_file.data() + sizeof(Header), m_header.expression_size);
+        }
+
+        // Raw columns, of dtype() values; x_data() is null if uniform().
+        const void* x_data() const { return uniform() ? nullptr : m_file.data() + m_header.x_offset; }
+        const void* y_data() const { return m_file.data() + m_header.y_offset; }
+
+        asl::mut_f64 x(std::size_t i) const
+        {
+            return uniform() ? lower() + i * step() : value(x_data(), i);
+        }
+
+        asl::mut_f64 y(std::size_t i) const
+        {
+            return value(y_data(), i);
+        }
+
+        // The y column as the vertex source of a compact curve; only
+        // meaningful if uniform(). No data is copied.
+        CompactView view(GraphPoint::Color color) const
+        {
+            CompactView v;
+            v.format = (dtype() == DType::F32) ? CompactCurve::Format::Float
+                                               : CompactCurve::Format::Double;
+            v.origin = static_cast<float>(lower());
+            v.step = static_cast<float>(step());
+            v.color = color;
+            v.data = y_data();
+            v.count = size();
+
+            return v;
+        }
+
+    private:
+        asl::mut_f64 value(const void* column, std::size_t i) const
+        {
+            return (dtype() == DType::F32) ? static_cast<const float*>(column)[i]
+                                           : static_cast<const double*>(column)[i];
+        }
+
+        bool check() const
+        {
+            const Header& h = m_header;
+
+            if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version ||
+                (h.dtype != DType::F64 && h.dtype != DType::F32) ||
+                (h.columns != 1 && h.columns != 2))
+            {
+                return false;
+            }
+
+            const std::uint64_t text_end = sizeof(Header) + std::uint64_t(h.expression_size);
+            const std::uint64_t width = dtype_size(h.dtype);
+
+            if (h.count > m_file.size() / width || text_end > m_file.size())
+            {
+                return false;
+            }
+
+            const std::uint64_t column = h.count * width;
+
+            const auto fits = [&] (std::uint64_t offset) {
+                return offset % block_size == 0 && offset >= text_end &&
+                       offset <= m_file.size() && column <= m_file.size() - offset;
+            };
+
+            return fits(h.y_offset) && (h.columns == 1 || fits(h.x_offset));
+        }
+
+        MappedFile m_file;
+        Header m_header {};
+        bool m_valid = false;
+        std::string m_error;
+    };
+}
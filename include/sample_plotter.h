@@ -0,0 +1,79 @@
+#ifndef SAMPLE_PLOTTER_H
+#define SAMPLE_PLOTTER_H
+
+/*
+ * C interface of sample_plotter_core: compiles expressions of x (the
+ * same language as the interactive prompt) and evaluates or integrates
+ * them, with no graphics or windowing dependency.
+ *
+ * Every buffer belongs to the caller. Only sp_compile allocates (the
+ * program); sp_evaluate, sp_evaluate_grid and sp_integrate with one
+ * thread allocate nothing, except for the evaluation registers of the
+ * calling thread the first time it runs a program at least that large.
+ * A program can be used from several threads at once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SP_ABI_VERSION 1
+
+#if defined(_WIN32) && defined(SP_BUILDING_CORE)
+#define SP_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define SP_API __attribute__((visibility("default")))
+#else
+#define SP_API
+#endif
+
+typedef struct sp_program sp_program;
+
+typedef enum sp_status
+{
+    SP_OK = 0,
+    SP_INVALID_ARGUMENT = 1,
+    SP_OUT_OF_MEMORY = 2,
+    SP_INTERNAL_ERROR = 3
+} sp_status;
+
+/* SP_ABI_VERSION of the library actually loaded. */
+SP_API int sp_abi_version(void);
+
+SP_API const char* sp_status_string(sp_status status);
+
+/* Compiles `length` bytes of `expression` into *out, which is released
+ * with sp_program_free. Text that is not a whole expression gives
+ * SP_INVALID_ARGUMENT and leaves *out null. */
+SP_API sp_status sp_compile(const char* expression, size_t length, sp_program** out);
+
+SP_API void sp_program_free(sp_program* program);
+
+/* Number of instructions, after common subexpressions are shared and
+ * constants folded. */
+SP_API size_t sp_program_size(const sp_program* program);
+
+/* out[i] = f(x[i]) for i < count. */
+SP_API sp_status sp_evaluate(const sp_program* program, const double* x, double* out, size_t count);
+
+/* out[i] = f(from + i * step) for i < count. */
+SP_API sp_status sp_evaluate_grid(const sp_program* program, double from, double step,
+                                  double* out, size_t count);
+
+/* Rectangle rule (right ends) and trapezoid rule over `divisions` steps
+ * of [lower, upper]. The samples are not stored. With threads > 1 the
+ * range is split over that many threads, which are started for the
+ * call; with 1 it runs on the calling thread. Either result pointer may
+ * be null. */
+SP_API sp_status sp_integrate(const sp_program* program, double lower, double upper,
+                              uint64_t divisions, unsigned threads,
+                              double* rectangles, double* trapezoids);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+#include "asl/types"
+
+#include "graph_point.hpp"
+
+namespace streaming
+{
+    namespace detail
+    {
+        // Sliding window extremum (monotonic deque) over the last
+        // `window` values pushed, in a fixed ring of `window` entries.
+        // Compare is std::less for the minimum, std::greater for the
+        // maximum.
+        template <typename Compare>
+        class WindowExtremum
+        {
+        public:
+            explicit WindowExtremum(std::size_t window)
+                : m_entries(window),
+                  m_window(window)
+            {
+            }
+
+            void push(std::uint64_t seq, double value)
+            {
+                // Entries that can no longer be the extremum.
+                while (m_size > 0 && !Compare{}(back().value, value))
+                {
+                    --m_size;
+                }
+
+                // Entries out of the window.
+                while (m_size > 0 && front().seq + m_window <= seq)
+                {
+                    m_head = (m_head + 1) % m_entries.size();
+                    --m_size;
+                }
+
+                m_entries[(m_head + m_size) % m_entries.size()] = { seq, value };
+                ++m_size;
+            }
+
+            bool empty() const { return m_size == 0; }
+            double value() const { return front().value; }
+
+        private:
+            struct Entry
+            {
+                std::uint64_t seq;
+                double value;
+            };
+
+            const Entry& front() const { return m_entries[m_head]; }
+            const Entry& back() const { return m_entries[(m_head + m_size - 1) % m_entries.size()]; }
+
+            std::vector<Entry> m_entries;
+            std::size_t m_window;
+            std::size_t m_head = 0;
+            std::size_t m_size = 0;
+        };
+
+        struct Less
+        {
+            bool operator()(double a, double b) const { return a < b; }
+        };
+
+        struct Greater
+        {
+            bool operator()(double a, double b) const { return a > b; }
+        };
+    }
+
+    // The last `capacity` samples of a stream, as vertices in a fixed
+    // array used as a ring. Once it wraps, the curve is drawn in two
+    // segments, oldest first. The array has one extra slot after the end
+    // mirroring slot 0, so the first segment ends on the sample the second
+    // one starts from, without a gap, and nothing has to be linearized.
+    //
+    // x is stored relative to the first timestamp, so that float vertices
+    // keep their precision with large (e.g. epoch) timestamps. Minimum and
+    // maximum of the samples in the ring are kept up to date in O(1)
+    // amortized per sample, for auto-scaling. Nothing is allocated after
+    // construction.
+    class SampleRing
+    {
+    public:
+        SampleRing(std::size_t capacity, GraphPoint::Color color)
+            : m_capacity(std::max<std::size_t>(capacity, 2)),
+              m_vertices(m_capacity + 1),
+              m_min(m_capacity),
+              m_max(m_capacity),
+              m_color(color)
+        {
+            m_strips.first.reserve(2);
+            m_strips.count.reserve(2);
+        }
+
+        std::size_t capacity() const { return m_capacity; }
+
+        // Vertices to allocate in the renderer.
+        std::size_t buffer_size() const { return m_vertices.size(); }
+
+        std::size_t size() const { return static_cast<std::size_t>(std::min<std::uint64_t>(m_next, m_capacity)); }
+        std::uint64_t total() const { return m_next; }
+
+        void push(double t, double v)
+        {
+            if (!std::isfinite(t) || !std::isfinite(v))
+            {
+                return;
+            }
+
+            if (m_next == 0)
+            {
+                m_origin = t;
+            }
+
+            const std::size_t slot = static_cast<std::size_t>(m_next % m_capacity);
+
+            GraphPoint& p = m_vertices[slot];
+            p.pos.x = static_cast<float>(t - m_origin);
+            p.pos.y = static_cast<float>(v);
+            p.color = m_color;
+
+            if (slot == 0)
+            {
+                m_vertices[m_capacity] = p;
+            }
+
+            m_min.push(m_next, v);
+            m_max.push(m_next, v);
+
+            ++m_next;
+        }
+
+        double origin() const { return m_origin; }
+        double min() const { return m_min.empty() ? 0.0 : m_min.value(); }
+        double max() const { return m_max.empty() ? 0.0 : m_max.value(); }
+
+        // x of the oldest and newest sample in the ring.
+        float first_x() const { return (m_next == 0) ? 0.0f : m_vertices[oldest_slot()].pos.x; }
+        float last_x() const { return (m_next == 0) ? 0.0f : m_vertices[(m_next - 1) % m_capacity].pos.x; }
+
+        // Calls write(offset, data, count) for the slots changed since the
+        // last flush.
+        template <typename Write>
+        void flush(Write&& write)
+        {
+            const std::uint64_t from = std::max(m_flushed, m_next - std::min<std::uint64_t>(m_next, m_capacity));
+
+            if (from == m_next)
+            {
+                return;
+            }
+
+            const auto first = static_cast<std::size_t>(from % m_capacity);
+            const auto count = static_cast<std::size_t>(m_next - from);
+            const std::size_t tail = std::min(count, m_capacity - first);
+
+            write(static_cast<asl::mut_i32>(first), m_vertices.data() + first, static_cast<asl::mut_i32>(tail));
+
+            if (tail < count)
+            {
+                write(0, m_vertices.data(), static_cast<asl::mut_i32>(count - tail));
+            }
+
+            // Slot 0 was written, and so was its mirror.
+            if (first == 0 || tail < count)
+            {
+                write(static_cast<asl::mut_i32>(m_capacity), m_vertices.data() + m_capacity, 1);
+            }
+
+            m_flushed = m_next;
+        }
+
+        // The one or two ranges to draw, oldest first.
+        const StripList& segments()
+        {
+            m_strips.clear();
+
+            const std::size_t start = oldest_slot();
+            const std::size_t n = size();
+
+            if (n == 0)
+            {
+                return m_strips;
+            }
+
+            if (m_next <= m_capacity || start == 0)
+            {
+                m_strips.push_back(static_cast<asl::mut_i32>(start), static_cast<asl::mut_i32>(n));
+            }
+            else
+            {
+                // Through the mirror of slot 0, then on from slot 0 itself:
+                // both strips have that sample, so no segment is missing.
+                m_strips.push_back(static_cast<asl::mut_i32>(start),
+                                   static_cast<asl::mut_i32>(m_capacity + 1 - start));
+                m_strips.push_back(0, static_cast<asl::mut_i32>(start));
+            }
+
+            return m_strips;
+        }
+
+    private:
+        std::size_t oldest_slot() const
+        {
+            return (m_next <= m_capacity) ? 0 : static_cast<std::size_t>(m_next % m_capacity);
+        }
+
+        std::size_t m_capacity;
+        std::vector<GraphPoint> m_vertices;
+
+        detail::WindowExtremum<detail::Less> m_min;
+        detail::WindowExtremum<detail::Greater> m_max;
+
+        GraphPoint::Color m_color;
+
+        std::uint64_t m_next = 0;
+        std::uint64_t m_flushed = 0;
+        double m_origin = 0.0;
+
+        StripList m_strips;
+    };
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <optional>
+#include <cmath>
+
+#include "parallel.hpp"
+#include "instrument.hpp"
+
+namespace sampling
+{
+    // Wraps a function and counts how many times it is evaluated.
+    template <typename F>
+    struct Counted
+    {
+        F fun;
+        std::atomic<std::size_t>* counter;
+
+        double operator()(double x) const
+        {
+            counter->fetch_add(1, std::memory_order_relaxed);
+            return fun(x);
+        }
+    };
+
+    template <typename F>
+    Counted<std::decay_t<F>> counted(F&& fun, std::atomic<std::size_t>& counter)
+    {
+        return { std::forward<F>(fun), &counter };
+    }
+
+    // fun, for `calls` calls about to be made by one thread, such as a
+    // chunk of a parallel loop. A Counted function adds them to its
+    // counter here, at once, and returns the function it wraps, so the
+    // threads do not contend for the counter on every call.
+    template <typename F>
+    const F& count_calls(const F& fun, std::size_t)
+    {
+        return fun;
+    }
+
+    template <typename F>
+    const F& count_calls(const Counted<F>& fun, std::size_t calls)
+    {
+        fun.counter->fetch_add(calls, std::memory_order_relaxed);
+        return fun.fun;
+    }
+
+    // Tag for the SampleBuffer constructor taking a batch evaluator.
+    struct Batched { };
+    constexpr Batched batched {};
+
+    // f sampled once on the uniform grid x_i = lower + i * step,
+    // i = 0 .. divisions. Every consumer of the session (integration,
+    // analysis, plotting) reads from here instead of evaluating f again.
+    class SampleBuffer
+    {
+    public:
+        template <typename F>
+        SampleBuffer(F&& fun, double lower, double upper, std::size_t divisions)
+            : m_lower(std::min(lower, upper)),
+              m_upper(std::max(lower, upper)),
+              m_step(0.0),
+              m_values(std::max<std::size_t>(divisions, 1) + 1)
+        {
+            const instrument::Scope scope("sample", m_values.size());
+
+            m_step = (m_upper - m_lower) / (m_values.size() - 1);
+
+            parallel::for_chunks(m_values.size(),
+                                 [&] (std::size_t, std::size_t begin, std::size_t end)
+            {
+                const auto& f = count_calls(fun, end - begin);
+
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    m_values[i] = f(x(i));
+                }
+            });
+        }
+
+        // Sampled by a batch evaluator: fill(x, step, count, out) writes f
+        // at `count` consecutive grid points from x, once per chunk.
+        template <typename Fill>
+        SampleBuffer(Batched, Fill&& fill, double lower, double upper, std::size_t divisions)
+            : m_lower(std::min(lower, upper)),
+              m_upper(std::max(lower, upper)),
+              m_step(0.0),
+              m_values(std::max<std::size_t>(divisions, 1) + 1)
+        {
+            const instrument::Scope scope("sample", m_values.size());
+
+            m_step = (m_upper - m_lower) / (m_values.size() - 1);
+
+            parallel::for_chunks(m_values.size(),
+                                 [&] (std::size_t, std::size_t begin, std::size_t end)
+            {
+                fill(x(begin), m_step, end - begin, m_values.data() + begin);
+            });
+        }
+
+        // Samples already taken: values[i] = f(lower + i * step), with
+        // values.size() - 1 steps over [lower, upper].
+        SampleBuffer(double lower, double upper, std::vector<double> values)
+            : m_lower(lower),
+              m_upper(upper),
+              m_step((upper - lower) / std::max<std::size_t>(values.size() - 1, 1)),
+              m_values(std::move(values))
+        {
+        }
+
+        double lower() const { return m_lower; }
+        double upper() const { return m_upper; }
+        double step() const { return m_step; }
+        std::size_t size() const { return m_values.size(); }
+        std::size_t divisions() const { return m_values.size() - 1; }
+
+        double x(std::size_t i) const { return m_lower + i * m_step; }
+        double operator[](std::size_t i) const { return m_values[i]; }
+
+        const std::vector<double>& values() const { return m_values; }
+
+        // Returns the sampled value if x lies on the grid. A grid of no
+        // width only has its lower end.
+        std::optional<double> lookup(double x) const
+        {
+            if (!(m_step > 0))
+            {
+                return (x == m_lower) ? std::optional<double>(m_values[0]) : std::nullopt;
+            }
+
+            const double pos = (x - m_lower) / m_step;
+            const double index = std::round(pos);
+
+            if (!std::isfinite(pos) || index < 0 || index > divisions() || std::abs(pos - index) > 1e-6)
+            {
+                return std::nullopt;
+            }
+
+            return m_values[static_cast<std::size_t>(index)];
+        }
+
+        // Calls out(x, y) for samples in [from, to], taking every n-th
+        // sample so that consecutive points are at least `spacing` apart.
+        // n is a power of two, so midpoints of consecutive output points
+        // stay on the grid.
+        template <typename Out>
+        void downsample(double from, double to, double spacing, Out&& out) const
+        {
+            from = std::max(from, m_lower);
+            to = std::min(to, m_upper);
+
+            if (!(from <= to))
+            {
+                return;
+            }
+
+            if (!(m_step > 0))
+            {
+                out(m_lower, m_values[0]);
+                return;
+            }
+
+            std::size_t stride = 1;
+            while (stride * m_step < spacing && stride < divisions())
+            {
+                stride *= 2;
+            }
+
+            const std::size_t first =
+                static_cast<std::size_t>(std::ceil((from - m_lower) / m_step));
+            const std::size_t last = std::min(
+                static_cast<std::size_t>(std::floor((to - m_lower) / m_step)),
+                divisions());
+
+            for (std::size_t i = first; i <= last; i += stride)
+            {
+                out(x(i), m_values[i]);
+            }
+        }
+
+    private:
+        double m_lower;
+        double m_upper;
+        double m_step;
+        std::vector<double> m_values;
+    };
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <deque>
+#include <algorithm>
+#include <utility>
+
+#include "graph_point.hpp"
+#include "adaptive.hpp"
+#include "instrument.hpp"
+#include "tile_cache.hpp"
+#include "spsc_queue.hpp"
+
+namespace sampling
+{
+    struct TileBatch
+    {
+        TileKey key;
+        Curve curve;
+
+        // Last refinement level of the tile: no more batches will follow.
+        bool final;
+    };
+
+    // Samples tiles on its own thread. The render thread sends the keys it
+    // needs and collects finished vertex batches; both directions go
+    // through lock-free single-producer single-consumer queues. The mutex
+    // is only used to park the worker while it has nothing to do.
+    //
+    // Tiles are refined progressively: the worker round-robins over its
+    // ProgressiveSamplers in slices of `slice`, newest request first, and
+    // publishes every completed level, so a coarse version of a new tile
+    // shows up within a slice whatever the cost of the function. Tiles no
+    // longer needed are cancelled, so the slices go to the ones in view.
+    class SamplingWorker
+    {
+    public:
+        // Prepares a sampler for the given tile.
+        using Setup = std::function<void(TileKey, ProgressiveSampler&)>;
+
+        SamplingWorker(Setup setup,
+                       std::chrono::microseconds slice = std::chrono::microseconds{2000},
+                       std::size_t queue_size = 256)
+            : m_setup(std::move(setup)),
+              m_slice(slice),
+              m_requests(queue_size),
+              m_results(queue_size),
+              m_thread([this] { run(); })
+        {
+        }
+
+        ~SamplingWorker()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
+
+            m_wake.notify_one();
+            m_thread.join();
+        }
+
+        SamplingWorker(const SamplingWorker&) = delete;
+        SamplingWorker& operator=(const SamplingWorker&) = delete;
+
+        // Render thread. Returns false if the request queue is full.
+        bool request(TileKey key)
+        {
+            return send({ key, false });
+        }
+
+        // Render thread. Stops refining `key`; batches already published
+        // may still arrive. Returns false if the request queue is full.
+        bool cancel(TileKey key)
+        {
+            return send({ key, true });
+        }
+
+        // Render thread. Returns false when no batch is ready.
+        bool poll(TileBatch& batch)
+        {
+            return m_results.try_pop(batch);
+        }
+
+        // Called from the worker thread after every published batch, e.g.
+        // to wake up an event loop.
+        void on_publish(std::function<void()> callback)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_onPublish = std::move(callback);
+        }
+
+    private:
+        // Requests and cancellations share one queue, so they are seen in
+        // the order they were sent.
+        struct Request
+        {
+            TileKey key;
+            bool cancel;
+        };
+
+        struct Task
+        {
+            TileKey key;
+            ProgressiveSampler sampler;
+        };
+
+        void run()
+        {
+            instrument::name_thread("sampling worker");
+
+            std::deque<Task> tasks;
+            Request request;
+
+            while (m_running)
+            {
+                while (m_requests.try_pop(request))
+                {
+                    if (request.cancel)
+                    {
+                        tasks.erase(std::remove_if(tasks.begin(), tasks.end(),
+                                                   [&] (const Task& t) { return t.key == request.key; }),
+                                    tasks.end());
+                        continue;
+                    }
+
+                    tasks.push_front({ request.key, ProgressiveSampler{} });
+                    m_setup(request.key, tasks.front().sampler);
+                }
+
+                if (tasks.empty())
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [this] { return m_pending || !m_running; });
+
+                    m_pending = false;
+                    continue;
+                }
+
+                Task task = std::move(tasks.front());
+                tasks.pop_front();
+
+                bool published = false;
+
+                {
+                    const instrument::Scope scope("tile");
+                    published = task.sampler.step(m_slice);
+                }
+
+                if (published)
+                {
+                    TileBatch batch { task.key, task.sampler.curve(), task.sampler.done() };
+
+                    // The render thread drains results every frame, so a
+                    // full queue only lasts until its next frame.
+                    while (!m_results.try_push(std::move(batch)))
+                    {
+                        if (!m_running)
+                        {
+                            return;
+                        }
+
+                        std::this_thread::yield();
+                    }
+
+                    notify_publish();
+                }
+
+                if (!task.sampler.done())
+                {
+                    tasks.push_back(std::move(task));
+                }
+            }
+        }
+
+        bool send(Request request)
+        {
+            if (!m_requests.try_push(request))
+            {
+                return false;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending = true;
+            }
+
+            m_wake.notify_one();
+
+            return true;
+        }
+
+        void notify_publish()
+        {
+            std::function<void()> callback;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                callback = m_onPublish;
+            }
+
+            if (callback)
+            {
+                callback();
+            }
+        }
+
+        Setup m_setup;
+        std::chrono::microseconds m_slice;
+
+        concurrency::SpscQueue<Request> m_requests;
+        concurrency::SpscQueue<TileBatch> m_results;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        bool m_pending = false;
+        std::atomic<bool> m_running{true};
+        std::function<void()> m_onPublish;
+
+        std::thread m_thread;
+    };
+}
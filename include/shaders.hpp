@@ -10,24 +10,43 @@ constexpr const char* g_vertsrc = R"(
 
     layout (location = 0) in vec2 Pos;
     layout (location = 1) in vec4 Color;
+    layout (location = 2) in float Y;
 
     uniform mat4 MVP;
     uniform float pointSize;
     uniform float scale;
 
+    // Compact curves (CompactCurve) only store Y: x comes from the vertex
+    // index and the colour is the same for the whole curve.
+    uniform bool implicitX;
+    uniform float xOrigin;
+    uniform float xStep;
+    uniform float yOffset;
+    uniform float yScale;
+    uniform vec4 curveColor;
+
     out vec4 fragColor;
 
     void main()
     {
-        gl_Position = MVP * vec4(Pos.x * scale, Pos.y * scale, 0.0, 1.0);
+        vec2 pos = Pos;
         fragColor = Color;
+
+        if (implicitX)
+        {
+            pos = vec2(xOrigin + float(gl_VertexID) * xStep, yOffset + Y * yScale);
+            fragColor = curveColor;
+        }
+
+        gl_Position = MVP * vec4(pos.x * scale, pos.y * scale, 0.0, 1.0);
         gl_PointSize = pointSize;
     }
 )";
 
-constexpr std::array<asl::string_view, 2> g_vertlocations {
+constexpr std::array<asl::string_view, 3> g_vertlocations {
     "Pos",
     "Color",
+    "Y",
 };
 
 constexpr const char* g_fragsrc = R"(
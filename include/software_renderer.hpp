@@ -0,0 +1,319 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <cmath>
+
+#include "asl/types"
+#include "glm/glm.hpp"
+
+#include "graph_point.hpp"
+#include "compact_curve.hpp"
+#include "plot_renderer_fwd.hpp"
+#include "parallel.hpp"
+#include "raster.hpp"
+
+namespace raster
+{
+    struct SoftwareTag { };
+
+    enum class Mode
+    {
+        Points,
+        Lines,
+        LineStrip
+    };
+
+    // Render target of the software backend. It plays the part of the GL
+    // context and of the shader: draw calls are transformed with the
+    // current MVP, pointSize and scale, as g_vertsrc does, and queued;
+    // flush() rasterizes the queue.
+    //
+    // flush() splits the image in `bands` horizontal bands rasterized on
+    // their own threads, every band drawing the commands that overlap it.
+    // When rendering many plots at once, use one band per canvas and run
+    // the canvases in parallel instead.
+    class Canvas
+    {
+    public:
+        Canvas(asl::i32 width, asl::i32 height,
+               asl::i32 bands = static_cast<asl::i32>(parallel::thread_count()))
+            : m_framebuffer(width, height),
+              m_bands(std::max(bands, 1))
+        {
+        }
+
+        Framebuffer& framebuffer() { return m_framebuffer; }
+        const Framebuffer& framebuffer() const { return m_framebuffer; }
+
+        void set_mvp(const glm::mat4& mvp) { m_mvp = mvp; }
+        void set_point_size(asl::f32 size) { m_pointSize = size; }
+        void set_scale(asl::f32 scale) { m_scale = scale; }
+
+        void clear(Color c)
+        {
+            m_commands.clear();
+            m_framebuffer.clear(c);
+        }
+
+        void submit(Mode mode, const GraphPoint* vertices, asl::i32 count)
+        {
+            if (count <= 0)
+            {
+                return;
+            }
+
+            Command cmd { mode, m_pointSize, {}, 0.0f, 0.0f };
+            cmd.vertices.reserve(count);
+
+            cmd.top = std::numeric_limits<float>::infinity();
+            cmd.bottom = -std::numeric_limits<float>::infinity();
+
+            for (asl::mut_i32 i = 0; i < count; ++i)
+            {
+                GraphPoint v = vertices[i];
+                v.pos = to_screen(v.pos);
+
+                if (std::isfinite(v.pos.y))
+                {
+                    cmd.top = std::min(cmd.top, v.pos.y);
+                    cmd.bottom = std::max(cmd.bottom, v.pos.y);
+                }
+
+                cmd.vertices.push_back(v);
+            }
+
+            m_commands.push_back(std::move(cmd));
+        }
+
+        void flush()
+        {
+            const asl::i32 height = m_framebuffer.height();
+
+            parallel::for_chunks(static_cast<std::size_t>(height), static_cast<std::size_t>(m_bands),
+                                 [&] (std::size_t, std::size_t begin, std::size_t end)
+            {
+                const Clip clip { 0, static_cast<asl::mut_i32>(begin),
+                                  m_framebuffer.width(), static_cast<asl::mut_i32>(end) };
+
+                for (const auto& cmd : m_commands)
+                {
+                    // Antialiasing and points reach a little past the
+                    // vertices themselves.
+                    const asl::f32 margin = 2.0f + cmd.point_size;
+
+                    if (cmd.bottom + margin >= clip.y0 && cmd.top - margin < clip.y1)
+                    {
+                        rasterize(cmd, clip);
+                    }
+                }
+            });
+
+            m_commands.clear();
+        }
+
+    private:
+        struct Command
+        {
+            Mode mode;
+            asl::mut_f32 point_size;
+            std::vector<GraphPoint> vertices;
+
+            // Vertical extent in pixels, for skipping bands.
+            asl::mut_f32 top;
+            asl::mut_f32 bottom;
+        };
+
+        glm::vec2 to_screen(glm::vec2 pos) const
+        {
+            const glm::vec4 clip = m_mvp * glm::vec4(pos.x * m_scale, pos.y * m_scale, 0.0f, 1.0f);
+
+            const asl::f32 x = clip.x / clip.w;
+            const asl::f32 y = clip.y / clip.w;
+
+            return glm::vec2((x + 1.0f) * 0.5f * m_framebuffer.width(),
+                             (1.0f - y) * 0.5f * m_framebuffer.height());
+        }
+
+        void rasterize(const Command& cmd, Clip clip)
+        {
+            const auto& v = cmd.vertices;
+
+            switch (cmd.mode)
+            {
+            case Mode::Points:
+                for (const auto& p : v)
+                {
+                    draw_point(m_framebuffer, clip, p.pos, cmd.point_size, p.color);
+                }
+                break;
+
+            case Mode::Lines:
+                for (std::size_t i = 0; i + 1 < v.size(); i += 2)
+                {
+                    draw_line(m_framebuffer, clip, v[i].pos, v[i + 1].pos, v[i].color, v[i + 1].color);
+                }
+                break;
+
+            case Mode::LineStrip:
+                for (std::size_t i = 0; i + 1 < v.size(); ++i)
+                {
+                    draw_line(m_framebuffer, clip, v[i].pos, v[i + 1].pos, v[i].color, v[i + 1].color);
+                }
+                break;
+            }
+        }
+
+        Framebuffer m_framebuffer;
+        asl::mut_i32 m_bands;
+
+        glm::mat4 m_mvp { 1.0f };
+        asl::mut_f32 m_pointSize = 1.0f;
+        asl::mut_f32 m_scale = 1.0f;
+
+        std::vector<Command> m_commands;
+    };
+}
+
+// Same interface as the OpenGL renderer, drawing into a raster::Canvas.
+// There is no GPU copy to synchronize, so begin() and end() do nothing and
+// update() writes straight into the vertex array.
+template <asl::i32 NumElem>
+class PlotRenderer2D<raster::SoftwareTag, NumElem>
+{
+public:
+    PlotRenderer2D(raster::Canvas& canvas, const std::array<GraphPoint, NumElem>& data)
+        : PlotRenderer2D(canvas, data.data(), NumElem)
+    {
+    }
+
+    PlotRenderer2D(raster::Canvas& canvas, const std::vector<GraphPoint>& data)
+        : PlotRenderer2D(canvas, data.data(), static_cast<asl::i32>(data.size()))
+    {
+    }
+
+    PlotRenderer2D(raster::Canvas& canvas, const GraphPoint* data, asl::i32 size)
+        : PlotRenderer2D(canvas, size)
+    {
+        update(0, data, size);
+        resize(size);
+    }
+
+    PlotRenderer2D(raster::Canvas& canvas, asl::i32 capacity)
+        : m_canvas(canvas),
+          m_vertices(std::max(capacity, 1))
+    {
+    }
+
+    asl::i32 capacity() const { return static_cast<asl::i32>(m_vertices.size()); }
+    asl::i32 size() const { return m_size; }
+
+    void resize(asl::i32 size)
+    {
+        m_size = std::min(size, capacity());
+    }
+
+    void reserve(asl::i32 capacity)
+    {
+        if (capacity > this->capacity())
+        {
+            m_vertices.resize(capacity);
+        }
+    }
+
+    void update(asl::i32 offset, const GraphPoint* data, asl::i32 count)
+    {
+        const asl::i32 clamped = std::min(count, capacity() - offset);
+
+        if (clamped > 0)
+        {
+            std::copy(data, data + clamped, m_vertices.begin() + offset);
+        }
+    }
+
+    void begin() { }
+    void end() { }
+
+    void draw(raster::Mode mode)
+    {
+        draw(mode, 0, m_size);
+    }
+
+    void draw_strips(raster::Mode mode, const StripList& strips)
+    {
+        for (std::size_t i = 0; i < strips.size(); ++i)
+        {
+            draw(mode, strips.first[i], strips.count[i]);
+        }
+    }
+
+    void draw(raster::Mode mode, asl::i32 start, asl::i32 count)
+    {
+        const asl::i32 clamped = std::min(count, capacity() - start);
+
+        if (start >= 0 && clamped > 0)
+        {
+            m_canvas.submit(mode, m_vertices.data() + start, clamped);
+        }
+    }
+
+private:
+    raster::Canvas& m_canvas;
+    std::vector<GraphPoint> m_vertices;
+    asl::mut_i32 m_size = 0;
+};
+
+// Rebuilds the vertices of a CompactCurve from their index with the same
+// arithmetic as g_vertsrc, so both backends place them alike. The y array
+// is not copied and must outlive the renderer.
+template <>
+class CompactRenderer2D<raster::SoftwareTag>
+{
+public:
+    CompactRenderer2D(raster::Canvas& canvas, const CompactCurve& curve)
+        : CompactRenderer2D(canvas, curve.view())
+    {
+    }
+
+    CompactRenderer2D(raster::Canvas& canvas, const CompactView& curve)
+        : m_canvas(canvas),
+          m_curve(curve)
+    {
+    }
+
+    void draw(raster::Mode mode, asl::i32 start, asl::i32 count)
+    {
+        const auto size = static_cast<asl::mut_i32>(m_curve.size());
+        const asl::i32 clamped = std::min(count, size - start);
+
+        if (start < 0 || clamped <= 0)
+        {
+            return;
+        }
+
+        m_scratch.resize(clamped);
+
+        for (asl::mut_i32 i = 0; i < clamped; ++i)
+        {
+            m_scratch[i] = m_curve.vertex(start + i);
+        }
+
+        m_canvas.submit(mode, m_scratch.data(), clamped);
+    }
+
+    void draw_strips(raster::Mode mode, const StripList& strips)
+    {
+        for (std::size_t i = 0; i < strips.size(); ++i)
+        {
+            draw(mode, strips.first[i], strips.count[i]);
+        }
+    }
+
+private:
+    raster::Canvas& m_canvas;
+    CompactView m_curve;
+    std::vector<GraphPoint> m_scratch;
+};
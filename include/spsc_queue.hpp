@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+namespace concurrency
+{
+    // Bounded lock-free queue for exactly one producer thread and one
+    // consumer thread. The capacity is rounded up to a power of two.
+    template <typename T>
+    class SpscQueue
+    {
+    public:
+        explicit SpscQueue(std::size_t capacity)
+            : m_slots(round_up(capacity)),
+              m_mask(m_slots.size() - 1)
+        {
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // Producer side. Returns false, leaving `value` untouched, when the
+        // queue is full.
+        bool try_push(T&& value)
+        {
+            const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+
+            if (tail - m_headCache == m_slots.size())
+            {
+                m_headCache = m_head.load(std::memory_order_acquire);
+
+                if (tail - m_headCache == m_slots.size())
+                {
+                    return false;
+                }
+            }
+
+            m_slots[tail & m_mask] = std::move(value);
+            m_tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool try_push(const T& value)
+        {
+            T copy = value;
+            return try_push(std::move(copy));
+        }
+
+        // Consumer side. Returns false when the queue is empty.
+        bool try_pop(T& value)
+        {
+            const std::size_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head == m_tailCache)
+            {
+                m_tailCache = m_tail.load(std::memory_order_acquire);
+
+                if (head == m_tailCache)
+                {
+                    return false;
+                }
+            }
+
+            value = std::move(m_slots[head & m_mask]);
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Approximate when called while the other side is running.
+        bool empty() const
+        {
+            return m_head.load(std::memory_order_acquire) ==
+                   m_tail.load(std::memory_order_acquire);
+        }
+
+        std::size_t capacity() const
+        {
+            return m_slots.size();
+        }
+
+    private:
+        static std::size_t round_up(std::size_t n)
+        {
+            std::size_t res = 1;
+            while (res < n)
+            {
+                res *= 2;
+            }
+            return res;
+        }
+
+        static constexpr std::size_t cache_line = 64;
+
+        std::vector<T> m_slots;
+        const std::size_t m_mask;
+
+        // Each side owns one index and keeps a cached copy of the other
+        // one, refreshed only when the queue looks full or empty.
+        alignas(cache_line) std::atomic<std::size_t> m_head{0};
+        std::size_t m_tailCache = 0;
+
+        alignas(cache_line) std::atomic<std::size_t> m_tail{0};
+        std::size_t m_headCache = 0;
+    };
+}
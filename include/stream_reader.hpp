@@ -0,0 +1,276 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "spsc_queue.hpp"
+
+namespace streaming
+{
+    struct Sample
+    {
+        double t;
+        double v;
+    };
+
+    inline bool separator(char c)
+    {
+        return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r' || c == '\n';
+    }
+
+    // Parses the line [begin, end) as one or two numbers with any of
+    // the separators around them. Returns how many were read, 0 for
+    // blank lines and comments ("#"), or -1 if the line is not a sample.
+    inline int parse_fields(const char* begin, const char* end, double& first, double& second)
+    {
+        while (begin != end && separator(*begin))
+        {
+            ++begin;
+        }
+
+        if (begin == end || *begin == '#')
+        {
+            return 0;
+        }
+
+        auto res = std::from_chars(begin, end, first);
+
+        if (res.ec != std::errc())
+        {
+            return -1;
+        }
+
+        begin = res.ptr;
+
+        while (begin != end && separator(*begin))
+        {
+            ++begin;
+        }
+
+        if (begin == end)
+        {
+            return 1;
+        }
+
+        res = std::from_chars(begin, end, second);
+
+        return (res.ec == std::errc()) ? 2 : -1;
+    }
+
+    // Splits a byte stream into lines of "t v" or "t,v" (any mix of
+    // spaces, tabs, commas and semicolons between them) or of a single
+    // value, which then gets the number of samples before it as
+    // timestamp. Works in a fixed buffer and parses with std::from_chars:
+    // nothing is allocated after construction.
+    class LineParser
+    {
+    public:
+        static constexpr std::size_t buffer_size = 1 << 16;
+
+        // Where the next read should go, and how much room there is.
+        char* write_ptr() { return m_buffer + m_used; }
+        std::size_t write_space() const { return buffer_size - m_used; }
+
+        // Parses the `count` bytes just read, calling out(Sample) for
+        // every complete line. A partial line at the end is kept for the
+        // next call.
+        template <typename Out>
+        void commit(std::size_t count, Out&& out)
+        {
+            m_used += count;
+
+            const char* begin = m_buffer;
+            const char* end = m_buffer + m_used;
+
+            while (const char* nl = static_cast<const char*>(std::memchr(begin, '\n', end - begin)))
+            {
+                parse_line(begin, nl, out);
+                begin = nl + 1;
+            }
+
+            m_used = end - begin;
+
+            if (m_used == buffer_size)
+            {
+                // A line longer than the buffer: drop it.
+                ++m_rejected;
+                m_used = 0;
+            }
+            else if (begin != m_buffer)
+            {
+                std::memmove(m_buffer, begin, m_used);
+            }
+        }
+
+        // Parses what is left once the input ends without a newline.
+        template <typename Out>
+        void finish(Out&& out)
+        {
+            if (m_used > 0)
+            {
+                parse_line(m_buffer, m_buffer + m_used, out);
+                m_used = 0;
+            }
+        }
+
+        std::size_t rejected() const { return m_rejected; }
+
+    private:
+        template <typename Out>
+        void parse_line(const char* begin, const char* end, Out&& out)
+        {
+            double first = 0.0;
+            double second = 0.0;
+
+            switch (parse_fields(begin, end, first, second))
+            {
+            case 1:
+                out(Sample { static_cast<double>(m_line++), first });
+                break;
+
+            case 2:
+                ++m_line;
+                out(Sample { first, second });
+                break;
+
+            case -1:
+                ++m_rejected;
+                break;
+            }
+        }
+
+        char m_buffer[buffer_size];
+        std::size_t m_used = 0;
+        std::size_t m_line = 0;
+        std::size_t m_rejected = 0;
+    };
+
+    // Reads samples from a file descriptor (stdin, a pipe, a FIFO or a
+    // file) on its own thread and hands them to the render thread through
+    // a single-producer single-consumer queue. When the queue is full the
+    // reader waits, which pushes back on the writer of the pipe.
+    class StreamReader
+    {
+    public:
+        // An empty path or "-" reads stdin.
+        StreamReader(const std::string& path, std::size_t queue_size = 1 << 16)
+            : m_queue(queue_size)
+        {
+            if (path.empty() || path == "-")
+            {
+                m_fd = STDIN_FILENO;
+            }
+            else
+            {
+                m_fd = ::open(path.c_str(), O_RDONLY);
+                m_owned = true;
+            }
+
+            if (m_fd < 0)
+            {
+                m_done = true;
+                return;
+            }
+
+            m_thread = std::thread([this] { run(); });
+        }
+
+        ~StreamReader()
+        {
+            m_running = false;
+
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+
+            if (m_owned && m_fd >= 0)
+            {
+                ::close(m_fd);
+            }
+        }
+
+        StreamReader(const StreamReader&) = delete;
+        StreamReader& operator=(const StreamReader&) = delete;
+
+        bool valid() const { return m_fd >= 0; }
+
+        // Render thread.
+        bool pop(Sample& sample)
+        {
+            return m_queue.try_pop(sample);
+        }
+
+        // The input has ended; samples may still be queued.
+        bool done() const { return m_done.load(std::memory_order_acquire); }
+
+        std::size_t received() const { return m_received.load(std::memory_order_relaxed); }
+        std::size_t rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
+    private:
+        void run()
+        {
+            const auto push = [this] (const Sample& s) {
+                while (!m_queue.try_push(s))
+                {
+                    if (!m_running)
+                    {
+                        return;
+                    }
+
+                    std::this_thread::yield();
+                }
+
+                m_received.fetch_add(1, std::memory_order_relaxed);
+            };
+
+            pollfd pfd { m_fd, POLLIN, 0 };
+
+            while (m_running)
+            {
+                // Wakes up now and then to notice a shutdown even if no
+                // data is coming.
+                if (::poll(&pfd, 1, 100) <= 0)
+                {
+                    continue;
+                }
+
+                const ssize_t n = ::read(m_fd, m_parser.write_ptr(), m_parser.write_space());
+
+                if (n <= 0)
+                {
+                    break;
+                }
+
+                m_parser.commit(static_cast<std::size_t>(n), push);
+                m_rejected.store(m_parser.rejected(), std::memory_order_relaxed);
+            }
+
+            m_parser.finish(push);
+            m_rejected.store(m_parser.rejected(), std::memory_order_relaxed);
+
+            m_done.store(true, std::memory_order_release);
+        }
+
+        concurrency::SpscQueue<Sample> m_queue;
+        LineParser m_parser;
+
+        int m_fd = -1;
+        bool m_owned = false;
+
+        std::atomic<bool> m_running{true};
+        std::atomic<bool> m_done{false};
+        std::atomic<std::size_t> m_received{0};
+        std::atomic<std::size_t> m_rejected{0};
+
+        std::thread m_thread;
+    };
+}
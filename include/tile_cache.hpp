@@ -0,0 +1,269 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+#include "graph_point.hpp"
+
+namespace sampling
+{
+    // Tiles split the x axis in fixed pixel-wide pieces at several zoom
+    // levels: level L is sampled for a scale of base_scale * 2^L pixels
+    // per unit, so its tiles are half as wide as the ones of level L - 1.
+    struct TileKey
+    {
+        int level;
+        std::int64_t index;
+
+        bool operator==(const TileKey& other) const
+        {
+            return level == other.level && index == other.index;
+        }
+
+        bool operator!=(const TileKey& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    struct TileKeyHash
+    {
+        std::size_t operator()(const TileKey& key) const
+        {
+            return std::hash<std::int64_t>{}(key.index * 64 + key.level);
+        }
+    };
+
+    struct TileGrid
+    {
+        double base_scale = 5.0;
+        double tile_pixels = 256.0;
+        int max_level = 5;
+
+        // Coarsest level whose scale is not below the current one, so the
+        // tile is never sampled for less detail than what is on screen.
+        int level_for(double pixels_per_unit) const
+        {
+            const double l = std::ceil(std::log2(pixels_per_unit / base_scale));
+            return std::clamp(static_cast<int>(l), 0, max_level);
+        }
+
+        double scale(int level) const
+        {
+            return base_scale * std::exp2(level);
+        }
+
+        double width(int level) const
+        {
+            return tile_pixels / scale(level);
+        }
+
+        double lower(TileKey key) const
+        {
+            return key.index * width(key.level);
+        }
+
+        double upper(TileKey key) const
+        {
+            return (key.index + 1) * width(key.level);
+        }
+
+        // Tiles of `level` overlapping [from, to].
+        template <typename Out>
+        void visible(int level, double from, double to, Out&& out) const
+        {
+            const double w = width(level);
+            const auto first = static_cast<std::int64_t>(std::floor(from / w));
+            const auto last = static_cast<std::int64_t>(std::floor(to / w));
+
+            for (std::int64_t i = first; i <= last; ++i)
+            {
+                out(TileKey { level, i });
+            }
+        }
+    };
+
+    // Least recently used cache of sampled tiles, bounded by the total
+    // number of vertices it holds. Lookups never evict, so pointers
+    // returned by find() stay valid until the next trim().
+    class TileCache
+    {
+    public:
+        explicit TileCache(std::size_t max_vertices)
+            : m_maxVertices(max_vertices)
+        {
+        }
+
+        // Returns the tile for `key`, or nullptr if it has not been sampled
+        // yet, and marks it as the most recently used.
+        const Curve* find(TileKey key)
+        {
+            auto it = m_index.find(key);
+
+            if (it == m_index.end())
+            {
+                return nullptr;
+            }
+
+            m_tiles.splice(m_tiles.begin(), m_tiles, it->second);
+            return &it->second->curve;
+        }
+
+        void insert(TileKey key, Curve&& curve)
+        {
+            if (auto it = m_index.find(key); it != m_index.end())
+            {
+                m_vertices -= it->second->curve.vertices.size();
+                m_tiles.erase(it->second);
+                m_index.erase(it);
+            }
+
+            m_tiles.push_front({ key, std::move(curve) });
+            m_index.emplace(key, m_tiles.begin());
+            m_vertices += m_tiles.front().curve.vertices.size();
+        }
+
+        bool contains(TileKey key) const
+        {
+            return m_index.count(key) != 0;
+        }
+
+        // Drops the least recently used tiles until the cache fits its
+        // budget again, always keeping the `keep` most recent ones.
+        void trim(std::size_t keep = 0)
+        {
+            while (m_vertices > m_maxVertices && m_tiles.size() > keep)
+            {
+                auto& last = m_tiles.back();
+
+                m_vertices -= last.curve.vertices.size();
+                m_index.erase(last.key);
+                m_tiles.pop_back();
+            }
+        }
+
+        std::size_t size() const { return m_tiles.size(); }
+        std::size_t vertices() const { return m_vertices; }
+
+    private:
+        struct Entry
+        {
+            TileKey key;
+            Curve curve;
+        };
+
+        std::list<Entry> m_tiles;
+        std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> m_index;
+
+        std::size_t m_maxVertices;
+        std::size_t m_vertices = 0;
+    };
+
+    // Assigns tiles to the fixed-size slots of a vertex buffer. A tile
+    // keeps its slot while it stays resident, so only tiles that were just
+    // assigned need to be written; the slot given away is the one drawn
+    // least recently.
+    class TileSlots
+    {
+    public:
+        TileSlots(std::size_t count, std::size_t slot_vertices)
+            : m_slots(count),
+              m_slotVertices(slot_vertices)
+        {
+        }
+
+        struct Assignment
+        {
+            std::size_t slot;
+            bool fresh;
+        };
+
+        // Marks the slot holding `key`, if any, as used by `frame`. Touch
+        // every tile of a frame before acquiring slots for new ones, so
+        // that they cannot take each other's slot.
+        bool touch(TileKey key, std::uint64_t frame)
+        {
+            for (auto& slot : m_slots)
+            {
+                if (slot.used && slot.key == key)
+                {
+                    slot.frame = frame;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Slot of `key` for the given frame. Returns false if every slot is
+        // already used by a tile of this frame.
+        bool acquire(TileKey key, std::uint64_t frame, Assignment& res)
+        {
+            Slot* victim = nullptr;
+
+            for (auto& slot : m_slots)
+            {
+                if (slot.used && slot.key == key)
+                {
+                    slot.frame = frame;
+                    res = { static_cast<std::size_t>(&slot - m_slots.data()), false };
+                    return true;
+                }
+
+                const bool available = !slot.used || slot.frame != frame;
+                const bool better = !victim || !slot.used ||
+                                    (victim->used && slot.frame < victim->frame);
+
+                if (available && better)
+                {
+                    victim = &slot;
+                }
+            }
+
+            if (!victim)
+            {
+                return false;
+            }
+
+            victim->key = key;
+            victim->used = true;
+            victim->frame = frame;
+
+            res = { static_cast<std::size_t>(victim - m_slots.data()), true };
+            return true;
+        }
+
+        // Frees the slot holding `key`, e.g. because the tile changed and
+        // has to be written again.
+        void release(TileKey key)
+        {
+            for (auto& slot : m_slots)
+            {
+                if (slot.used && slot.key == key)
+                {
+                    slot.used = false;
+                }
+            }
+        }
+
+        std::size_t slot_vertices() const { return m_slotVertices; }
+        std::size_t capacity() const { return m_slots.size() * m_slotVertices; }
+
+    private:
+        struct Slot
+        {
+            TileKey key { 0, 0 };
+            bool used = false;
+            std::uint64_t frame = 0;
+        };
+
+        std::vector<Slot> m_slots;
+        std::size_t m_slotVertices;
+    };
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <iterator>
+#include <iostream>
+#include <cassert>
+
+#include "graph_point.hpp"
+#include "tile_cache.hpp"
+#include "sampling_worker.hpp"
+
+namespace sampling
+{
+    // A curve sampled lazily per viewport. Tiles in view are requested from
+    // a background SamplingWorker, kept in a TileCache once sampled and
+    // given a slot of the vertex buffer while they are resident. Every
+    // refinement level of a tile replaces the previous one in its slot. Nothing
+    // here touches the GPU: newly resident tiles are handed to a write
+    // callback and the ranges to draw are exposed as a StripList.
+    //
+    // Slots must hold the largest tile the setup can produce: pass
+    // max_vertices() of its deepest refinement as `slot_vertices`.
+    class TiledCurve
+    {
+    public:
+        TiledCurve(SamplingWorker::Setup setup,
+                   TileGrid grid = {},
+                   std::chrono::microseconds refine_budget = std::chrono::microseconds{2000},
+                   std::size_t max_cached_vertices = 1 << 20,
+                   std::size_t slots = 32,
+                   std::size_t slot_vertices = 4096)
+            : m_grid(grid),
+              m_cache(max_cached_vertices),
+              m_slots(slots, slot_vertices),
+              m_worker(std::move(setup), refine_budget)
+        {
+        }
+
+        const TileGrid& grid() const { return m_grid; }
+
+        // Vertices the buffer bound to write() must hold.
+        std::size_t capacity() const { return m_slots.capacity(); }
+
+        const StripList& strips() const { return m_strips; }
+
+        SamplingWorker& worker() { return m_worker; }
+
+        // True when the last update() found the request queue full: it has
+        // to run again soon even if nothing else happens.
+        bool retry_pending() const { return m_changed; }
+
+        // Collects the tiles finished by the worker, requests the missing
+        // ones overlapping [from, to] and calls write(offset, vertices,
+        // count) for tiles that just got a slot. Returns true when the
+        // draw list changed.
+        template <typename Write>
+        bool update(double from, double to, double pixels_per_unit, Write&& write)
+        {
+            TileBatch batch;
+
+            while (m_worker.poll(batch))
+            {
+                if (batch.final)
+                {
+                    m_pending.erase(batch.key);
+                    m_partial.erase(batch.key);
+                }
+                else
+                {
+                    m_partial.insert(batch.key);
+                }
+
+                m_slots.release(batch.key);
+                m_cache.insert(batch.key, std::move(batch.curve));
+                m_changed = true;
+            }
+
+            m_visible.clear();
+            m_grid.visible(m_grid.level_for(pixels_per_unit), from, to,
+                           [this] (TileKey key) {
+                m_visible.push_back(key);
+            });
+
+            if (!m_changed && m_visible == m_drawn)
+            {
+                return false;
+            }
+
+            m_changed = false;
+            ++m_frame;
+
+            // Tiles that left the view stop refining; the levels they got
+            // so far stay cached and they resume if they come back.
+            for (auto it = m_pending.begin(); it != m_pending.end();)
+            {
+                if (std::find(m_visible.begin(), m_visible.end(), *it) == m_visible.end() &&
+                    m_worker.cancel(*it))
+                {
+                    it = m_pending.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            for (const auto& key : m_visible)
+            {
+                m_slots.touch(key, m_frame);
+            }
+
+            m_strips.clear();
+
+            const std::size_t slot_vertices = m_slots.slot_vertices();
+
+            for (const auto& key : m_visible)
+            {
+                const Curve* tile = m_cache.find(key);
+
+                if ((!tile || m_partial.count(key) != 0) && m_pending.count(key) == 0)
+                {
+                    if (m_worker.request(key))
+                    {
+                        m_pending.insert(key);
+                    }
+                    else
+                    {
+                        // Queue full: try again next frame.
+                        m_changed = true;
+                    }
+                }
+
+                if (!tile)
+                {
+                    continue;
+                }
+
+                TileSlots::Assignment slot;
+
+                if (!m_slots.acquire(key, m_frame, slot))
+                {
+                    continue;
+                }
+
+                const auto base = static_cast<asl::i32>(slot.slot * slot_vertices);
+                const auto count = static_cast<asl::i32>(
+                    std::min(tile->vertices.size(), slot_vertices));
+
+                if (tile->vertices.size() > slot_vertices)
+                {
+                    assert(!"tile larger than its slot");
+
+                    if (!m_overflowed)
+                    {
+                        std::cerr << "Tile of " << tile->vertices.size() << " vertices cut to its slot of "
+                                  << slot_vertices << ": the slots are too small for the refinement depth\n";
+                        m_overflowed = true;
+                    }
+                }
+
+                if (slot.fresh)
+                {
+                    write(base, tile->vertices.data(), count);
+                }
+
+                for (std::size_t i = 0; i < tile->strips.size(); ++i)
+                {
+                    const asl::i32 first = tile->strips.first[i];
+
+                    if (first < count)
+                    {
+                        m_strips.push_back(base + first,
+                                           std::min(tile->strips.count[i], count - first));
+                    }
+                }
+            }
+
+            m_cache.trim(m_visible.size());
+            m_drawn = m_visible;
+
+            // Evicted tiles are requested again from scratch anyway.
+            for (auto it = m_partial.begin(); it != m_partial.end();)
+            {
+                it = m_cache.contains(*it) ? std::next(it) : m_partial.erase(it);
+            }
+
+            return true;
+        }
+
+    private:
+        TileGrid m_grid;
+        TileCache m_cache;
+        TileSlots m_slots;
+
+        std::unordered_set<TileKey, TileKeyHash> m_pending;
+
+        // Cached tiles whose last level is not the final one.
+        std::unordered_set<TileKey, TileKeyHash> m_partial;
+        std::vector<TileKey> m_visible;
+        std::vector<TileKey> m_drawn;
+        StripList m_strips;
+
+        std::uint64_t m_frame = 0;
+        bool m_changed = false;
+        bool m_overflowed = false;
+
+        // Last, so that the thread stops before the rest is destroyed.
+        SamplingWorker m_worker;
+    };
+}
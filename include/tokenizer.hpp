@@ -1,12 +1,15 @@
 #pragma once
 
+#include <array>
 #include <string_view>
 #include <string>
+#include <queue>
 #include <cmath>
 #include <cstring>
 #include <iosfwd>
 
 #include "common_types.h"
+#include "instrument.hpp"
 
 namespace tokenizer
 {
@@ -37,7 +40,7 @@ namespace tokenizer
         double value = 0;
     };
 
-    std::ostream& operator<<(std::ostream& out, Token::Type& type)
+    inline std::ostream& operator<<(std::ostream& out, Token::Type& type)
     {
         out << (int)type;
         return out;
@@ -46,7 +49,7 @@ namespace tokenizer
 
     namespace parsers
     {
-        Token parse_number(const std::string& str, int& index)
+        inline Token parse_number(const std::string& str, int& index)
         {
             constexpr auto is_digit = [] (char c) -> bool {
                 switch (c)
@@ -91,7 +94,7 @@ namespace tokenizer
             }
         }
 
-        Token parse_function(const std::string& str, int& index)
+        inline Token parse_function(const std::string& str, int& index)
         {
             using namespace std::literals;
             Token tok;
@@ -136,7 +139,7 @@ namespace tokenizer
         }
     }
 
-    void skip_whitespace(const std::string& str, int& index)
+    inline void skip_whitespace(const std::string& str, int& index)
     {
         while (str[index] == ' ')
         {
@@ -144,7 +147,7 @@ namespace tokenizer
         }
     }
 
-    Token parse_token(const std::string& str, int& index)
+    inline Token parse_token(const std::string& str, int& index)
     {
         skip_whitespace(str, index);
         auto tok = parsers::parse_number(str, index);
@@ -165,6 +168,7 @@ namespace tokenizer
         case 'x':
         case 'y':
         case 'z':
+        case 't':
         case 'e':
         case 'p':
             tok.symbol = str[index];
@@ -236,4 +240,21 @@ namespace tokenizer
         return tok;
     }
 
+    // Every token of `str`. Trailing blanks leave an EOL token at the end.
+    inline std::queue<Token> tokenize(const std::string& str)
+    {
+        const instrument::Scope scope("tokenize");
+
+        int start = 0;
+        std::queue<Token> tokens;
+
+        while (static_cast<std::size_t>(start) < str.size())
+        {
+            tokens.push(parse_token(str, start));
+        }
+
+        instrument::add(instrument::Counter::Tokens, tokens.size());
+
+        return tokens;
+    }
 }
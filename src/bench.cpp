@@ -0,0 +1,591 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tokenizer.hpp"
+#include "parser.hpp"
+#include "program.hpp"
+#include "sampling.hpp"
+#include "integration.hpp"
+#include "adaptive.hpp"
+#include "implicit.hpp"
+#include "parametric.hpp"
+
+// Micro benchmarks of the expression front end and evaluators over a
+// fixed corpus, and macro benchmarks of integration and plot sampling.
+// Results are printed (or written with --output) as JSON; --compare
+// <baseline.json> flags those slower than the baseline by more than
+// --threshold (10% by default) and exits with 1 if there are any.
+//
+//     bench [--quick] [--filter <text>] [--output <file>]
+//           [--compare <baseline.json> [--input <results.json>]]
+//           [--threshold <fraction>]
+
+namespace
+{
+    volatile double g_sink = 0.0;
+
+    struct Result
+    {
+        std::string name;
+
+        // Nanoseconds per operation: median and best of the runs.
+        double value = 0.0;
+        double best = 0.0;
+
+        std::size_t runs = 0;
+        std::size_t ops = 0;
+    };
+
+    struct Options
+    {
+        bool quick = false;
+        std::string filter;
+
+        // Every benchmark runs for at least this long, in runs of at
+        // least a tenth of it.
+        double min_time = 0.5;
+    };
+
+    // An expression of the corpus, named after its shape.
+    struct Entry
+    {
+        const char* name;
+        std::string text;
+    };
+
+    std::string nested(const char* fun, std::size_t depth)
+    {
+        std::string s;
+
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            s += fun;
+            s += '(';
+        }
+
+        s += 'x';
+        s.append(depth, ')');
+
+        return s;
+    }
+
+    std::string series(std::size_t terms)
+    {
+        std::string s = "1";
+
+        for (std::size_t i = 1; i <= terms; ++i)
+        {
+            s += (i % 2) ? "+x^" : "-x^";
+            s += std::to_string(i);
+            s += "/";
+            s += std::to_string(i + 1);
+        }
+
+        return s;
+    }
+
+    std::vector<Entry> corpus()
+    {
+        return {
+            { "variable", "x" },
+            { "linear", "2*x+1" },
+            { "polynomial", "3*x^3-2*x^2+x-7" },
+            { "trig_mix", "sin(x)*cos(x)+tan(x/3)" },
+            { "transcendental", "sqrt(|x|)+ln(x^2+1)-atan(x)/log(x^2+2)" },
+            { "rational", "(x^2+1)/(x^2-4)+1/(x+1)" },
+            { "nested_sin_4", nested("sin", 4) },
+            { "nested_sin_16", nested("sin", 16) },
+            { "series_16", series(16) },
+            { "series_64", series(64) },
+        };
+    }
+
+    // Runs fn(), which does `ops` operations, until min_time has passed
+    // and at least three times, after sizing the runs to a tenth of it.
+    Result measure(const Options& opt, std::string name, std::size_t ops, const std::function<void()>& fn)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const auto time = [&] (std::size_t reps) {
+            const auto start = Clock::now();
+
+            for (std::size_t i = 0; i < reps; ++i)
+            {
+                fn();
+            }
+
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        };
+
+        const double run_time = opt.min_time / 10.0;
+        std::size_t reps = 1;
+        double first = time(reps);
+
+        while (first < run_time && reps < (std::size_t(1) << 30))
+        {
+            reps *= 2;
+            first = time(reps);
+        }
+
+        std::vector<double> per_op { first / (reps * ops) * 1e9 };
+        double total = first;
+
+        // Runs of over a second, such as integrating 10^9 divisions on a
+        // few cores, are not repeated.
+        const std::size_t min_runs = (first > 1.0) ? 1 : 3;
+
+        while (per_op.size() < min_runs || (total < opt.min_time && per_op.size() < 100))
+        {
+            const double t = time(reps);
+            per_op.push_back(t / (reps * ops) * 1e9);
+            total += t;
+        }
+
+        std::sort(per_op.begin(), per_op.end());
+
+        Result r;
+        r.name = std::move(name);
+        r.value = per_op[per_op.size() / 2];
+        r.best = per_op.front();
+        r.runs = per_op.size();
+        r.ops = reps * ops;
+
+        std::fprintf(stderr, "%-40s %14.3f ns/op\n", r.name.c_str(), r.value);
+
+        return r;
+    }
+
+    void micro(const Options& opt, std::vector<Result>& out)
+    {
+        constexpr std::size_t samples = 4096;
+
+        std::vector<double> xs(samples);
+        std::vector<double> ys(samples);
+
+        for (std::size_t i = 0; i < samples; ++i)
+        {
+            xs[i] = -4.0 + 8.0 * i / samples;
+        }
+
+        const auto wanted = [&] (const std::string& name) {
+            return name.find(opt.filter) != std::string::npos;
+        };
+
+        for (const auto& e : corpus())
+        {
+            const std::string suffix = std::string("/") + e.name;
+
+            if (wanted("tokenize" + suffix))
+            {
+                out.push_back(measure(opt, "tokenize" + suffix, 1, [&] {
+                    g_sink = static_cast<double>(tokenizer::tokenize(e.text).size());
+                }));
+            }
+
+            const auto tokens = tokenizer::tokenize(e.text);
+
+            if (wanted("parse" + suffix))
+            {
+                out.push_back(measure(opt, "parse" + suffix, 1, [&] {
+                    auto copy = tokens;
+                    g_sink = static_cast<double>(parser::create_ast(copy)->type);
+                }));
+            }
+
+            if (wanted("compile" + suffix))
+            {
+                out.push_back(measure(opt, "compile" + suffix, 1, [&] {
+                    g_sink = static_cast<double>(bytecode::compile(e.text).size());
+                }));
+            }
+
+            auto copy = tokens;
+            const auto ast = parser::create_ast(copy);
+
+            if (wanted("eval_tree" + suffix))
+            {
+                const auto fun = parser::visit(*ast);
+
+                out.push_back(measure(opt, "eval_tree" + suffix, samples, [&] {
+                    double sum = 0.0;
+
+                    for (std::size_t i = 0; i < samples; ++i)
+                    {
+                        sum += fun(xs[i]);
+                    }
+
+                    g_sink = sum;
+                }));
+            }
+
+            if (wanted("eval_program" + suffix))
+            {
+                const bytecode::Program program(*ast);
+
+                out.push_back(measure(opt, "eval_program" + suffix, samples, [&] {
+                    program.evaluate(xs.data(), nullptr, ys.data(), samples);
+                    g_sink = ys[samples / 2];
+                }));
+            }
+        }
+    }
+
+    void macro(const Options& opt, std::vector<Result>& out)
+    {
+        const auto wanted = [&] (const std::string& name) {
+            return name.find(opt.filter) != std::string::npos;
+        };
+
+        const std::string text = "sin(x)*cos(x)+x^2/(1+x^2)";
+        const double lower = -10.0;
+        const double upper = 10.0;
+
+        auto tokens = tokenizer::tokenize(text);
+        const auto ast = parser::create_ast(tokens);
+        const auto tree = parser::visit(*ast);
+        const bytecode::Program program(*ast);
+
+        // Macro runs are long enough to be timed one at a time.
+        Options once = opt;
+        once.min_time = 0.0;
+
+        const std::size_t max_power = opt.quick ? 7 : 9;
+
+        for (std::size_t power = 6; power <= max_power; ++power)
+        {
+            const auto divisions = static_cast<std::size_t>(std::pow(10.0, power));
+            const std::string size = "/1e" + std::to_string(power);
+
+            // The original serial rectangle rule over the tree evaluator.
+            if (power <= 7 && wanted("integrate_tree" + size))
+            {
+                out.push_back(measure(once, "integrate_tree" + size, divisions, [&] {
+                    g_sink = integration::function_area(static_cast<double>(divisions), lower, upper, tree);
+                }));
+            }
+
+            // What the session does: sample once, then both rules.
+            if (power <= 8 && wanted("integrate_samples" + size))
+            {
+                out.push_back(measure(once, "integrate_samples" + size, divisions, [&] {
+                    const sampling::SampleBuffer samples(
+                        sampling::batched,
+                        [&] (double x, double step, std::size_t count, double* dst) {
+                            program.evaluate_grid(x, step, count, dst);
+                        },
+                        lower, upper, divisions);
+
+                    g_sink = integration::function_area(samples) + integration::trapezoid_area(samples);
+                }));
+            }
+
+            // Both rules, streaming, with nothing stored.
+            if (wanted("integrate_program" + size))
+            {
+                out.push_back(measure(once, "integrate_program" + size, divisions, [&] {
+                    const auto areas = integration::program_area(program, lower, upper, divisions);
+                    g_sink = areas.rectangles + areas.trapezoids;
+                }));
+            }
+        }
+
+        // Plot sampling for a 1280 x 720 window at 10 pixels per unit.
+        constexpr double width = 1280.0;
+        constexpr double height = 720.0;
+        constexpr double scale = 10.0;
+        constexpr double seed_spacing = 8.0; // pixels
+
+        if (wanted("plot_sample_buffer/1e6"))
+        {
+            out.push_back(measure(opt, "plot_sample_buffer/1e6", 1000000, [&] {
+                const sampling::SampleBuffer samples(tree, lower, upper, 1000000);
+                g_sink = samples[0];
+            }));
+        }
+
+        if (wanted("plot_adaptive"))
+        {
+            const double from = -width / 2.0 / scale;
+            const double to = width / 2.0 / scale;
+
+            sampling::AdaptiveOptions options;
+            options.pixels_per_unit = scale;
+
+            std::vector<sampling::SamplePoint> seeds;
+
+            for (double x = from; x < to + seed_spacing / scale; x += seed_spacing / scale)
+            {
+                seeds.push_back({ x, tree(x) });
+            }
+
+            Curve curve;
+
+            out.push_back(measure(opt, "plot_adaptive", 1, [&] {
+                curve.clear();
+                sampling::sample_adaptive(tree, seeds, options, curve);
+                g_sink = static_cast<double>(curve.vertices.size());
+            }));
+        }
+
+        if (wanted("plot_implicit"))
+        {
+            const auto circle = bytecode::compile("x^2+y^2-900");
+            const grid::Viewport view { -width / 2.0 / scale, width / 2.0 / scale,
+                                        -height / 2.0 / scale, height / 2.0 / scale, scale, scale };
+
+            std::vector<GraphPoint> lines;
+
+            out.push_back(measure(opt, "plot_implicit", 1, [&] {
+                lines.clear();
+                implicit::trace(circle, view, implicit::ContourOptions{}, GraphPoint::Color{ 0, 0, 0, 255 }, lines);
+                g_sink = static_cast<double>(lines.size());
+            }));
+        }
+
+        if (wanted("plot_parametric/1e6"))
+        {
+            auto x_tokens = tokenizer::tokenize("cos(3*x)");
+            auto y_tokens = tokenizer::tokenize("sin(2*x)");
+            const auto x_ast = parser::create_ast(x_tokens);
+            const auto y_ast = parser::create_ast(y_tokens);
+            const auto path = bytecode::Program::parametric(*x_ast, *y_ast);
+
+            Curve curve;
+
+            out.push_back(measure(opt, "plot_parametric/1e6", 1000000, [&] {
+                parametric::sample(path, 0.0, 6.2831853, 1000000, GraphPoint::Color{ 0, 0, 0, 255 }, curve);
+                g_sink = curve.vertices[0].pos.x;
+            }));
+        }
+    }
+
+    std::string to_json(const std::vector<Result>& results)
+    {
+        std::ostringstream out;
+
+        out << "{\n  \"version\": 1,\n  \"threads\": " << parallel::thread_count()
+            << ",\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n";
+
+        char number[64];
+
+        const auto put = [&] (double value) {
+            const auto res = std::to_chars(number, number + sizeof(number), value);
+            out.write(number, res.ptr - number);
+        };
+
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+
+            // One benchmark per line: read_json relies on it.
+            out << "    { \"name\": \"" << r.name << "\", \"value\": ";
+            put(r.value);
+            out << ", \"best\": ";
+            put(r.best);
+            out << ", \"runs\": " << r.runs << ", \"ops\": " << r.ops << " }"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+
+        out << "  ]\n}\n";
+
+        return out.str();
+    }
+
+    // Reads back what to_json writes: name and value of each benchmark.
+    bool read_json(const std::string& path, std::vector<Result>& out)
+    {
+        std::ifstream file(path);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        constexpr std::string_view name_key = "\"name\": \"";
+        constexpr std::string_view value_key = "\"value\": ";
+
+        for (std::string line; std::getline(file, line); )
+        {
+            const auto name = line.find(name_key);
+            const auto value = line.find(value_key);
+
+            if (name == std::string::npos || value == std::string::npos)
+            {
+                continue;
+            }
+
+            const auto name_begin = name + name_key.size();
+            const auto name_end = line.find('"', name_begin);
+
+            Result r;
+            r.name = line.substr(name_begin, name_end - name_begin);
+
+            const char* first = line.data() + value + value_key.size();
+            const auto res = std::from_chars(first, line.data() + line.size(), r.value);
+
+            if (res.ec == std::errc())
+            {
+                out.push_back(std::move(r));
+            }
+        }
+
+        return true;
+    }
+
+    // Prints current against baseline; returns the number of regressions.
+    std::size_t compare(const std::vector<Result>& current, const std::vector<Result>& baseline,
+                        double threshold)
+    {
+        std::size_t regressions = 0;
+
+        std::fprintf(stdout, "%-40s %14s %14s %9s\n", "benchmark", "baseline", "current", "change");
+
+        for (const auto& r : current)
+        {
+            const auto it = std::find_if(baseline.begin(), baseline.end(),
+                                         [&] (const Result& b) { return b.name == r.name; });
+
+            if (it == baseline.end() || it->value <= 0.0)
+            {
+                std::fprintf(stdout, "%-40s %14s %14.3f %9s\n", r.name.c_str(), "-", r.value, "new");
+                continue;
+            }
+
+            const double change = r.value / it->value - 1.0;
+            const char* flag = "";
+
+            if (change > threshold)
+            {
+                flag = "  REGRESSION";
+                ++regressions;
+            }
+            else if (change < -threshold)
+            {
+                flag = "  faster";
+            }
+
+            std::fprintf(stdout, "%-40s %14.3f %14.3f %+8.1f%%%s\n",
+                         r.name.c_str(), it->value, r.value, change * 100.0, flag);
+        }
+
+        return regressions;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    std::string output;
+    std::string baseline;
+    std::string input;
+    double threshold = 0.10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+
+        if (arg == "--quick")
+        {
+            opt.quick = true;
+            opt.min_time = 0.1;
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            opt.filter = argv[++i];
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (arg == "--compare" && i + 1 < argc)
+        {
+            baseline = argv[++i];
+        }
+        else if (arg == "--input" && i + 1 < argc)
+        {
+            input = argv[++i];
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            const std::string_view text(argv[++i]);
+            const auto res = std::from_chars(text.data(), text.data() + text.size(), threshold);
+
+            if (res.ec != std::errc() || res.ptr != text.data() + text.size() || !(threshold >= 0.0))
+            {
+                std::cerr << "Invalid threshold: " << text << '\n';
+                return 2;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << '\n';
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+
+    if (!input.empty())
+    {
+        if (!read_json(input, results))
+        {
+            std::cerr << "Cannot read " << input << '\n';
+            return 2;
+        }
+    }
+    else
+    {
+        micro(opt, results);
+        macro(opt, results);
+
+        const std::string json = to_json(results);
+
+        if (output.empty())
+        {
+            if (baseline.empty())
+            {
+                std::cout << json;
+            }
+        }
+        else
+        {
+            std::ofstream file(output);
+            file << json;
+
+            if (!file)
+            {
+                std::cerr << "Cannot write " << output << '\n';
+                return 2;
+            }
+        }
+    }
+
+    if (baseline.empty())
+    {
+        return 0;
+    }
+
+    std::vector<Result> base;
+
+    if (!read_json(baseline, base))
+    {
+        std::cerr << "Cannot read " << baseline << '\n';
+        return 2;
+    }
+
+    const std::size_t regressions = compare(results, base, threshold);
+
+    std::cout << regressions << " regression(s) above " << threshold * 100.0 << "%\n";
+
+    return (regressions == 0) ? 0 : 1;
+}
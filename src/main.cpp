@@ -6,9 +6,41 @@
 #include <memory>
 #include <deque>
 #include <queue>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <charconv>
+#include <atomic>
+#include <mutex>
+#include <csignal>
+#include <cstdlib>
+#include <new>
 
 #include "tokenizer.hpp"
 #include "parser.hpp"
+#include "sampling.hpp"
+#include "integration.hpp"
+#include "analysis.hpp"
+#include "adaptive.hpp"
+#include "tiled_curve.hpp"
+#include "lod.hpp"
+#include "software_renderer.hpp"
+#include "image_writer.hpp"
+#include "cpu_meter.hpp"
+#include "multi_curve.hpp"
+#include "stream_reader.hpp"
+#include "sample_ring.hpp"
+#include "axis_grid.hpp"
+#include "program.hpp"
+#include "implicit.hpp"
+#include "parametric.hpp"
+#include "batch.hpp"
+#include "sample_file.hpp"
+#include "csv_import.hpp"
+#include "eval_server.hpp"
+#include "instrument.hpp"
 
 #include "tewi/Video/Window.hpp"
 #include "plot_renderer.hpp"
@@ -24,154 +56,418 @@
 
 #include "gsl/assert"
 
-template <typename F>
-constexpr double function_area(const double divisions,
-                      double lower_limit,
-                      double upper_limit,
-                      F&& fun)
+#if SAMPLE_PLOTTER_INSTRUMENT
+// Counts every allocation of the program for --stats. The array and
+// nothrow forms call these. Every delete is kept out of line: inlined into
+// its caller, GCC sees memory from operator new handed to free() and warns
+// of a mismatch (-Wmismatched-new-delete).
+void* operator new(std::size_t size)
 {
-    if (upper_limit < lower_limit)
+    instrument::note_allocation(size);
+
+    if (void* p = std::malloc((size > 0) ? size : 1))
     {
-        std::swap(lower_limit, upper_limit);
+        return p;
     }
 
-    const double deltax = (upper_limit - lower_limit) / divisions;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    instrument::note_allocation(size);
 
-    double res = 0.0;
-    double curr = lower_limit;
+    // aligned_alloc wants a multiple of the alignment.
+    const auto a = static_cast<std::size_t>(align);
 
-    for (int i = 0; i < divisions; ++i)
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a + ((size > 0) ? 0 : a)))
     {
-        curr += deltax;
-        res += fun(curr);
+        return p;
     }
 
-    return res * deltax;
+    throw std::bad_alloc();
 }
 
-template <typename Fun>
-void start_plot(Fun&& fun)
+[[gnu::noinline]] void operator delete(void* p) noexcept
 {
-    using def_tag = tewi::API::OpenGLTag;
+    std::free(p);
+}
 
-    tewi::InputManager inputManager;
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
 
-    tewi::Window<def_tag> win("Plot", tewi::Width{1280}, tewi::Height{720}, &inputManager);
+[[gnu::noinline]] void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
 
-    tewi::TickTimer timer;
+[[gnu::noinline]] void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+#endif
 
-    tewi::setWindowKeyboardCallback(win,
-                                    [] (GLFWwindow* win, int key,
-                                        int scancode, int action, int mods)
-    {
-        auto& inputMan = *(static_cast<tewi::InputManager*>(glfwGetWindowUserPointer(win)));
+// A compiled expression. The function refers to the nodes of the AST, so
+// the two live together.
+struct Expression
+{
+    std::unique_ptr<parser::ExprAST> ast;
+    std::function<double(double)> fun;
 
-        if (action == GLFW_PRESS)
-        {
-            inputMan.pressKey(key);
-        }
-        else if (action == GLFW_RELEASE)
-        {
-            inputMan.releaseKey(key);
-        }
-    });
+    bool valid() const { return ast != nullptr; }
+};
 
-    glfwSetInputMode(win.windowPtr, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+// Text that does not parse is reported on stderr and gives an invalid
+// expression.
+Expression compile_expression(const std::string& str)
+{
+    auto tokens = tokenizer::tokenize(str);
 
-    // :(
-    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LEQUAL);
-    glDepthRange(0.0f, 1.0f);
+    Expression expr;
+    expr.ast = parser::create_ast(tokens);
+
+    if (!expr.ast)
+    {
+        std::cerr << "Cannot parse \"" << str << "\"\n";
+        return expr;
+    }
 
-    constexpr auto max_graph_points = 9000;
-    constexpr auto max_grid_lines = 1500;
-    constexpr auto max_grid_size = max_grid_lines * 2;
-    constexpr auto max_base_graph_size = 4 + max_grid_size;
-    constexpr asl::f64 max_point_interval = 0.1;
+    // Every evaluation of the tree counts, whichever sampler makes it.
+    expr.fun = [f = parser::visit(*expr.ast)] (double x) {
+        instrument::add_local(instrument::Counter::Evaluations);
+        return f(x);
+    };
+
+    return expr;
+}
 
-    std::array<GraphPoint, max_graph_points> graph;
-    std::array<GraphPoint, max_base_graph_size> axis;
+// Reads the argument of `flag` as a number, all of it, as parse_job reads
+// job fields. Anything else is reported on stderr and returns false.
+template <typename T>
+bool parse_argument(std::string_view flag, std::string_view text, T& value)
+{
+    const auto res = std::from_chars(text.data(), text.data() + text.size(), value);
 
+    if (res.ec != std::errc() || res.ptr != text.data() + text.size())
     {
-        asl::mut_f64 init = (0 - (max_graph_points * max_point_interval)) / 2;
+        std::cerr << "Invalid value \"" << text << "\" for " << flag << '\n';
+        return false;
+    }
 
-        for (asl::mut_num i = 0; i < max_graph_points; ++i)
-        {
-            graph[i].pos.x = init;
-            graph[i].pos.y = fun(init);
+    return true;
+}
 
-            graph[i].color.r = 0;
-            graph[i].color.g = 0;
-            graph[i].color.b = 255;
-            graph[i].color.a = 255;
+// The plane seen by a window of `width` x `height` pixels centred on
+// (center_x, center_y), at `scale` pixels per unit.
+grid::Viewport plot_viewport(asl::f64 center_x, asl::f64 center_y,
+                             asl::f64 width, asl::f64 height, asl::f64 scale)
+{
+    return grid::Viewport { center_x - width / 2.0 / scale, center_x + width / 2.0 / scale,
+                            center_y - height / 2.0 / scale, center_y + height / 2.0 / scale,
+                            scale, scale };
+}
 
-            init += max_point_interval;
+// f as seen by the plot: values on the session grid come from the
+// samples, anything else is evaluated.
+template <typename Fun>
+auto session_function(Fun& fun, const sampling::SampleBuffer& samples)
+{
+    return [&fun, &samples] (asl::f64 x) -> asl::f64 {
+        if (const auto y = samples.lookup(x))
+        {
+            return *y;
         }
-    }
 
+        return fun(x);
+    };
+}
+
+// Seeds for a tile over [from, to]: its endpoints and the session samples
+// in between, which cost nothing, thinned to at most `max_segments`.
+template <typename Eval>
+std::vector<sampling::SamplePoint> tile_seeds(const sampling::SampleBuffer& samples, Eval& eval,
+                                              asl::f64 from, asl::f64 to, std::size_t max_segments)
+{
+    std::vector<sampling::SamplePoint> seeds;
+    seeds.push_back({ from, eval(from) });
+
+    const asl::f64 first = std::ceil((from - samples.lower()) / samples.step());
+    const asl::f64 last = std::floor((to - samples.lower()) / samples.step());
+
+    if (samples.step() > 0.0 && last >= first && last >= 0.0 && first <= samples.divisions())
     {
-        axis[0].pos.x = -10000.0f;
-        axis[0].pos.y = 0;
-        axis[1].pos.x = 10000.0f;
-        axis[1].pos.y = 0;
+        const auto begin = static_cast<std::size_t>(std::max(first, 0.0));
+        const auto end = static_cast<std::size_t>(std::min<asl::f64>(last, samples.divisions())) + 1;
+        const std::size_t stride = (end - begin + max_segments - 1) / max_segments;
 
-        axis[2].pos.x = 0;
-        axis[2].pos.y = -10000.0f;
-        axis[3].pos.x = 0;
-        axis[3].pos.y = 10000.0f;
+        for (std::size_t i = begin; i < end; i += stride)
+        {
+            if (samples.x(i) > from && samples.x(i) < to)
+            {
+                seeds.push_back({ samples.x(i), samples[i] });
+            }
+        }
     }
 
-    for (asl::mut_num i = 0; i < 4; ++i)
-    {
-        axis[i].color.r = 0;
-        axis[i].color.g = 0;
-        axis[i].color.b = 0;
-        axis[i].color.a = 255;
+    seeds.push_back({ to, eval(to) });
 
-        axis[i].color.r = 0;
-        axis[i].color.g = 0;
-        axis[i].color.b = 0;
-        axis[i].color.a = 255;
+    return seeds;
+}
+
+// The cumulative integral has one value per division, possibly millions
+// of them: it is drawn through an M4 pyramid, at most four points per
+// pixel column of the current zoom.
+lod::M4Pyramid make_integral_lod(const integration::CumulativeIntegral& integral)
+{
+    return lod::M4Pyramid(integral.values().size(), [&integral] (std::size_t i) {
+        return glm::vec2(integral.lower() + i * integral.step(), integral.values()[i]);
+    });
+}
+
+// The session samples as a compact curve. 16-bit y values are used when
+// they are precise to half a pixel at the largest zoom.
+CompactCurve make_sample_curve(const sampling::SampleBuffer& samples, asl::f32 max_scale)
+{
+    return CompactCurve::from_samples(samples.lower(), samples.step(),
+                                      samples.values().data(), samples.size(),
+                                      GraphPoint::Color{ 0, 150, 0, 255 }, 0.5 / max_scale);
+}
+
+// Samples in [from, to], only once they are at least `spacing` pixels
+// apart: denser than that they are just the curve.
+void visible_samples(const CompactCurve& curve, const sampling::SampleBuffer& samples,
+                     asl::f64 from, asl::f64 to, asl::f64 scale, asl::f64 spacing,
+                     StripList& out)
+{
+    out.clear();
+
+    if (samples.step() * scale < spacing || to < samples.lower() || from > samples.upper())
+    {
+        return;
     }
 
+    const asl::f64 last = static_cast<asl::f64>(samples.divisions());
+    const auto first_index = std::clamp(std::floor((from - samples.lower()) / samples.step()), 0.0, last);
+    const auto last_index = std::clamp(std::ceil((to - samples.lower()) / samples.step()), 0.0, last);
+
+    curve.clip_strips(static_cast<std::size_t>(first_index),
+                      static_cast<std::size_t>(last_index), out);
+}
+
+// Samples the overlay curves over [from, to] for the given scale and
+// stores them in `buffer`, one slice per curve.
+void update_overlays(const std::vector<overlay::Function>& overlays,
+                     asl::f64 from, asl::f64 to, asl::f64 scale, asl::f64 seed_spacing,
+                     overlay::CurveBuffer& buffer, std::vector<overlay::CurveBuffer::Id>& ids)
+{
+    std::vector<Curve> curves;
+
+    sampling::AdaptiveOptions options;
+    options.pixels_per_unit = scale;
+
+    overlay::sample_curves(overlays, from, to, options, seed_spacing, curves);
+
+    for (std::size_t i = 0; i < curves.size(); ++i)
     {
-        asl::mut_f64 start = (0 - (max_grid_lines / 4));
-        for (asl::mut_num i = 4; i < max_grid_lines; i += 2)
+        if (i < ids.size())
+        {
+            buffer.replace(ids[i], curves[i]);
+        }
+        else
         {
-            axis[i].pos.x = -10000.0f;
-            axis[i].pos.y = start;
-            axis[i + 1].pos.x = 10000.0f;
-            axis[i + 1].pos.y = start;
-            start += 1;
+            ids.push_back(buffer.add(curves[i], overlay::palette(i)));
         }
     }
+}
+
+// A parametric or polar curve, over t in [from, to].
+struct Path
+{
+    bytecode::Program program;
+    asl::mut_f64 from;
+    asl::mut_f64 to;
+};
+
+// Samples the parametric and polar curves into one vertex buffer, one
+// strip (or more, where a curve is undefined) per curve. Their colours
+// follow those of the `first_color` curves before them.
+Curve sample_paths(const std::vector<Path>& paths, std::size_t first_color)
+{
+    constexpr std::size_t samples_per_path = 1 << 16;
+
+    Curve all;
+    Curve part;
 
+    for (std::size_t i = 0; i < paths.size(); ++i)
     {
-        asl::mut_f64 start = (0 - (max_grid_lines / 4));
-        for (asl::mut_num i = max_grid_lines; i < max_base_graph_size; i += 2)
-        {
-            axis[i].pos.x = start;
-            axis[i].pos.y = -10000.0f;
-            axis[i + 1].pos.x = start;
-            axis[i + 1].pos.y = 10000.0f;
+        parametric::sample(paths[i].program, paths[i].from, paths[i].to, samples_per_path,
+                           overlay::palette(first_color + i).color, part);
+
+        const auto offset = static_cast<asl::mut_i32>(all.vertices.size());
 
-            start++;
+        all.vertices.insert(all.vertices.end(), part.vertices.begin(), part.vertices.end());
+
+        for (std::size_t k = 0; k < part.strips.size(); ++k)
+        {
+            all.strips.push_back(offset + part.strips.first[k], part.strips.count[k]);
         }
     }
 
-    for (asl::mut_num i = 4; i < max_base_graph_size; ++i)
+    return all;
+}
+
+// The implicit curves f(x, y) = 0 over `view`, as GL_LINES vertices.
+// Their colours follow those of the `first_color` overlays before them.
+void trace_implicits(const std::vector<bytecode::Program>& implicits, const grid::Viewport& view,
+                     std::size_t first_color, std::vector<GraphPoint>& out)
+{
+    out.clear();
+
+    for (std::size_t i = 0; i < implicits.size(); ++i)
     {
-        axis[i].color.r = 0;
-        axis[i].color.g = 0;
-        axis[i].color.b = 0;
-        axis[i].color.a = 20;
+        implicit::trace(implicits[i], view, implicit::ContourOptions{},
+                        overlay::palette(first_color + i).color, out);
     }
+}
+
+template <typename Fun>
+void start_plot(Fun&& fun,
+                const sampling::SampleBuffer& samples,
+                const integration::CumulativeIntegral& integral,
+                const std::vector<overlay::Function>& overlays,
+                const std::vector<bytecode::Program>& implicits,
+                const Curve& paths,
+                const Curve& measured)
+{
+    using def_tag = tewi::API::OpenGLTag;
+
+    tewi::InputManager inputManager;
+
+    tewi::Window<def_tag> win("Plot", tewi::Width{1280}, tewi::Height{720}, &inputManager);
+
+    tewi::TickTimer timer;
+
+    tewi::setWindowKeyboardCallback(win,
+                                    [] (GLFWwindow* win, int key,
+                                        int scancode, int action, int mods)
+    {
+        auto& inputMan = *(static_cast<tewi::InputManager*>(glfwGetWindowUserPointer(win)));
+
+        if (action == GLFW_PRESS)
+        {
+            inputMan.pressKey(key);
+        }
+        else if (action == GLFW_RELEASE)
+        {
+            inputMan.releaseKey(key);
+        }
+    });
+
+    glfwSetInputMode(win.windowPtr, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+
+    // :(
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LEQUAL);
+    glDepthRange(0.0f, 1.0f);
 
-    PlotRenderer2D<def_tag, max_graph_points> rend{graph};
-    PlotRenderer2D<def_tag, max_base_graph_size> axis_rend{axis};
+    constexpr asl::f64 seed_spacing = 8.0; // pixels
+    constexpr std::size_t max_cached_vertices = 1 << 20;
+    constexpr std::chrono::microseconds refine_budget{2000};
+    constexpr asl::f64 retry_interval = 0.01; // seconds
+    constexpr asl::i32 screen_width = 1280;
+    constexpr asl::i32 screen_height = 720;
+    constexpr asl::i32 max_lod_points = 4 * (screen_width + 8);
+    constexpr asl::f32 max_scale = 100.0f;
+    constexpr asl::f64 sample_spacing = 4.0; // pixels
+    constexpr asl::f32 sample_point_size = 3.0f;
+
+    asl::mut_f32 graph_scale = 10.0f;
 
+    // Axes and grid are rebuilt for the view whenever it changes.
+    const grid::GridOptions grid_options;
+    std::vector<GraphPoint> axis;
+    grid::Viewport axis_view {};
+
+    // Seeds inside the integration range come from the session samples,
+    // and so do most of the refinement points.
+    const auto eval = session_function(fun, samples);
+
+    // The curve is sampled lazily on a background thread, one x-tile at a
+    // time, for the tiles in view at the current zoom level. Tiles start
+    // from their endpoints and are refined level by level, down to 1/16 of
+    // a pixel, and their slots hold the most vertices that can give.
+    const sampling::TileGrid tile_grid;
+    const int tile_min_depth = static_cast<int>(std::ceil(std::log2(tile_grid.tile_pixels / seed_spacing)));
+    const int tile_max_depth = static_cast<int>(std::ceil(std::log2(tile_grid.tile_pixels))) + 4;
+
+    // Inside the integration range tiles start from the session samples
+    // instead: the depths then count from the segments those make, so the
+    // tile is split as finely and still fits its slot.
+    sampling::TiledCurve graph(
+        [&] (sampling::TileKey key, sampling::ProgressiveSampler& sampler) {
+            auto seeds = tile_seeds(samples, eval, tile_grid.lower(key), tile_grid.upper(key),
+                                    std::size_t(1) << tile_min_depth);
+
+            const auto segments = static_cast<asl::f64>(seeds.size() - 1);
+
+            sampling::AdaptiveOptions options;
+            options.pixels_per_unit = tile_grid.scale(key.level);
+            options.min_depth = std::max(0, tile_min_depth - static_cast<int>(std::floor(std::log2(segments))));
+            options.max_depth = tile_max_depth - static_cast<int>(std::ceil(std::log2(segments)));
+
+            sampler.reset(eval, options, std::move(seeds));
+        },
+        tile_grid,
+        refine_budget,
+        max_cached_vertices,
+        32,
+        sampling::max_vertices(tile_max_depth));
+
+    const auto integral_lod = make_integral_lod(integral);
+
+    std::vector<GraphPoint> integral_graph;
+    integral_graph.reserve(max_lod_points);
+
+    asl::mut_f64 integral_from = 0.0;
+    asl::mut_f64 integral_to = 0.0;
+    asl::mut_f64 integral_scale = 0.0;
+
+    PlotRenderer2D<def_tag> rend{static_cast<asl::i32>(graph.capacity())};
+    PlotRenderer2D<def_tag> integral_rend{max_lod_points};
+    PlotRenderer2D<def_tag> axis_rend{1};
+
+    // Overlay curves share one buffer and one draw call. They are sampled
+    // for three screen widths around the view and again when the view
+    // leaves that range or the zoom level changes.
+    overlay::CurveBuffer overlay_curves;
+    std::vector<overlay::CurveBuffer::Id> overlay_ids;
+    PlotRenderer2D<def_tag> overlay_rend{1};
+
+    // Parametric and polar curves do not depend on the view: they are
+    // uploaded once.
+    PlotRenderer2D<def_tag> path_rend{std::max<asl::i32>(1, static_cast<asl::i32>(paths.vertices.size()))};
+    path_rend.update(0, paths.vertices.data(), static_cast<asl::i32>(paths.vertices.size()));
+
+    // So are the imported samples.
+    PlotRenderer2D<def_tag> measured_rend{std::max<asl::i32>(1, static_cast<asl::i32>(measured.vertices.size()))};
+    measured_rend.update(0, measured.vertices.data(), static_cast<asl::i32>(measured.vertices.size()));
+
+    // Implicit curves are traced again for every new view.
+    std::vector<GraphPoint> implicit_graph;
+    PlotRenderer2D<def_tag> implicit_rend{1};
+
+    asl::mut_f64 overlay_from = 0.0;
+    asl::mut_f64 overlay_to = 0.0;
+    asl::mut_num overlay_level = -1;
+
+    // The session samples are uploaded once, y only.
+    const auto sample_curve = make_sample_curve(samples, max_scale);
+    CompactRenderer2D<def_tag> samples_rend{sample_curve};
+    StripList sample_strips;
 
     using VertexShader = tewi::Shader<def_tag, tewi::VertexShader, tewi::ShaderFromMemoryPolicy>;
     using FragmentShader = tewi::Shader<def_tag, tewi::FragmentShader, tewi::ShaderFromMemoryPolicy>;
@@ -181,6 +477,11 @@ void start_plot(Fun&& fun)
 
     tewi::ShaderProgram<def_tag> shader(g_vertlocations, vert, frag);
 
+    const auto mvp_location = shader.getUniformLocation("MVP");
+    const auto point_size_location = shader.getUniformLocation("pointSize");
+    const auto scale_location = shader.getUniformLocation("scale");
+    const auto compact_locations = CompactRenderer2D<def_tag>::locate(shader);
+
     auto proj = glm::ortho(-1280.0f / 2, 1280.0f / 2, -720.0f / 2, 720.0f / 2);
 
     glm::mat4 view(1);
@@ -189,14 +490,65 @@ void start_plot(Fun&& fun)
     asl::mut_num rend_type = GL_LINE_STRIP;
     asl::mut_f32 point_size = 1.0f;
     asl::mut_f32 line_thickness = 1.0f;
-    asl::mut_f32 graph_scale = 10.0f;
+
+    // Keys that keep the view moving while held.
+    constexpr std::array<int, 10> animation_keys {
+        GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q,
+        GLFW_KEY_E, GLFW_KEY_0, GLFW_KEY_9, GLFW_KEY_F1, GLFW_KEY_F2
+    };
+
+    // Longest step the view may take in one frame, so the first frame
+    // after a long wait does not jump.
+    constexpr asl::f32 max_frame_time = 1.0f / 30.0f;
+
+    // Frames are only drawn when something changed: keys being held, new
+    // tiles from the worker, or any window event. Otherwise the loop
+    // sleeps in glfwWaitEvents, and the worker wakes it up when it
+    // publishes a tile. Tiles that did not fit in the request queue get
+    // no such wake-up, so the wait times out while they are pending.
+    graph.worker().on_publish([] { glfwPostEmptyEvent(); });
+
+    stats::CpuMeter idle_meter;
+    stats::CpuMeter session_meter;
+    asl::mut_u64 frames = 0;
+    bool idle = false;
+
+    session_meter.start();
 
     while (!tewi::isWindowClosed(win))
     {
-        tewi::pollWindowEvents(win);
+        if (idle)
+        {
+            idle_meter.start();
+
+            if (graph.retry_pending())
+            {
+                glfwWaitEventsTimeout(retry_interval);
+            }
+            else
+            {
+                glfwWaitEvents();
+            }
+
+            idle_meter.stop();
+        }
+        else
+        {
+            tewi::pollWindowEvents(win);
+        }
+
+        // The whole iteration but the wait: updates and drawing.
+        const instrument::Scope frame_scope("frame");
+
+        const bool animating = std::any_of(animation_keys.begin(), animation_keys.end(),
+                                           [&] (int key) { return inputManager.isKeyDown(key); });
+
+        // Any wake-up draws a frame: it comes from the worker or from a
+        // window event (resize, expose, key) that may need one.
+        bool redraw = idle || animating || frames == 0;
 
         {
-            const auto deltatime = timer.getDeltaTime();
+            const auto deltatime = std::min<asl::mut_f32>(timer.getDeltaTime(), max_frame_time);
             const auto camera_speed = 200 * deltatime;
             const auto scale_speed = 10.0f * deltatime;
 
@@ -223,20 +575,15 @@ void start_plot(Fun&& fun)
                 }
             }
 
+            // Horizontal panning is unbounded: tiles follow the view.
             if (inputManager.isKeyDown(GLFW_KEY_A))
             {
-                if (glm::vec3 pos{view[3]}; pos.x <= max_margin)
-                {
-                    view = glm::translate(view, glm::vec3(camera_speed, 0.0f, 0.0f));
-                }
+                view = glm::translate(view, glm::vec3(camera_speed, 0.0f, 0.0f));
             }
 
             if (inputManager.isKeyDown(GLFW_KEY_D))
             {
-                if (glm::vec3 pos{view[3]}; pos.x >= -max_margin)
-                {
-                    view = glm::translate(view, glm::vec3(-camera_speed, 0.0f, 0.0f));
-                }
+                view = glm::translate(view, glm::vec3(-camera_speed, 0.0f, 0.0f));
             }
 
             if (inputManager.isKeyDown(GLFW_KEY_Q))
@@ -249,7 +596,7 @@ void start_plot(Fun&& fun)
 
             if (inputManager.isKeyDown(GLFW_KEY_E))
             {
-                if (graph_scale <= 100.0f)
+                if (graph_scale <= max_scale)
                 {
                     graph_scale += scale_speed;
                 }
@@ -284,79 +631,1253 @@ void start_plot(Fun&& fun)
             }
         }
 
+        {
+            const glm::vec3 pos{view[3]};
+            const asl::f64 view_from = (-screen_width / 2.0f - pos.x) / graph_scale;
+            const asl::f64 view_to = (screen_width / 2.0f - pos.x) / graph_scale;
+
+            if (graph.update(view_from, view_to, graph_scale,
+                             [&] (asl::i32 offset, const GraphPoint* data, asl::i32 count) {
+                                 rend.update(offset, data, count);
+                             }))
+            {
+                redraw = true;
+            }
+
+            const auto visible = plot_viewport(-pos.x / graph_scale, -pos.y / graph_scale,
+                                               screen_width, screen_height, graph_scale);
+
+            if (visible.x_from != axis_view.x_from || visible.y_from != axis_view.y_from ||
+                visible.x_scale != axis_view.x_scale)
+            {
+                axis_view = visible;
+
+                grid::build_grid(visible, grid_options, axis);
+
+                const auto count = static_cast<asl::i32>(axis.size());
+
+                axis_rend.reserve(count);
+                axis_rend.update(0, axis.data(), count);
+                axis_rend.resize(count);
+
+                if (!implicits.empty())
+                {
+                    trace_implicits(implicits, visible, overlays.size(), implicit_graph);
+
+                    const auto implicit_count = static_cast<asl::i32>(implicit_graph.size());
+
+                    implicit_rend.reserve(implicit_count);
+                    implicit_rend.update(0, implicit_graph.data(), implicit_count);
+                    implicit_rend.resize(implicit_count);
+                }
+            }
+
+            if (view_from != integral_from || view_to != integral_to ||
+                graph_scale != integral_scale)
+            {
+                integral_from = view_from;
+                integral_to = view_to;
+                integral_scale = graph_scale;
+
+                integral_graph.clear();
+                integral_lod.emit(view_from, view_to, graph_scale,
+                                  GraphPoint::Color{ 255, 0, 0, 255 }, integral_graph);
+
+                const auto count = static_cast<asl::i32>(integral_graph.size());
+
+                integral_rend.update(0, integral_graph.data(), count);
+                integral_rend.resize(count);
+            }
+
+            visible_samples(sample_curve, samples, view_from, view_to, graph_scale,
+                            sample_spacing, sample_strips);
+
+            const auto level = graph.grid().level_for(graph_scale);
+
+            if (!overlays.empty() &&
+                (level != overlay_level || view_from < overlay_from || view_to > overlay_to))
+            {
+                const asl::f64 width = view_to - view_from;
+
+                overlay_from = view_from - width;
+                overlay_to = view_to + width;
+                overlay_level = level;
+
+                update_overlays(overlays, overlay_from, overlay_to, graph.grid().scale(level),
+                                seed_spacing, overlay_curves, overlay_ids);
+
+                overlay_rend.reserve(static_cast<asl::i32>(overlay_curves.size()));
+                overlay_curves.flush([&] (asl::i32 offset, const GraphPoint* data, asl::i32 count) {
+                    overlay_rend.update(offset, data, count);
+                });
+
+                redraw = true;
+            }
+        }
+
+        idle = !animating;
+
+        if (!redraw)
+        {
+            continue;
+        }
+
+        ++frames;
+        instrument::add(instrument::Counter::Frames);
+
         MVP = proj * view;
 
         win.context.preDraw();
 
         shader.enable();
 
-        tewi::setUniform(shader.getUniformLocation("MVP"), MVP);
-        tewi::setUniform(shader.getUniformLocation("pointSize"), point_size);
-        tewi::setUniform(shader.getUniformLocation("scale"), graph_scale);
+        tewi::setUniform(mvp_location, MVP);
+        tewi::setUniform(point_size_location, point_size);
+        tewi::setUniform(scale_location, graph_scale);
 
         axis_rend.begin();
         axis_rend.end();
         axis_rend.draw(GL_LINES);
 
+        overlay_rend.begin();
+        overlay_rend.end();
+        overlay_rend.draw_strips(rend_type, overlay_curves.strips());
+
+        implicit_rend.begin();
+        implicit_rend.end();
+        implicit_rend.draw(GL_LINES);
+
+        path_rend.begin();
+        path_rend.end();
+        path_rend.draw_strips(rend_type, paths.strips);
+
+        measured_rend.begin();
+        measured_rend.end();
+        measured_rend.draw_strips(rend_type, measured.strips);
+
         rend.begin();
         rend.end();
-        rend.draw(rend_type);
+        rend.draw_strips(rend_type, graph.strips());
+
+        integral_rend.begin();
+        integral_rend.end();
+        integral_rend.draw(rend_type);
+
+        if (sample_strips.size() > 0)
+        {
+            tewi::setUniform(point_size_location, std::max(point_size, sample_point_size));
+            samples_rend.draw_strips(compact_locations, GL_POINTS, sample_strips);
+        }
 
         shader.disable();
 
         win.context.postDraw();
 
         tewi::swapWindowBuffers(win);
+
+        instrument::sample_counters();
     }
-}
 
+    session_meter.stop();
 
-int main()
+    std::cout << "Frames drawn: " << frames << " in " << session_meter.wall_seconds() << " s\n"
+              << "CPU usage: " << session_meter.usage() * 100.0 << "% of a core, "
+              << idle_meter.usage() * 100.0 << "% while idle ("
+              << idle_meter.wall_seconds() << " s idle)\n";
+}
+
+// Draws the initial view of start_plot into an image file with the
+// software rasterizer, in `bands` parallel bands; no window or GL context
+// is needed.
+template <typename Fun>
+bool render_plot(Fun&& fun,
+                 const sampling::SampleBuffer& samples,
+                 const integration::CumulativeIntegral& integral,
+                 const std::vector<overlay::Function>& overlays,
+                 const std::vector<bytecode::Program>& implicits,
+                 const Curve& paths,
+                 const Curve& measured,
+                 const std::string& path,
+                 asl::i32 width, asl::i32 height, asl::f32 graph_scale,
+                 asl::i32 bands = static_cast<asl::i32>(parallel::thread_count()))
 {
-    std::cout << "y = ";
-    std::string str;
-    std::getline(std::cin, str);
+    using def_tag = raster::SoftwareTag;
+
+    const instrument::Scope scope("render");
+
+    constexpr asl::f64 seed_spacing = 8.0; // pixels
+    constexpr asl::f32 max_scale = 100.0f;
+    constexpr asl::f64 sample_spacing = 4.0; // pixels
+    constexpr asl::f32 sample_point_size = 3.0f;
 
-    int start = 0;
-    std::queue<tokenizer::Token> tokens;
-    while (str[start] != '\0')
+    raster::Canvas canvas(width, height, bands);
+
+    canvas.clear({ 255, 255, 255, 255 });
+    canvas.set_mvp(glm::ortho(-width / 2.0f, width / 2.0f, -height / 2.0f, height / 2.0f));
+    canvas.set_point_size(1.0f);
+    canvas.set_scale(graph_scale);
+
+    const asl::f64 view_from = -width / 2.0 / graph_scale;
+    const asl::f64 view_to = width / 2.0 / graph_scale;
+
+    const auto eval = session_function(fun, samples);
+
+    sampling::AdaptiveOptions options;
+    options.pixels_per_unit = graph_scale;
+
+    std::vector<sampling::SamplePoint> seeds;
+    const asl::f64 seed_step = seed_spacing / graph_scale;
+
+    for (asl::mut_f64 x = view_from; x < view_to + seed_step; x += seed_step)
     {
-        tokenizer::Token t = tokenizer::parse_token(str, start);
-        if ((t.type != tokenizer::Token::Type::Error) ||
-            (t.type != tokenizer::Token::Type::EOL))
-        {
-            tokens.push(t);
-        }
+        seeds.push_back({ x, eval(x) });
     }
 
-    auto root = parser::create_ast(tokens);
+    Curve graph;
+    sampling::sample_adaptive(eval, seeds, options, graph);
 
-    parser::ExprAST* currnode = root.get();
+    std::vector<GraphPoint> integral_graph;
+    make_integral_lod(integral).emit(view_from, view_to, graph_scale,
+                                     GraphPoint::Color{ 255, 0, 0, 255 }, integral_graph);
 
-    auto fun = parser::visit(*currnode);
+    const auto sample_curve = make_sample_curve(samples, max_scale);
+    StripList sample_strips;
+    visible_samples(sample_curve, samples, view_from, view_to, graph_scale,
+                    sample_spacing, sample_strips);
 
-    double divisions = 0.0;
-    double a = 0.0;
-    double b = 0.0;
+    overlay::CurveBuffer overlay_curves;
+    std::vector<overlay::CurveBuffer::Id> overlay_ids;
 
-    std::cout << "For f(x) = " << str << ":\n";
-    std::cout << "Lower limit: ";
-    std::cin >> a;
-    std::cout << "Upper limit: ";
-    std::cin >> b;
-    std::cout << "Number of divisions: ";
-    std::cin >> divisions;
+    update_overlays(overlays, view_from, view_to, graph_scale, seed_spacing,
+                    overlay_curves, overlay_ids);
 
-    std::cout << '\n';
-    std::cout << "Area calcolata col metodo dei rettangoli: "
-              << function_area(divisions, a, b, fun)  << '\n';
+    std::vector<GraphPoint> axis;
+    grid::build_grid(plot_viewport(0.0, 0.0, width, height, graph_scale), grid::GridOptions{}, axis);
 
-    std::cout << "Do you want to see the function plot? [Y/N]: ";
-    char res = '\0';
+    PlotRenderer2D<def_tag> axis_rend{canvas, axis};
+    std::vector<GraphPoint> implicit_graph;
+    trace_implicits(implicits, plot_viewport(0.0, 0.0, width, height, graph_scale),
+                    overlays.size(), implicit_graph);
 
-    std::cin >> res;
-    if (res == 'y' || res == 'Y')
+    PlotRenderer2D<def_tag> overlay_rend{canvas, overlay_curves.vertices()};
+    PlotRenderer2D<def_tag> implicit_rend{canvas, implicit_graph};
+    PlotRenderer2D<def_tag> path_rend{canvas, paths.vertices};
+    PlotRenderer2D<def_tag> measured_rend{canvas, measured.vertices};
+    PlotRenderer2D<def_tag> rend{canvas, graph.vertices};
+    PlotRenderer2D<def_tag> integral_rend{canvas, integral_graph};
+    CompactRenderer2D<def_tag> samples_rend{canvas, sample_curve};
+
+    axis_rend.draw(raster::Mode::Lines);
+    overlay_rend.draw_strips(raster::Mode::LineStrip, overlay_curves.strips());
+    implicit_rend.draw(raster::Mode::Lines);
+    path_rend.draw_strips(raster::Mode::LineStrip, paths.strips);
+    measured_rend.draw_strips(raster::Mode::LineStrip, measured.strips);
+    rend.draw_strips(raster::Mode::LineStrip, graph.strips);
+    integral_rend.draw(raster::Mode::LineStrip);
+
+    canvas.set_point_size(sample_point_size);
+    samples_rend.draw_strips(raster::Mode::Points, sample_strips);
+
+    canvas.flush();
+
+    return raster::write_image(canvas.framebuffer(), path);
+}
+
+// Renders one image per job, "expression; lower; upper; divisions; image"
+// (see batch::parse_job), from `lines` and then from `job_file` ("-" for
+// stdin, "" for none). The jobs are spread over a pool of workers, each
+// sampling and rasterizing its plot on its own thread: many plots keep
+// every core busy without splitting any of them in bands.
+int render_jobs(const std::vector<std::string>& lines, const std::string& job_file,
+                asl::i32 width, asl::i32 height, asl::f32 scale)
+{
+    struct RenderJob
     {
-        start_plot(fun);
+        batch::Job job;
+        std::string source;
+        std::size_t line;
+    };
+
+    std::vector<RenderJob> jobs;
+    std::size_t failed = 0;
+
+    const auto add = [&] (const std::string& source, std::size_t line_number, const std::string& line) {
+        const auto text = batch::trim(line);
+
+        if (text.empty() || text.front() == '#')
+        {
+            return;
+        }
+
+        RenderJob r { {}, source, line_number };
+
+        if (!batch::parse_job(text, r.job) || r.job.output.empty())
+        {
+            std::cerr << source << ':' << line_number << ": expected "
+                      << "\"expression; lower; upper; divisions; image\"\n";
+            ++failed;
+            return;
+        }
+
+        jobs.push_back(std::move(r));
+    };
+
+    for (std::size_t i = 0; i < lines.size(); ++i)
+    {
+        add("render job", i + 1, lines[i]);
+    }
+
+    if (!job_file.empty())
+    {
+        std::ifstream file;
+
+        if (job_file != "-")
+        {
+            file.open(job_file);
+
+            if (!file)
+            {
+                std::cerr << "Cannot read " << job_file << '\n';
+                return 1;
+            }
+        }
+
+        std::istream& in = (job_file == "-") ? std::cin : file;
+        std::size_t line_number = 0;
+
+        for (std::string line; std::getline(in, line); )
+        {
+            add(job_file, ++line_number, line);
+        }
+    }
+
+    const instrument::Scope scope("render jobs", jobs.size());
+    const auto start = std::chrono::steady_clock::now();
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> written{0};
+    std::mutex report;
+
+    const std::vector<overlay::Function> overlays;
+    const std::vector<bytecode::Program> implicits;
+    const Curve none;
+
+    parallel::for_chunks(parallel::thread_count(), [&] (std::size_t, std::size_t, std::size_t) {
+        for (std::size_t i = next++; i < jobs.size(); i = next++)
+        {
+            const auto& r = jobs[i];
+            const auto program = bytecode::compile(r.job.expression);
+            const auto fun = [&program] (asl::f64 x) { return program(x); };
+
+            if (!program.valid())
+            {
+                std::lock_guard<std::mutex> lock(report);
+                std::cerr << r.source << ':' << r.line << ": cannot parse the expression\n";
+                continue;
+            }
+
+            const auto sweep = integration::sweep(fun, r.job.lower, r.job.upper, r.job.divisions,
+                                                  integration::max_table_points, 1);
+
+            const bool ok = render_plot(fun, sweep.samples, sweep.integral, overlays, implicits, none, none,
+                                        r.job.output, width, height, scale, 1);
+
+            std::lock_guard<std::mutex> lock(report);
+
+            if (ok)
+            {
+                std::cout << r.job.output << '\n';
+                ++written;
+            }
+            else
+            {
+                std::cerr << r.source << ':' << r.line << ": cannot write " << r.job.output << '\n';
+            }
+        }
+    });
+
+    const std::chrono::duration<asl::f64> seconds = std::chrono::steady_clock::now() - start;
+
+    std::cerr << written << " of " << jobs.size() + failed << " plots rendered in "
+              << seconds.count() << " s on " << parallel::thread_count() << " threads\n";
+
+    return (written == jobs.size() && failed == 0) ? 0 : 1;
+}
+
+// Plots samples as they arrive on stdin or a pipe, one "t v" or "v" per
+// line. The last `capacity` samples are kept, and the view follows them:
+// x spans the samples in the ring, y their minimum and maximum.
+void start_stream(const std::string& path, std::size_t capacity)
+{
+    using def_tag = tewi::API::OpenGLTag;
+
+    streaming::StreamReader reader(path);
+
+    if (!reader.valid())
+    {
+        std::cerr << "Cannot read " << path << '\n';
+        return;
+    }
+
+    tewi::InputManager inputManager;
+
+    tewi::Window<def_tag> win("Stream", tewi::Width{1280}, tewi::Height{720}, &inputManager);
+
+    tewi::setWindowKeyboardCallback(win,
+                                    [] (GLFWwindow* win, int key,
+                                        int scancode, int action, int mods)
+    {
+        auto& inputMan = *(static_cast<tewi::InputManager*>(glfwGetWindowUserPointer(win)));
+
+        if (action == GLFW_PRESS)
+        {
+            inputMan.pressKey(key);
+        }
+        else if (action == GLFW_RELEASE)
+        {
+            inputMan.releaseKey(key);
+        }
+    });
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LEQUAL);
+    glDepthRange(0.0f, 1.0f);
+
+    // Fraction of the y range left free above and below the curve.
+    constexpr asl::f64 y_margin = 0.05;
+
+    // Longest wait for new samples before looking again.
+    constexpr asl::f64 poll_interval = 1.0 / 60.0;
+
+    streaming::SampleRing ring(capacity, GraphPoint::Color{ 0, 0, 255, 255 });
+
+    PlotRenderer2D<def_tag> rend{static_cast<asl::i32>(ring.buffer_size())};
+
+    const grid::GridOptions grid_options;
+    std::vector<GraphPoint> axis;
+    PlotRenderer2D<def_tag> axis_rend{1};
+
+    using VertexShader = tewi::Shader<def_tag, tewi::VertexShader, tewi::ShaderFromMemoryPolicy>;
+    using FragmentShader = tewi::Shader<def_tag, tewi::FragmentShader, tewi::ShaderFromMemoryPolicy>;
+
+    VertexShader vert(tewi::API::Device<def_tag>{}, g_vertsrc);
+    FragmentShader frag(tewi::API::Device<def_tag>{}, g_fragsrc);
+
+    tewi::ShaderProgram<def_tag> shader(g_vertlocations, vert, frag);
+
+    const auto mvp_location = shader.getUniformLocation("MVP");
+    const auto point_size_location = shader.getUniformLocation("pointSize");
+    const auto scale_location = shader.getUniformLocation("scale");
+
+    stats::CpuMeter session_meter;
+    asl::mut_u64 frames = 0;
+
+    session_meter.start();
+
+    // Frames are drawn when samples came in. Once the input has ended,
+    // the loop sleeps until a window event, and draws one frame for it.
+    bool woken = false;
+
+    while (!tewi::isWindowClosed(win))
+    {
+        tewi::pollWindowEvents(win);
+
+        if (inputManager.isKeyDown(GLFW_KEY_ESCAPE))
+        {
+            tewi::forceCloseWindow(win);
+        }
+
+        streaming::Sample sample;
+        bool received = false;
+
+        while (reader.pop(sample))
+        {
+            ring.push(sample.t, sample.v);
+            received = true;
+        }
+
+        if (!received && !woken && frames > 0)
+        {
+            woken = reader.done();
+
+            if (woken)
+            {
+                glfwWaitEvents();
+            }
+            else
+            {
+                glfwWaitEventsTimeout(poll_interval);
+            }
+
+            continue;
+        }
+
+        woken = false;
+
+        ring.flush([&] (asl::i32 offset, const GraphPoint* data, asl::i32 count) {
+            rend.update(offset, data, count);
+        });
+
+        ++frames;
+
+        asl::mut_f32 x_from = ring.first_x();
+        asl::mut_f32 x_to = ring.last_x();
+
+        if (x_to <= x_from)
+        {
+            x_to = x_from + 1.0f;
+        }
+
+        asl::mut_f64 y_from = ring.min();
+        asl::mut_f64 y_to = ring.max();
+
+        if (y_to <= y_from)
+        {
+            y_from -= 1.0;
+            y_to += 1.0;
+        }
+
+        const asl::f64 margin = (y_to - y_from) * y_margin;
+
+        y_from -= margin;
+        y_to += margin;
+
+        const auto MVP = glm::ortho(x_from, x_to, static_cast<float>(y_from), static_cast<float>(y_to));
+
+        // Time is labelled from the first sample.
+        grid::build_grid(grid::Viewport { x_from, x_to, y_from, y_to,
+                                          1280.0 / (x_to - x_from), 720.0 / (y_to - y_from) },
+                         grid_options, axis);
+
+        const auto axis_count = static_cast<asl::i32>(axis.size());
+
+        axis_rend.reserve(axis_count);
+        axis_rend.update(0, axis.data(), axis_count);
+        axis_rend.resize(axis_count);
+
+        win.context.preDraw();
+
+        shader.enable();
+
+        tewi::setUniform(mvp_location, MVP);
+        tewi::setUniform(point_size_location, 1.0f);
+        tewi::setUniform(scale_location, 1.0f);
+
+        axis_rend.begin();
+        axis_rend.end();
+        axis_rend.draw(GL_LINES);
+
+        rend.begin();
+        rend.end();
+        rend.draw_strips(GL_LINE_STRIP, ring.segments());
+
+        shader.disable();
+
+        win.context.postDraw();
+
+        tewi::swapWindowBuffers(win);
+    }
+
+    session_meter.stop();
+
+    std::cout << "Samples received: " << reader.received()
+              << " (" << reader.rejected() << " lines rejected) in "
+              << session_meter.wall_seconds() << " s, "
+              << reader.received() / std::max(session_meter.wall_seconds(), 1e-9) << " samples/s\n"
+              << "Frames drawn: " << frames << '\n';
+}
+
+// Plots a sample file (see samplefile) as it is on disk. The file is
+// mapped, and y-only files are drawn with their y column as the vertex
+// source of a compact curve, with no parsing or conversion on the CPU;
+// files with an x column become a curve of points.
+void start_file_plot(const std::string& path)
+{
+    using def_tag = tewi::API::OpenGLTag;
+
+    const samplefile::MappedSamples file(path);
+
+    if (!file.valid())
+    {
+        std::cerr << file.error() << '\n';
+        return;
+    }
+
+    std::cout << "y = " << file.expression() << " on [" << file.lower() << ", " << file.upper()
+              << "]: " << file.size() << " samples\n";
+
+    // Fraction of the y range left free above and below the curve.
+    constexpr asl::f64 y_margin = 0.05;
+
+    const GraphPoint::Color color { 0, 0, 255, 255 };
+
+    asl::mut_f64 x_from = file.lower();
+    asl::mut_f64 x_to = file.upper();
+    asl::mut_f64 y_from = std::numeric_limits<double>::infinity();
+    asl::mut_f64 y_to = -std::numeric_limits<double>::infinity();
+
+    for (std::size_t i = 0; i < file.size(); ++i)
+    {
+        const asl::f64 y = file.y(i);
+
+        if (std::isfinite(y))
+        {
+            y_from = std::min(y_from, y);
+            y_to = std::max(y_to, y);
+        }
+    }
+
+    if (!(y_to > y_from))
+    {
+        y_from = std::isfinite(y_from) ? y_from - 1.0 : -1.0;
+        y_to = y_from + 2.0;
+    }
+
+    if (x_to <= x_from)
+    {
+        x_to = x_from + 1.0;
+    }
+
+    const asl::f64 margin = (y_to - y_from) * y_margin;
+
+    y_from -= margin;
+    y_to += margin;
+
+    tewi::InputManager inputManager;
+
+    tewi::Window<def_tag> win("Samples", tewi::Width{1280}, tewi::Height{720}, &inputManager);
+
+    tewi::setWindowKeyboardCallback(win,
+                                    [] (GLFWwindow* win, int key,
+                                        int scancode, int action, int mods)
+    {
+        auto& inputMan = *(static_cast<tewi::InputManager*>(glfwGetWindowUserPointer(win)));
+
+        if (action == GLFW_PRESS)
+        {
+            inputMan.pressKey(key);
+        }
+        else if (action == GLFW_RELEASE)
+        {
+            inputMan.releaseKey(key);
+        }
+    });
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LEQUAL);
+    glDepthRange(0.0f, 1.0f);
+
+    std::vector<GraphPoint> axis;
+    grid::build_grid(grid::Viewport { x_from, x_to, y_from, y_to,
+                                      1280.0 / (x_to - x_from), 720.0 / (y_to - y_from) },
+                     grid::GridOptions{}, axis);
+
+    PlotRenderer2D<def_tag> axis_rend{axis};
+
+    // One of the two is used, depending on the layout of the file.
+    std::unique_ptr<CompactRenderer2D<def_tag>> compact_rend;
+    std::unique_ptr<PlotRenderer2D<def_tag>> points_rend;
+    StripList strips;
+
+    if (file.uniform())
+    {
+        const auto view = file.view(color);
+
+        view.finite_strips(strips);
+        compact_rend = std::make_unique<CompactRenderer2D<def_tag>>(view);
+    }
+    else
+    {
+        Curve curve;
+        curve.vertices.resize(file.size());
+
+        for (std::size_t i = 0; i < file.size(); ++i)
+        {
+            GraphPoint& p = curve.vertices[i];
+            p.pos = glm::vec2(file.x(i), file.y(i));
+            p.color = color;
+        }
+
+        for (std::size_t i = 0; i < file.size(); ++i)
+        {
+            if (!std::isfinite(curve.vertices[i].pos.y))
+            {
+                continue;
+            }
+
+            if (i == 0 || !std::isfinite(curve.vertices[i - 1].pos.y))
+            {
+                strips.push_back(static_cast<asl::mut_i32>(i), 0);
+            }
+
+            ++strips.count.back();
+        }
+
+        points_rend = std::make_unique<PlotRenderer2D<def_tag>>(curve.vertices);
+    }
+
+    using VertexShader = tewi::Shader<def_tag, tewi::VertexShader, tewi::ShaderFromMemoryPolicy>;
+    using FragmentShader = tewi::Shader<def_tag, tewi::FragmentShader, tewi::ShaderFromMemoryPolicy>;
+
+    VertexShader vert(tewi::API::Device<def_tag>{}, g_vertsrc);
+    FragmentShader frag(tewi::API::Device<def_tag>{}, g_fragsrc);
+
+    tewi::ShaderProgram<def_tag> shader(g_vertlocations, vert, frag);
+
+    const auto mvp_location = shader.getUniformLocation("MVP");
+    const auto point_size_location = shader.getUniformLocation("pointSize");
+    const auto scale_location = shader.getUniformLocation("scale");
+    const auto compact_locations = CompactRenderer2D<def_tag>::locate(shader);
+
+    const auto MVP = glm::ortho(static_cast<float>(x_from), static_cast<float>(x_to),
+                                static_cast<float>(y_from), static_cast<float>(y_to));
+
+    // The view does not change: a frame is drawn for each window event.
+    while (!tewi::isWindowClosed(win))
+    {
+        tewi::pollWindowEvents(win);
+
+        if (inputManager.isKeyDown(GLFW_KEY_ESCAPE))
+        {
+            tewi::forceCloseWindow(win);
+        }
+
+        win.context.preDraw();
+
+        shader.enable();
+
+        tewi::setUniform(mvp_location, MVP);
+        tewi::setUniform(point_size_location, 1.0f);
+        tewi::setUniform(scale_location, 1.0f);
+
+        axis_rend.begin();
+        axis_rend.end();
+        axis_rend.draw(GL_LINES);
+
+        if (compact_rend)
+        {
+            compact_rend->draw_strips(compact_locations, GL_LINE_STRIP, strips);
+        }
+        else
+        {
+            points_rend->begin();
+            points_rend->end();
+            points_rend->draw_strips(GL_LINE_STRIP, strips);
+        }
+
+        shader.disable();
+
+        win.context.postDraw();
+
+        tewi::swapWindowBuffers(win);
+
+        glfwWaitEvents();
+    }
+}
+
+std::atomic<bool> g_stop_serving{false};
+
+// Serves evaluation requests on the socket at `path` until SIGINT or
+// SIGTERM (see service::Server).
+int serve(const std::string& path)
+{
+    service::Server server(path);
+
+    if (!server.valid())
+    {
+        std::cerr << "Cannot listen on " << path << '\n';
+        return 1;
+    }
+
+    const auto stop = [] (int) { g_stop_serving = true; };
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    std::cerr << "Listening on " << path << '\n';
+
+    server.run(g_stop_serving);
+
+    const auto& stats = server.stats();
+
+    std::cerr << stats.requests << " requests (" << stats.rejected << " rejected, "
+              << stats.batched << " evaluated in batches) from " << stats.connections
+              << " connections; " << server.programs().misses() << " expressions compiled\n";
+
+    return 0;
+}
+
+// Integrates one job ("expression; lower; upper; divisions") on a running
+// server, and prints it like batch::run, numbers in full.
+int query(const std::string& path, const std::string& line)
+{
+    batch::Job job;
+
+    if (!batch::parse_job(line, job))
+    {
+        std::cerr << "Expected \"expression; lower; upper; divisions\"\n";
+        return 1;
+    }
+
+    service::Client client(path);
+    integration::Areas areas;
+
+    if (!client.valid() || !client.integrate(job.expression, job.lower, job.upper, job.divisions, areas))
+    {
+        std::cerr << "No answer from " << path << '\n';
+        return 1;
+    }
+
+    batch::Writer out(STDOUT_FILENO);
+
+    out.put(job.expression).put('\t')
+       .put_number(job.lower).put('\t')
+       .put_number(job.upper).put('\t')
+       .put_number(job.divisions).put('\t')
+       .put_number(areas.rectangles).put('\t')
+       .put_number(areas.trapezoids).put('\n');
+
+    return out.flush() ? 0 : 1;
+}
+
+// Prints the --stats summary and writes the --trace file however main
+// returns.
+struct InstrumentReport
+{
+    bool stats = false;
+    std::string trace_path;
+
+    ~InstrumentReport()
+    {
+        if (stats)
+        {
+            instrument::write_stats(std::cerr);
+        }
+
+        if (trace_path.empty())
+        {
+            return;
+        }
+
+        if (!instrument::enabled)
+        {
+            std::cerr << "No trace written: instrumentation is not built in\n";
+        }
+        else if (instrument::write_trace(trace_path))
+        {
+            std::cerr << "Trace written to " << trace_path << '\n';
+        }
+        else
+        {
+            std::cerr << "Cannot write " << trace_path << '\n';
+        }
+    }
+};
+
+int main(int argc, char** argv)
+{
+    // --render <file.png|file.ppm> draws the plot into an image instead of
+    // asking to open a window; --size <w> <h> and --scale <s> set the view.
+    // --overlay <file> adds the expressions in the file, one per line, to
+    // the plot. --stream [file] plots samples read from the file, or from
+    // stdin for "-", as they arrive; --stream-capacity <n> sets how many
+    // are kept. --implicit <expr> adds the curve expr(x, y) = 0,
+    // --parametric <x(t)> <y(t)> <from> <to> and --polar <r(t)> <from> <to>
+    // add curves over t in [from, to]; all three can be given more than
+    // once. --batch <file|-> and --job "<expr>; <a>; <b>; <n>[; <out>]"
+    // run jobs without any prompt or window (see batch::run);
+    // --render-batch <file|-> and --render-job "<expr>; <a>; <b>; <n>;
+    // <image>" render one image per job instead (see render_jobs).
+    // --export <file> writes the session samples to a sample file, and
+    // --open <file> plots one in a window (see samplefile). --csv <file>
+    // adds measured "x, y" samples to the plot (see csv::import).
+    // --serve <socket> answers requests from other processes until
+    // interrupted, and --query <socket> "<expr>; <a>; <b>; <n>" sends one.
+    // --stats prints counters and timings on stderr at exit, and --trace
+    // <file> writes a Chrome trace of the run (see instrument).
+    std::string render_path;
+    std::string overlay_path;
+    asl::mut_i32 render_width = 1280;
+    asl::mut_i32 render_height = 720;
+    asl::mut_f32 render_scale = 10.0f;
+    bool stream = false;
+    std::string stream_path = "-";
+    std::size_t stream_capacity = 1 << 20;
+    std::vector<bytecode::Program> implicits;
+    std::vector<Path> paths;
+    std::string batch_file;
+    std::vector<std::string> batch_jobs;
+    std::string render_file;
+    std::vector<std::string> render_job_lines;
+    std::string export_path;
+    std::string open_path;
+    std::string csv_path;
+    std::string serve_path;
+    std::string query_path;
+    std::string query_job;
+
+    instrument::name_thread("main");
+    InstrumentReport report;
+
+    for (asl::mut_num i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+
+        if (arg == "--render" && i + 1 < argc)
+        {
+            render_path = argv[++i];
+        }
+        else if (arg == "--size" && i + 2 < argc)
+        {
+            if (!parse_argument(arg, argv[++i], render_width) || !parse_argument(arg, argv[++i], render_height))
+            {
+                return 1;
+            }
+        }
+        else if (arg == "--scale" && i + 1 < argc)
+        {
+            if (!parse_argument(arg, argv[++i], render_scale))
+            {
+                return 1;
+            }
+        }
+        else if (arg == "--overlay" && i + 1 < argc)
+        {
+            overlay_path = argv[++i];
+        }
+        else if (arg == "--stream")
+        {
+            stream = true;
+
+            if (i + 1 < argc && (argv[i + 1][0] != '-' || argv[i + 1][1] == '\0'))
+            {
+                stream_path = argv[++i];
+            }
+        }
+        else if (arg == "--implicit" && i + 1 < argc)
+        {
+            const auto f = compile_expression(argv[++i]);
+
+            if (!f.valid())
+            {
+                return 1;
+            }
+
+            implicits.emplace_back(*f.ast);
+        }
+        else if (arg == "--parametric" && i + 4 < argc)
+        {
+            const auto x = compile_expression(argv[++i]);
+            const auto y = compile_expression(argv[++i]);
+            asl::mut_f64 from = 0.0;
+            asl::mut_f64 to = 0.0;
+
+            if (!x.valid() || !y.valid() ||
+                !parse_argument(arg, argv[++i], from) || !parse_argument(arg, argv[++i], to))
+            {
+                return 1;
+            }
+
+            paths.push_back({ bytecode::Program::parametric(*x.ast, *y.ast), from, to });
+        }
+        else if (arg == "--polar" && i + 3 < argc)
+        {
+            const auto r = compile_expression(argv[++i]);
+            asl::mut_f64 from = 0.0;
+            asl::mut_f64 to = 0.0;
+
+            if (!r.valid() || !parse_argument(arg, argv[++i], from) || !parse_argument(arg, argv[++i], to))
+            {
+                return 1;
+            }
+
+            paths.push_back({ bytecode::Program::polar(*r.ast), from, to });
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batch_file = argv[++i];
+        }
+        else if (arg == "--job" && i + 1 < argc)
+        {
+            batch_jobs.push_back(argv[++i]);
+        }
+        else if (arg == "--render-batch" && i + 1 < argc)
+        {
+            render_file = argv[++i];
+        }
+        else if (arg == "--render-job" && i + 1 < argc)
+        {
+            render_job_lines.push_back(argv[++i]);
+        }
+        else if (arg == "--export" && i + 1 < argc)
+        {
+            export_path = argv[++i];
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+        {
+            serve_path = argv[++i];
+        }
+        else if (arg == "--query" && i + 2 < argc)
+        {
+            query_path = argv[++i];
+            query_job = argv[++i];
+        }
+        else if (arg == "--csv" && i + 1 < argc)
+        {
+            csv_path = argv[++i];
+        }
+        else if (arg == "--open" && i + 1 < argc)
+        {
+            open_path = argv[++i];
+        }
+        else if (arg == "--stats")
+        {
+            report.stats = true;
+        }
+        else if (arg == "--trace" && i + 1 < argc)
+        {
+            report.trace_path = argv[++i];
+            instrument::start_trace();
+        }
+        else if (arg == "--stream-capacity" && i + 1 < argc)
+        {
+            if (!parse_argument(arg, argv[++i], stream_capacity))
+            {
+                return 1;
+            }
+        }
+    }
+
+    if (!serve_path.empty())
+    {
+        return serve(serve_path);
+    }
+
+    if (!query_path.empty())
+    {
+        return query(query_path, query_job);
+    }
+
+    if (!batch_file.empty() || !batch_jobs.empty())
+    {
+        const auto stats = batch::run(batch_jobs, batch_file);
+
+        std::cerr << stats.jobs << " jobs (" << stats.failed << " failed), "
+                  << stats.samples << " samples, " << stats.bytes << " bytes written in "
+                  << stats.seconds << " s\n";
+
+        return (stats.failed == 0) ? 0 : 1;
+    }
+
+    if (!render_file.empty() || !render_job_lines.empty())
+    {
+        return render_jobs(render_job_lines, render_file, render_width, render_height, render_scale);
+    }
+
+    if (!open_path.empty())
+    {
+        start_file_plot(open_path);
+        return 0;
+    }
+
+    if (stream)
+    {
+        start_stream(stream_path, stream_capacity);
+        return 0;
+    }
+
+    std::vector<Expression> overlay_expressions;
+
+    if (!overlay_path.empty())
+    {
+        std::ifstream file(overlay_path);
+
+        if (!file)
+        {
+            std::cerr << "Cannot read " << overlay_path << '\n';
+            return 1;
+        }
+
+        for (std::string line; std::getline(file, line); )
+        {
+            if (!line.empty() && line[0] != '#')
+            {
+                overlay_expressions.push_back(compile_expression(line));
+
+                if (!overlay_expressions.back().valid())
+                {
+                    return 1;
+                }
+            }
+        }
+    }
+
+    std::vector<overlay::Function> overlays;
+
+    for (const auto& expr : overlay_expressions)
+    {
+        overlays.push_back(expr.fun);
+    }
+
+    std::cout << "y = ";
+    std::string str;
+    std::getline(std::cin, str);
+
+    const auto expression = compile_expression(str);
+    const auto& fun = expression.fun;
+
+    if (!expression.valid())
+    {
+        return 1;
+    }
+
+    double divisions = 0.0;
+    double a = 0.0;
+    double b = 0.0;
+
+    std::cout << "For f(x) = " << str << ":\n";
+    std::cout << "Lower limit: ";
+    std::cin >> a;
+    std::cout << "Upper limit: ";
+    std::cin >> b;
+    std::cout << "Number of divisions: ";
+    std::cin >> divisions;
+
+    // The areas are streamed, so only time limits the divisions.
+    constexpr double max_divisions = 1e12;
+
+    if (!std::cin || !std::isfinite(a) || !std::isfinite(b) || a == b)
+    {
+        std::cerr << "The limits must be two different finite numbers\n";
+        return 1;
+    }
+
+    if (!(divisions >= 1.0 && divisions <= max_divisions))
+    {
+        std::cerr << "The number of divisions must be between 1 and " << max_divisions << '\n';
+        return 1;
+    }
+
+    std::atomic<std::size_t> evaluations{0};
+    auto counted_fun = sampling::counted(fun, evaluations);
+
+    // One pass: the areas at full resolution, f and F at a bounded
+    // resolution for the analysis and the plot.
+    const auto sweep = integration::sweep(counted_fun, a, b, static_cast<std::size_t>(divisions));
+    const auto& integral = sweep.integral;
+    const auto& samples = sweep.samples;
+
+    std::cout << '\n';
+    std::cout << "Area calcolata col metodo dei rettangoli: "
+              << sweep.areas.rectangles << '\n';
+
+    std::cout << "Area calcolata col metodo dei trapezi: "
+              << sweep.areas.trapezoids << '\n';
+
+    const auto points = analysis::find_critical_points(
+        counted_fun, samples.lower(), samples.step(), samples.values());
+
+    std::cout << '\n';
+
+    for (auto root : points.roots)
+    {
+        std::cout << "Root: x = " << root << '\n';
+    }
+
+    for (const auto& ext : points.extrema)
+    {
+        const bool is_max = ext.kind == analysis::Extremum::Kind::Maximum;
+
+        std::cout << (is_max ? "Local maximum" : "Local minimum")
+                  << ": f(" << ext.x << ") = " << ext.y << '\n';
+    }
+
+    double total_abs_area = 0.0;
+
+    for (const auto& lobe : integration::lobe_areas(integral, points.roots))
+    {
+        std::cout << "Area on [" << lobe.from << ", " << lobe.to << "]: "
+                  << lobe.signed_area << " (absolute: " << lobe.abs_area << ")\n";
+
+        total_abs_area += lobe.abs_area;
+    }
+
+    std::cout << "Total absolute area: " << total_abs_area << '\n';
+    std::cout << "Function evaluations: " << evaluations << "\n\n";
+
+    if (!export_path.empty())
+    {
+        const samplefile::Info info { str, samples.lower(), samples.upper(), samples.step() };
+
+        if (!samplefile::write(export_path, info, nullptr, samples.values().data(), samples.size()))
+        {
+            std::cerr << "Cannot write " << export_path << '\n';
+            return 1;
+        }
+
+        std::cout << "Samples written to " << export_path << "\n\n";
+    }
+
+    constexpr std::size_t path_divisions = 1 << 20;
+
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        const auto& p = paths[i];
+
+        std::cout << "Curve " << i + 1 << " on [" << p.from << ", " << p.to << "]: length "
+                  << integration::arc_length(p.program, p.from, p.to, path_divisions)
+                  << ", enclosed area "
+                  << std::abs(integration::enclosed_area(p.program, p.from, p.to, path_divisions))
+                  << '\n';
+    }
+
+    const auto path_curves = sample_paths(paths, overlays.size() + implicits.size());
+
+    csv::Imported measured;
+
+    if (!csv_path.empty())
+    {
+        csv::ImportOptions options;
+        options.integrate = true;
+
+        if (!csv::import(csv_path, options, measured))
+        {
+            std::cerr << "Cannot read " << csv_path << '\n';
+            return 1;
+        }
+
+        const auto& st = measured.stats;
+
+        std::cout << "Imported " << st.samples << " samples from " << csv_path << " ("
+                  << st.rejected << " lines rejected): " << st.bytes / 1e6 << " MB in "
+                  << st.seconds << " s, " << st.mb_per_second() << " MB/s, "
+                  << st.vertex_bytes / 1e6 << " MB of vertices\n"
+                  << "Area of the imported samples (trapezoids): " << measured.area << "\n\n";
+    }
+
+    if (!render_path.empty())
+    {
+        if (!render_plot(counted_fun, samples, integral, overlays, implicits, path_curves, measured.curve, render_path,
+                         render_width, render_height, render_scale))
+        {
+            std::cerr << "Cannot write " << render_path << '\n';
+            return 1;
+        }
+
+        std::cout << "Plot written to " << render_path << '\n';
+        return 0;
+    }
+
+    std::cout << "Do you want to see the function plot? [Y/N]: ";
+    char res = '\0';
+
+    std::cin >> res;
+    if (res == 'y' || res == 'Y')
+    {
+        start_plot(counted_fun, samples, integral, overlays, implicits, path_curves, measured.curve);
+
+        std::cout << "Function evaluations: " << evaluations << '\n';
     }
 }
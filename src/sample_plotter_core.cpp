@@ -0,0 +1,172 @@
+#define SP_BUILDING_CORE
+
+#include "sample_plotter.h"
+
+#include <new>
+#include <string>
+#include <utility>
+
+#include "integration.hpp"
+#include "program.hpp"
+
+struct sp_program
+{
+    bytecode::Program program;
+};
+
+extern "C"
+{
+
+int sp_abi_version(void)
+{
+    return SP_ABI_VERSION;
+}
+
+const char* sp_status_string(sp_status status)
+{
+    switch (status)
+    {
+    case SP_OK:               return "ok";
+    case SP_INVALID_ARGUMENT: return "invalid argument";
+    case SP_OUT_OF_MEMORY:    return "out of memory";
+    case SP_INTERNAL_ERROR:   return "internal error";
+    }
+
+    return "unknown status";
+}
+
+sp_status sp_compile(const char* expression, size_t length, sp_program** out)
+{
+    if (out == nullptr || (expression == nullptr && length > 0))
+    {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    *out = nullptr;
+
+    try
+    {
+        auto program = bytecode::compile(std::string(expression, length));
+
+        if (!program.valid())
+        {
+            return SP_INVALID_ARGUMENT;
+        }
+
+        *out = new sp_program { std::move(program) };
+        return SP_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SP_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return SP_INTERNAL_ERROR;
+    }
+}
+
+void sp_program_free(sp_program* program)
+{
+    delete program;
+}
+
+size_t sp_program_size(const sp_program* program)
+{
+    return (program != nullptr) ? program->program.size() : 0;
+}
+
+sp_status sp_evaluate(const sp_program* program, const double* x, double* out, size_t count)
+{
+    if (program == nullptr || (count > 0 && (x == nullptr || out == nullptr)))
+    {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        program->program.evaluate(x, nullptr, out, count);
+        return SP_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SP_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return SP_INTERNAL_ERROR;
+    }
+}
+
+sp_status sp_evaluate_grid(const sp_program* program, double from, double step,
+                           double* out, size_t count)
+{
+    if (program == nullptr || (count > 0 && out == nullptr))
+    {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        program->program.evaluate_grid(from, step, count, out);
+        return SP_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SP_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return SP_INTERNAL_ERROR;
+    }
+}
+
+sp_status sp_integrate(const sp_program* program, double lower, double upper,
+                       uint64_t divisions, unsigned threads,
+                       double* rectangles, double* trapezoids)
+{
+    if (program == nullptr || divisions == 0 || threads == 0)
+    {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        const auto n = static_cast<std::size_t>(divisions);
+        const double step = (upper - lower) / n;
+
+        integration::Areas areas;
+
+        if (threads == 1)
+        {
+            areas = integration::area_sums(program->program, lower, step, 0, n);
+            areas = integration::Areas { areas.rectangles * step, areas.trapezoids * 0.5 * step };
+        }
+        else
+        {
+            areas = integration::program_area(program->program, lower, upper, n, threads);
+        }
+
+        if (rectangles != nullptr)
+        {
+            *rectangles = areas.rectangles;
+        }
+
+        if (trapezoids != nullptr)
+        {
+            *trapezoids = areas.trapezoids;
+        }
+
+        return SP_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SP_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return SP_INTERNAL_ERROR;
+    }
+}
+
+}
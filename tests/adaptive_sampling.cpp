@@ -0,0 +1,145 @@
+// Adaptive sampling in screen space: straight stretches stay coarse,
+// curved ones are refined until every segment is within the tolerance at
+// its midpoint, and poles and undefined stretches cut the strip.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "adaptive.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    sampling::AdaptiveOptions options()
+    {
+        sampling::AdaptiveOptions opt;
+        opt.pixels_per_unit = 100.0;
+        opt.tolerance = 0.5;
+        opt.min_depth = 0;
+        opt.max_depth = 16;
+
+        return opt;
+    }
+
+    template <typename F>
+    Curve sample(F&& fun, double from, double to, const sampling::AdaptiveOptions& opt = options())
+    {
+        Curve curve;
+        sampling::sample_adaptive(fun, { { from, fun(from) }, { to, fun(to) } }, opt, curve);
+
+        return curve;
+    }
+
+    void line()
+    {
+        const Curve curve = sample([] (double x) { return 2.0 * x + 1.0; }, -5.0, 5.0);
+
+        check(curve.vertices.size() == 2, "a line is drawn from its endpoints");
+        check(curve.strips.size() == 1 && curve.strips.count[0] == 2, "a line is one strip");
+    }
+
+    void within_tolerance()
+    {
+        const auto f = [] (double x) { return std::sin(x); };
+        const auto opt = options();
+        const Curve curve = sample(f, 0.0, 10.0, opt);
+
+        check(curve.strips.size() == 1, "sin is one strip");
+        check(curve.vertices.size() < 1000, "sin needs far fewer points than a uniform grid");
+
+        double worst = 0.0;
+
+        for (std::size_t i = 1; i < curve.vertices.size(); ++i)
+        {
+            const auto& a = curve.vertices[i - 1].pos;
+            const auto& b = curve.vertices[i].pos;
+
+            const double xm = (a.x + b.x) / 2.0;
+            const sampling::SamplePoint m { xm, f(xm) };
+
+            worst = std::max(worst, sampling::detail::screen_deviation(
+                { a.x, a.y }, m, { b.x, b.y }, opt.pixels_per_unit));
+        }
+
+        // The vertices are floats.
+        check(worst <= opt.tolerance + 1e-3, "every segment is within the tolerance at its midpoint");
+
+        bool increasing = true;
+
+        for (std::size_t i = 1; i < curve.vertices.size(); ++i)
+        {
+            increasing = increasing && curve.vertices[i].pos.x > curve.vertices[i - 1].pos.x;
+        }
+
+        check(increasing, "the vertices are in order of x");
+    }
+
+    void bounded_by_depth()
+    {
+        auto opt = options();
+        opt.tolerance = 1e-9;
+        opt.max_depth = 6;
+
+        const Curve curve = sample([] (double x) { return std::sin(50.0 * x); }, 0.0, 1.0, opt);
+
+        check(curve.vertices.size() <= sampling::max_vertices(opt.max_depth),
+              "refinement stops at the maximum depth");
+    }
+
+    void pole()
+    {
+        const Curve curve = sample([] (double x) { return 1.0 / x; }, -1.0, 1.3);
+
+        check(curve.strips.size() == 2, "a pole cuts the curve in two strips");
+
+        bool crosses = false;
+
+        for (std::size_t s = 0; s < curve.strips.size(); ++s)
+        {
+            const auto first = curve.strips.first[s];
+            const auto last = first + curve.strips.count[s] - 1;
+
+            crosses = crosses || (curve.vertices[first].pos.x < 0.0f && curve.vertices[last].pos.x > 0.0f);
+        }
+
+        check(!crosses, "no strip is drawn across the pole");
+    }
+
+    void undefined()
+    {
+        const Curve curve = sample([] (double x) { return std::sqrt(x); }, -1.0, 1.0);
+
+        bool finite = true;
+
+        for (const auto& v : curve.vertices)
+        {
+            finite = finite && std::isfinite(v.pos.y) && v.pos.x >= 0.0f;
+        }
+
+        check(!curve.vertices.empty() && finite, "only the defined stretch is drawn");
+        check(curve.strips.size() == 1, "the defined stretch is one strip");
+    }
+}
+
+int main()
+{
+    line();
+    within_tolerance();
+    bounded_by_depth();
+    pole();
+    undefined();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// Axes and grid generated from the viewport: steps of 1, 2 or 5 times a
+// power of ten, labels with the decimals the step needs, and a vertex
+// count that depends on the window, not on where or how deep the view is.
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "axis_grid.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    bool close(double a, double b)
+    {
+        return std::abs(a - b) <= 1e-12 * std::abs(b);
+    }
+
+    void nice_steps()
+    {
+        check(close(grid::nice_step(1.0), 1.0), "1 is a nice step");
+        check(close(grid::nice_step(1.5), 2.0), "1.5 rounds up to 2");
+        check(close(grid::nice_step(0.3), 0.5), "0.3 rounds up to 0.5");
+        check(close(grid::nice_step(7.0), 10.0), "7 rounds up to 10");
+        check(close(grid::nice_step(0.012), 0.02), "0.012 rounds up to 0.02");
+        check(close(grid::nice_step(4e7), 5e7), "large steps keep their power of ten");
+    }
+
+    std::string label(double value, double step)
+    {
+        char buf[32];
+        const std::size_t n = grid::format_label(value, step, buf);
+
+        return std::string(buf, n);
+    }
+
+    void labels()
+    {
+        check(label(2.0, 1.0) == "2", "whole steps have no decimals");
+        check(label(0.5, 0.1) == "0.5", "tenths have one decimal");
+        check(label(-0.25, 0.05) == "-0.25", "hundredths have two decimals");
+        check(label(3e-17, 0.1) == "0.0", "rounding noise around 0 is 0");
+        check(label(3e6, 1e6) == "3e+06", "large values are in scientific notation");
+        check(label(2e-5, 1e-5) == "2e-05", "small steps are in scientific notation");
+    }
+
+    std::size_t count_color(const std::vector<GraphPoint>& out, GraphPoint::Color color)
+    {
+        std::size_t n = 0;
+
+        for (const auto& p : out)
+        {
+            n += (p.color.r == color.r && p.color.a == color.a) ? 1 : 0;
+        }
+
+        return n;
+    }
+
+    void grid_lines()
+    {
+        const grid::GridOptions opt;
+
+        // 800 x 600 pixels around the origin, 100 pixels per unit.
+        const grid::Viewport home { -4.0, 4.0, -3.0, 3.0, 100.0, 100.0 };
+
+        std::vector<GraphPoint> out;
+        grid::build_grid(home, opt, out);
+
+        check(!out.empty() && out.size() % 2 == 0, "the grid is made of line segments");
+
+        // 1 unit is 100 pixels: lines every unit, -4 .. 4 and -3 .. 3.
+        const std::size_t lines = 9 + 7;
+
+        check(count_color(out, opt.grid_color) == 2 * lines, "grid lines every nice step in view");
+        check(count_color(out, opt.axis_color) == 2 * (2 + lines), "both axes and a tick per line are drawn");
+
+        bool inside = true;
+
+        for (const auto& p : out)
+        {
+            if (p.color.a == opt.grid_color.a)
+            {
+                inside = inside && p.pos.x >= -4.0f && p.pos.x <= 4.0f && p.pos.y >= -3.0f && p.pos.y <= 3.0f;
+            }
+        }
+
+        check(inside, "no grid line is drawn outside the view");
+
+        // The same window zoomed out a million times.
+        const grid::Viewport wide { -4e6, 4e6, -3e6, 3e6, 1e-4, 1e-4 };
+
+        std::vector<GraphPoint> zoomed;
+        grid::build_grid(wide, opt, zoomed);
+
+        check(count_color(zoomed, opt.grid_color) == 2 * lines, "the grid does not grow with the zoom");
+
+        // The same window far from the origin: the axes are out of view
+        // and only leave their ticks along the edges.
+        const grid::Viewport away { 1e6, 1e6 + 8e-4, 5e5, 5e5 + 6e-4, 1e6, 1e6 };
+
+        std::vector<GraphPoint> far;
+        grid::build_grid(away, opt, far);
+
+        const std::size_t far_lines = count_color(far, opt.grid_color) / 2;
+
+        check(far_lines > 0 && far_lines <= lines + 2, "the grid does not grow with the distance");
+        check(count_color(far, opt.axis_color) == 2 * far_lines, "axes out of view are not drawn");
+    }
+}
+
+int main()
+{
+    nice_steps();
+    labels();
+    grid_lines();
+
+    return failures == 0 ? 0 : 1;
+}
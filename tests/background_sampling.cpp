@@ -0,0 +1,236 @@
+// The handoff between the render thread and the sampling worker, without a
+// GL context: the lock-free queue keeps its order and reports full and
+// empty across two threads, and the worker answers requests and honours
+// cancellations.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <cmath>
+
+#include "spsc_queue.hpp"
+#include "sampling_worker.hpp"
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = std::chrono::steady_clock;
+
+    int failures = 0;
+
+    void check(bool ok, const char* what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    void queue_full_and_empty()
+    {
+        concurrency::SpscQueue<int> queue(3);
+        int value = 0;
+
+        check(queue.capacity() == 4, "the capacity is rounded up to a power of two");
+        check(queue.empty() && !queue.try_pop(value), "a new queue is empty");
+
+        for (int i = 0; i < 4; ++i)
+        {
+            check(queue.try_push(i), "a queue takes values up to its capacity");
+        }
+
+        check(!queue.try_push(4), "a full queue refuses a value");
+        check(queue.try_pop(value) && value == 0, "the first value comes out first");
+        check(queue.try_push(4), "a popped slot can be reused");
+
+        for (int i = 1; i <= 4; ++i)
+        {
+            check(queue.try_pop(value) && value == i, "values come out in order across the wrap");
+        }
+
+        check(queue.empty() && !queue.try_pop(value), "a drained queue is empty");
+    }
+
+    void queue_across_threads()
+    {
+        constexpr int count = 1 << 20;
+
+        concurrency::SpscQueue<int> queue(64);
+
+        std::thread producer([&] {
+            for (int i = 0; i < count; ++i)
+            {
+                while (!queue.try_push(i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        int expected = 0;
+        bool ordered = true;
+        int value = 0;
+
+        while (expected < count)
+        {
+            if (!queue.try_pop(value))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            ordered = ordered && value == expected;
+            ++expected;
+        }
+
+        producer.join();
+
+        check(ordered, "every value arrives once and in order");
+        check(queue.empty(), "the queue is empty once the consumer caught up");
+    }
+
+    sampling::AdaptiveOptions options(int max_depth)
+    {
+        sampling::AdaptiveOptions opt;
+        opt.pixels_per_unit = 1e6;
+        opt.tolerance = 1e-3;
+        opt.min_depth = 2;
+        opt.max_depth = max_depth;
+
+        return opt;
+    }
+
+    template <typename Done>
+    void poll_until(sampling::SamplingWorker& worker, Done&& done)
+    {
+        const auto start = Clock::now();
+        sampling::TileBatch batch;
+
+        while (Clock::now() - start < 10s)
+        {
+            if (worker.poll(batch))
+            {
+                if (done(batch))
+                {
+                    return;
+                }
+            }
+            else
+            {
+                std::this_thread::sleep_for(100us);
+            }
+        }
+    }
+
+    void worker_answers_requests()
+    {
+        constexpr int tiles = 8;
+
+        std::atomic<int> published { 0 };
+
+        sampling::SamplingWorker worker(
+            [] (sampling::TileKey key, sampling::ProgressiveSampler& sampler) {
+                sampler.reset([] (double x) { return std::sin(x); }, options(8),
+                              key.index, key.index + 1.0);
+            },
+            1ms);
+
+        worker.on_publish([&published] { published.fetch_add(1); });
+
+        for (int i = 0; i < tiles; ++i)
+        {
+            check(worker.request({ 0, i }), "the request is queued");
+        }
+
+        std::vector<int> finals(tiles, 0);
+        bool spans = true;
+        bool known = true;
+        int batches = 0;
+        int done = 0;
+
+        poll_until(worker, [&] (const sampling::TileBatch& batch) {
+            ++batches;
+
+            if (batch.key.level != 0 || batch.key.index < 0 || batch.key.index >= tiles)
+            {
+                known = false;
+                return true;
+            }
+
+            const auto& v = batch.curve.vertices;
+            spans = spans && !v.empty() &&
+                    v.front().pos.x == static_cast<float>(batch.key.index) &&
+                    v.back().pos.x == static_cast<float>(batch.key.index + 1);
+
+            if (batch.final && ++finals[batch.key.index] == 1)
+            {
+                ++done;
+            }
+
+            return done == tiles;
+        });
+
+        check(known, "batches are only published for requested tiles");
+        check(done == tiles, "every requested tile reaches its final level");
+        check(spans, "every batch spans its whole tile");
+
+        // The callback follows the push, so let the last one run.
+        std::this_thread::sleep_for(20ms);
+
+        check(published.load() == batches, "the callback runs for every batch");
+
+        sampling::TileBatch batch;
+        check(!worker.poll(batch), "nothing follows the final batches");
+    }
+
+    void worker_cancels()
+    {
+        // Deep enough to outlast the test by far if it is not cancelled.
+        sampling::SamplingWorker worker(
+            [] (sampling::TileKey, sampling::ProgressiveSampler& sampler) {
+                sampler.reset([] (double x) { return std::sin(x * x * 1e3); }, options(24), 0.0, 1.0);
+            },
+            1ms);
+
+        check(worker.request({ 0, 0 }), "the request is queued");
+
+        bool first_final = false;
+
+        poll_until(worker, [&] (const sampling::TileBatch& batch) {
+            first_final = batch.final;
+            return true;
+        });
+
+        check(!first_final, "a deep tile starts with a coarse level");
+        check(worker.cancel({ 0, 0 }), "the cancellation is queued");
+
+        // The slice under way may still publish once.
+        std::this_thread::sleep_for(50ms);
+
+        sampling::TileBatch batch;
+        bool final = false;
+
+        while (worker.poll(batch))
+        {
+            final = final || batch.final;
+        }
+
+        std::this_thread::sleep_for(50ms);
+
+        check(!final, "a cancelled tile is not finished");
+        check(!worker.poll(batch), "a cancelled tile publishes nothing more");
+    }
+}
+
+int main()
+{
+    queue_full_and_empty();
+    queue_across_threads();
+    worker_answers_requests();
+    worker_cancels();
+
+    return failures == 0 ? 0 : 1;
+}
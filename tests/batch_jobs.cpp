@@ -0,0 +1,189 @@
+// Batch jobs: parse_job takes whole numbers only, trims its fields and
+// rejects missing or empty ones, numbers written by the Writer read back
+// as the same double, and a job's text output holds every sample.
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <charconv>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "batch.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    std::string temp_path(const char* suffix)
+    {
+        return "/tmp/sample_plotter_test_" + std::to_string(::getpid()) + suffix;
+    }
+
+    void fields()
+    {
+        batch::Job job;
+
+        check(batch::parse_job(" sin(x) ;\t-1.5; 2e1 ; 100 \r", job), "a job with spaces and a CR is read");
+        check(job.expression == "sin(x)" && job.lower == -1.5 && job.upper == 20.0 && job.divisions == 100,
+              "fields are trimmed and parsed");
+        check(job.output.empty(), "the output is optional");
+
+        check(batch::parse_job("x; 0; 1; 10; out.txt ", job) && job.output == "out.txt", "the output is the fifth field");
+        check(batch::parse_job("x; 0; 1; 10", job) && job.output.empty(), "a job without output clears the last one");
+        check(batch::parse_job("x; 0.25; -0.125; 1; -", job) && job.lower == 0.25 && job.upper == -0.125,
+              "limits may be in any order");
+    }
+
+    void malformed()
+    {
+        batch::Job job;
+
+        check(!batch::parse_job("", job), "an empty line is not a job");
+        check(!batch::parse_job("x; 0; 1", job), "a job needs divisions");
+        check(!batch::parse_job(" ; 0; 1; 10", job), "a job needs an expression");
+        check(!batch::parse_job("x; ; 1; 10", job), "an empty limit is rejected");
+        check(!batch::parse_job("x; a; 1; 10", job), "a limit must be a number");
+        check(!batch::parse_job("x; 1x; 1; 10", job), "a limit must be a number to the end");
+        check(!batch::parse_job("x; 0; 1 2; 10", job), "a limit is one number");
+        check(!batch::parse_job("x; 0; 1; abc", job), "divisions must be a number");
+        check(!batch::parse_job("x; 0; 1; 10.5", job), "divisions must be whole");
+        check(!batch::parse_job("x; 0; 1; 0", job), "divisions must be positive");
+        check(!batch::parse_job("x; 0; 1; -10", job), "divisions cannot be negative");
+        check(!batch::parse_job("x; 0; 1; 99999999999999999999999", job), "divisions that overflow are rejected");
+        check(!batch::parse_job("x; 1e999; 1; 10", job), "a limit out of range is rejected");
+    }
+
+    void round_trip()
+    {
+        const std::string path = temp_path(".txt");
+        const std::vector<double> values {
+            0.1, -1.0 / 3.0, 1e-300, 5e-324, std::numeric_limits<double>::max(), 123456789.0, -0.0
+        };
+
+        {
+            const auto out = batch::Writer::open(path);
+            check(out->valid(), "a writer opens a new file");
+
+            for (const double v : values)
+            {
+                out->put_number(v).put('\n');
+            }
+
+            check(out->flush(), "a writer flushes");
+        }
+
+        std::ifstream in(path);
+        std::string line;
+        std::size_t i = 0;
+        bool same = true;
+
+        while (std::getline(in, line) && i < values.size())
+        {
+            double value = 0.0;
+            const auto res = std::from_chars(line.data(), line.data() + line.size(), value);
+
+            same = same && res.ec == std::errc() && res.ptr == line.data() + line.size() &&
+                   value == values[i] && std::signbit(value) == std::signbit(values[i]);
+            ++i;
+        }
+
+        check(same && i == values.size(), "numbers read back as the same double");
+
+        ::unlink(path.c_str());
+    }
+
+    void small_buffer()
+    {
+        const std::string path = temp_path(".small");
+
+        {
+            // Smaller than a number: every put flushes first.
+            batch::Writer out(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644), true, 40);
+
+            for (int i = 0; i < 100; ++i)
+            {
+                out.put_number(i * 0.5).put(' ');
+            }
+
+            out.put(std::string(100, 'z'));
+            check(out.flush() && out.written() > 100, "a small buffer writes through");
+        }
+
+        std::ifstream in(path);
+        std::stringstream text;
+        text << in.rdbuf();
+
+        std::string expected;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            char buf[32];
+            expected.append(buf, std::to_chars(buf, buf + sizeof(buf), i * 0.5).ptr);
+            expected += ' ';
+        }
+
+        expected += std::string(100, 'z');
+
+        check(text.str() == expected, "nothing is lost or reordered through a small buffer");
+
+        ::unlink(path.c_str());
+    }
+
+    void text_output()
+    {
+        const std::string path = temp_path(".samples");
+        const auto stats = batch::run({ "x * x; 1; -1; 8; " + path, "x; 0; 1; 0", "x; 0; 1; 4; /nonexistent/out.txt" }, "");
+
+        check(stats.jobs == 3 && stats.failed == 2, "bad lines and outputs fail their job");
+        check(stats.samples == 9, "the samples of the good job are counted");
+
+        std::ifstream in(path);
+        std::string line;
+        std::size_t count = 0;
+        bool exact = true;
+
+        while (std::getline(in, line))
+        {
+            const auto tab = line.find('\t');
+            double x = 0.0;
+            double y = 0.0;
+
+            exact = exact && tab != std::string::npos &&
+                    std::from_chars(line.data(), line.data() + tab, x).ec == std::errc() &&
+                    std::from_chars(line.data() + tab + 1, line.data() + line.size(), y).ec == std::errc() &&
+                    x == -1.0 + count * 0.25 && y == x * x;
+            ++count;
+        }
+
+        check(count == 9, "one line per sample, from the lower limit up");
+        check(exact, "each line is x and f(x)");
+
+        ::unlink(path.c_str());
+    }
+}
+
+int main()
+{
+    fields();
+    malformed();
+    round_trip();
+    small_buffer();
+    text_output();
+
+    return failures == 0 ? 0 : 1;
+}
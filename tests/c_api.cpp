@@ -0,0 +1,80 @@
+// The C interface, through the shared library: malformed expressions are
+// refused at sp_compile and valid ones evaluate and integrate.
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <iostream>
+
+#include "sample_plotter.h"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    void compile_rejects()
+    {
+        const char* const malformed[] = { "(", "sin(", "|x", "x +", "x )", "1 2" };
+
+        for (const char* text : malformed)
+        {
+            sp_program* program = nullptr;
+            const sp_status status = sp_compile(text, std::strlen(text), &program);
+
+            check(status == SP_INVALID_ARGUMENT, std::string("sp_compile rejects \"") + text + '"');
+            check(program == nullptr, std::string("no program is returned for \"") + text + '"');
+
+            sp_program_free(program);
+        }
+
+        sp_program* program = nullptr;
+        check(sp_compile("x", 1, nullptr) == SP_INVALID_ARGUMENT, "sp_compile needs an output");
+        check(sp_compile(nullptr, 1, &program) == SP_INVALID_ARGUMENT, "sp_compile needs the text");
+    }
+
+    void compile_evaluates()
+    {
+        const char text[] = "x * x";
+        sp_program* program = nullptr;
+
+        check(sp_compile(text, sizeof(text) - 1, &program) == SP_OK && program != nullptr,
+              "sp_compile accepts \"x * x\"");
+
+        if (program == nullptr)
+        {
+            return;
+        }
+
+        const double x[3] = { 1.0, 2.0, 3.0 };
+        double y[3] = {};
+
+        check(sp_evaluate(program, x, y, 3) == SP_OK && y[0] == 1.0 && y[1] == 4.0 && y[2] == 9.0,
+              "sp_evaluate gives x * x");
+
+        double rectangles = 0.0;
+        double trapezoids = 0.0;
+
+        check(sp_integrate(program, 0.0, 1.0, 1000, 1, &rectangles, &trapezoids) == SP_OK &&
+              std::abs(trapezoids - 1.0 / 3.0) < 1e-6,
+              "sp_integrate gives the area under x * x");
+
+        sp_program_free(program);
+    }
+}
+
+int main()
+{
+    compile_rejects();
+    compile_evaluates();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// Compact vertices with implicit x: the 16-bit format is picked only when
+// its rounding stays within the error allowed, vertices are rebuilt from
+// their index as the shader does, and undefined values split the strips.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "compact_curve.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    constexpr GraphPoint::Color color { 10, 20, 30, 255 };
+
+    std::vector<double> samples(std::size_t count, double amplitude)
+    {
+        std::vector<double> ys(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ys[i] = amplitude * std::sin(i * 0.01);
+        }
+
+        return ys;
+    }
+
+    void quantized()
+    {
+        const auto ys = samples(1000, 2.0);
+        const double max_error = 1e-4;
+
+        const auto curve = CompactCurve::from_samples(-1.0, 0.5, ys.data(), ys.size(), color, max_error);
+
+        check(curve.format == CompactCurve::Format::Quantized16, "a small range is quantized");
+        check(curve.bytes() == ys.size() * 2, "a quantized vertex takes two bytes");
+
+        double worst = 0.0;
+
+        for (std::size_t i = 0; i < ys.size(); ++i)
+        {
+            worst = std::max(worst, std::abs(curve.y(i) - ys[i]));
+        }
+
+        // Plus the float arithmetic of the shader.
+        check(worst <= max_error + 1e-6, "quantized values are within the error allowed");
+
+        const GraphPoint v = curve.vertex(10);
+        check(v.pos.x == -1.0f + 10.0f * 0.5f, "x is rebuilt from the index");
+        check(v.color.r == 10 && v.color.b == 30, "the colour is the curve's");
+    }
+
+    void float_fallback()
+    {
+        const auto ys = samples(1000, 1e6);
+        const auto curve = CompactCurve::from_samples(0.0, 1.0, ys.data(), ys.size(), color, 1e-4);
+
+        check(curve.format == CompactCurve::Format::Float, "a range too wide for 16 bits stays float");
+        check(curve.bytes() == ys.size() * 4, "a float vertex takes four bytes");
+        check(curve.y(123) == static_cast<float>(ys[123]), "float values are kept as they are");
+    }
+
+    void constant()
+    {
+        const std::vector<double> ys(16, 3.5);
+        const auto curve = CompactCurve::from_samples(0.0, 1.0, ys.data(), ys.size(), color, 1e-6);
+
+        check(curve.format == CompactCurve::Format::Quantized16 && curve.y(7) == 3.5f,
+              "a constant curve is quantized to its offset");
+    }
+
+    void undefined()
+    {
+        std::vector<double> ys = samples(10, 1.0);
+        ys[0] = std::nan("");
+        ys[4] = INFINITY;
+        ys[5] = std::nan("");
+
+        const auto curve = CompactCurve::from_samples(0.0, 1.0, ys.data(), ys.size(), color, 1e-3);
+
+        check(curve.strips.size() == 2, "undefined values split the strips");
+        check(curve.strips.first[0] == 1 && curve.strips.count[0] == 3, "the first strip runs to the gap");
+        check(curve.strips.first[1] == 6 && curve.strips.count[1] == 4, "the second strip runs to the end");
+
+        StripList clipped;
+        curve.clip_strips(2, 7, clipped);
+
+        check(clipped.size() == 2 && clipped.first[0] == 2 && clipped.count[0] == 2 &&
+              clipped.first[1] == 6 && clipped.count[1] == 2,
+              "strips are clipped to a vertex range");
+
+        const std::vector<double> none(4, std::nan(""));
+        const auto empty = CompactCurve::from_samples(0.0, 1.0, none.data(), none.size(), color, 1e-3);
+
+        check(empty.strips.size() == 0, "a curve with no defined value draws nothing");
+    }
+
+    void double_view()
+    {
+        const std::vector<double> ys { 1.0, std::nan(""), 2.5 };
+
+        CompactView view;
+        view.format = CompactCurve::Format::Double;
+        view.data = ys.data();
+        view.count = ys.size();
+
+        StripList strips;
+        view.finite_strips(strips);
+
+        check(view.bytes() == 3 * sizeof(double) && view.y(2) == 2.5f, "a view reads doubles in place");
+        check(strips.size() == 2, "a view finds its defined runs");
+    }
+}
+
+int main()
+{
+    quantized();
+    float_fallback();
+    constant();
+    undefined();
+    double_view();
+
+    return failures == 0 ? 0 : 1;
+}
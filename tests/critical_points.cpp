@@ -0,0 +1,118 @@
+// The parallel root and extremum finder on functions whose critical points
+// are known: every one is found once, in order, to the tolerance, a sample
+// that is exactly a root is not reported twice and poles are not roots.
+// The lobes between the roots get their areas from the running integral.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "analysis.hpp"
+#include "integration.hpp"
+
+namespace
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    bool close(double a, double b, double tolerance = 1e-8)
+    {
+        return std::abs(a - b) <= tolerance;
+    }
+
+    void brent_converges()
+    {
+        const auto f = [] (double x) { return x * x * x - 2.0; };
+
+        check(close(analysis::brent_root(f, 0.0, 2.0, f(0.0), f(2.0), 1e-12), std::cbrt(2.0), 1e-10),
+              "Brent's method finds the cube root of 2");
+        check(analysis::brent_root(f, std::cbrt(2.0), 2.0, 0.0, f(2.0), 1e-12) == std::cbrt(2.0),
+              "an end that is already a root is returned as it is");
+    }
+
+    void sine()
+    {
+        const auto f = [] (double x) { return std::sin(x); };
+
+        // Every thread gets a few of the critical points.
+        const auto points = analysis::find_critical_points(f, 0.1, 20.0, 2001);
+
+        check(points.roots.size() == 6, "sin has six roots in [0.1, 20]");
+
+        for (std::size_t i = 0; i < points.roots.size(); ++i)
+        {
+            check(close(points.roots[i], (i + 1) * pi), "root " + std::to_string(i + 1) + " of sin");
+        }
+
+        check(points.extrema.size() == 6, "sin has six extrema in [0.1, 20]");
+
+        for (std::size_t i = 0; i < points.extrema.size(); ++i)
+        {
+            const auto& e = points.extrema[i];
+            const bool maximum = i % 2 == 0;
+
+            check(close(e.x, (i + 0.5) * pi, 1e-6) && close(e.y, maximum ? 1.0 : -1.0),
+                  "extremum " + std::to_string(i + 1) + " of sin");
+            check((e.kind == analysis::Extremum::Kind::Maximum) == maximum,
+                  "extremum " + std::to_string(i + 1) + " of sin is of the right kind");
+        }
+    }
+
+    void sample_on_a_root()
+    {
+        // 0 is a sample of the grid.
+        const auto points = analysis::find_critical_points([] (double x) { return x; }, -1.0, 1.0, 201);
+
+        check(points.roots.size() == 1 && points.roots[0] == 0.0, "a root on a sample is reported once");
+        check(points.extrema.empty(), "a line has no extrema");
+    }
+
+    void pole()
+    {
+        // No sample falls on the pole at 0.
+        const auto points = analysis::find_critical_points([] (double x) { return 1.0 / x; }, -1.0, 1.0, 200);
+
+        check(points.roots.empty(), "the sign change across a pole is not a root");
+        check(points.extrema.empty(), "a pole is not an extremum");
+    }
+
+    void lobes()
+    {
+        const auto f = [] (double x) { return std::sin(x); };
+        const integration::CumulativeIntegral integral(f, 0.0, 3 * pi, 30000);
+
+        const auto lobes = integration::lobe_areas(integral, { 2 * pi, pi, -1.0, 4 * pi });
+
+        check(lobes.size() == 3, "the roots inside the range split it in three lobes");
+
+        for (std::size_t i = 0; i < lobes.size(); ++i)
+        {
+            const double sign = (i % 2 == 0) ? 1.0 : -1.0;
+
+            check(close(lobes[i].signed_area, 2.0 * sign, 1e-6) && close(lobes[i].abs_area, 2.0, 1e-6),
+                  "lobe " + std::to_string(i + 1) + " of sin has area 2");
+        }
+    }
+}
+
+int main()
+{
+    brent_converges();
+    sine();
+    sample_on_a_root();
+    pole();
+    lobes();
+
+    return failures == 0 ? 0 : 1;
+}
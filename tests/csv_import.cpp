@@ -0,0 +1,191 @@
+// CSV import: lines with any of the separators are read, comments and
+// blank lines skipped and other text rejected, undefined values split the
+// strips, and the chunks parsed in parallel join into the same vertices,
+// indices and trapezoid integral as one serial pass over the file.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "csv_import.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    std::string temp_path(const char* name)
+    {
+        return "/tmp/sample_plotter_test_" + std::to_string(::getpid()) + name + ".csv";
+    }
+
+    void write_file(const std::string& path, const std::string& text)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << text;
+    }
+
+    void small_file()
+    {
+        const std::string path = temp_path("_small");
+
+        write_file(path,
+                   "# x, y\n"
+                   "x,y\n"
+                   "0, 1\r\n"
+                   "\n"
+                   "1;2\n"
+                   "  2\t3\n"
+                   "3 nan\n"
+                   "4 , 5\n"
+                   "five, 6\n"
+                   "6 7");
+
+        csv::Imported out;
+        csv::ImportOptions opt;
+        opt.integrate = true;
+
+        check(csv::import(path, opt, out), "a file is imported");
+        check(out.stats.samples == 6, "every sample line is read, the last one without a newline");
+        check(out.stats.rejected == 2, "the header and the bad line are rejected");
+
+        const auto& v = out.curve.vertices;
+
+        check(v.size() == 6 && v[0].pos.y == 1.0f && v[2].pos.x == 2.0f && v[5].pos.y == 7.0f,
+              "samples are kept in file order");
+        check(v[1].color.g == opt.color.g && v[1].color.a == opt.color.a, "samples take the import colour");
+
+        check(out.curve.strips.size() == 2, "an undefined value splits the strips");
+        check(out.curve.strips.first[0] == 0 && out.curve.strips.count[0] == 3, "the first strip ends before it");
+        check(out.curve.strips.first[1] == 4 && out.curve.strips.count[1] == 2, "the second starts after it");
+
+        // 0..2, then from 2 straight to 4 over the undefined sample.
+        const double area = (1 + 2) / 2.0 + (2 + 3) / 2.0 + 2 * (3 + 5) / 2.0 + 2 * (5 + 7) / 2.0;
+        check(out.area == area, "the integral spans undefined samples");
+
+        check(out.stats.bytes > 0 && out.stats.vertex_bytes >= 6 * sizeof(GraphPoint), "the sizes are counted");
+
+        ::unlink(path.c_str());
+    }
+
+    // Enough lines that every thread gets a chunk, with some rejected and
+    // some undefined along the way.
+    void large_file(bool indexed)
+    {
+        const std::string path = temp_path(indexed ? "_indexed" : "_large");
+        constexpr std::size_t lines = 200003;
+
+        std::string text;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        std::size_t rejected = 0;
+
+        for (std::size_t i = 0; i < lines; ++i)
+        {
+            if (i % 9973 == 5)
+            {
+                text += "bad\n";
+                ++rejected;
+                continue;
+            }
+
+            if (i % 7919 == 3)
+            {
+                text += "# comment\n";
+                continue;
+            }
+
+            const double x = i * 0.001;
+            const double y = (i % 50021 == 7) ? std::nan("") : std::sin(x) * 100.0;
+
+            if (!indexed)
+            {
+                text += std::to_string(x);
+                text += ',';
+            }
+
+            text += std::isnan(y) ? std::string("nan") : std::to_string(y);
+            text += '\n';
+
+            xs.push_back(indexed ? static_cast<double>(xs.size()) : std::stod(std::to_string(x)));
+            ys.push_back(std::isnan(y) ? y : std::stod(std::to_string(y)));
+        }
+
+        write_file(path, text);
+
+        csv::Imported out;
+        csv::ImportOptions opt;
+        opt.integrate = true;
+
+        check(csv::import(path, opt, out), "a large file is imported");
+        check(out.stats.samples == xs.size() && out.stats.rejected == rejected, "every line is counted once");
+
+        bool same = out.curve.vertices.size() == xs.size();
+
+        for (std::size_t i = 0; same && i < xs.size(); ++i)
+        {
+            const auto p = out.curve.vertices[i].pos;
+            same = p.x == static_cast<float>(xs[i]) && (p.y == static_cast<float>(ys[i]) || std::isnan(ys[i]));
+        }
+
+        check(same, indexed ? "single values get their index as x across chunks" : "chunks join in file order");
+
+        // One serial pass, in double.
+        double area = 0.0;
+        bool have_last = false;
+        double last_x = 0.0;
+        double last_y = 0.0;
+        std::size_t gaps = 0;
+
+        for (std::size_t i = 0; i < xs.size(); ++i)
+        {
+            if (std::isnan(ys[i]))
+            {
+                ++gaps;
+                continue;
+            }
+
+            if (have_last)
+            {
+                area += (xs[i] - last_x) * (last_y + ys[i]) / 2.0;
+            }
+
+            last_x = xs[i];
+            last_y = ys[i];
+            have_last = true;
+        }
+
+        check(std::abs(out.area - area) <= 1e-9 * std::abs(area) + 1e-9, "the integral matches one serial pass");
+        check(out.curve.strips.size() == gaps + 1, "one strip per run of defined values");
+
+        ::unlink(path.c_str());
+    }
+
+    void missing()
+    {
+        csv::Imported out;
+        check(!csv::import(temp_path("_missing"), csv::ImportOptions {}, out), "a missing file is not imported");
+    }
+}
+
+int main()
+{
+    small_file();
+    large_file(false);
+    large_file(true);
+    missing();
+
+    return failures == 0 ? 0 : 1;
+}
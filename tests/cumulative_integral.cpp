@@ -0,0 +1,137 @@
+// The running integral built by the parallel prefix scan must match a
+// serial running sum of the same trapezoids, and the sweep must integrate
+// over exactly the divisions asked for while keeping its table bounded.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "integration.hpp"
+#include "sampling.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    bool close(double a, double b, double tolerance = 1e-9)
+    {
+        return std::abs(a - b) <= tolerance * std::max(1.0, std::abs(b));
+    }
+
+    double f(double x)
+    {
+        return std::sin(3.0 * x) + 0.5 * x;
+    }
+
+    void scan_matches_serial_sum()
+    {
+        // Fewer segments than threads, one per thread and many.
+        for (std::size_t divisions : { 1, 2, 3, 7, 64, 1000, 100003 })
+        {
+            const sampling::SampleBuffer samples(f, -1.0, 2.0, divisions);
+            const integration::CumulativeIntegral integral(samples);
+
+            double running = 0.0;
+            bool matches = close(integral.values()[0], 0.0);
+
+            for (std::size_t i = 0; i < samples.divisions(); ++i)
+            {
+                running += (samples[i] + samples[i + 1]) * 0.5 * samples.step();
+                matches = matches && close(integral.values()[i + 1], running);
+            }
+
+            const std::string n = std::to_string(divisions);
+
+            check(matches, "the scan matches a serial running sum for " + n + " divisions");
+            check(close(integral.total(), integration::trapezoid_area(samples)),
+                  "F at the upper limit is the trapezoid area for " + n + " divisions");
+        }
+    }
+
+    void lookups_interpolate()
+    {
+        // F of a constant is linear, so interpolation is exact.
+        const integration::CumulativeIntegral integral([] (double) { return 2.0; }, 0.0, 4.0, 8);
+
+        check(integral(-1.0) == 0.0, "F is 0 below the range");
+        check(close(integral(5.0), 8.0), "F is the total above the range");
+        check(close(integral(1.25), 2.5), "F interpolates between grid points");
+        check(close(integral.area(1.0, 3.0), 4.0), "a sub-area is the difference of two lookups");
+        check(close(integral.area(3.0, 1.0), -4.0), "a reversed sub-area is negative");
+    }
+
+    void table_stride_divides()
+    {
+        check(integration::table_stride(100, 1000) == 1, "a grid smaller than the table is kept whole");
+        check(integration::table_stride(1000, 100) == 10, "a round grid is split evenly");
+        check(integration::table_stride(1000, 300) == 4, "the least divisor from the lower bound is taken");
+
+        // 1000003 is prime: no divisor, so the least stride.
+        check(integration::table_stride(1000003, 1000) == 1001, "a prime grid takes the least stride");
+
+        for (std::size_t divisions : { 1, 5, 999, 1 << 20, 3 * 999983 })
+        {
+            const std::size_t stride = integration::table_stride(divisions, 1000);
+            const std::size_t intervals = (divisions + stride - 1) / stride;
+
+            check(intervals <= 1000, "the table stays within its points for " + std::to_string(divisions));
+        }
+    }
+
+    void sweep_keeps_the_divisions()
+    {
+        for (std::size_t divisions : { 7, 1000, 1000003 })
+        {
+            for (std::size_t max_points : { 1, 4, 1000, 1 << 20 })
+            {
+                const auto sweep = integration::sweep(f, 0.0, 2.0, divisions, max_points, 3);
+
+                const double step = 2.0 / divisions;
+                double rectangles = 0.0;
+                double trapezoids = 0.0;
+
+                for (std::size_t i = 1; i <= divisions; ++i)
+                {
+                    rectangles += f(i * step);
+                    trapezoids += (f((i - 1) * step) + f(i * step)) * 0.5 * step;
+                }
+
+                bool on_f = true;
+
+                for (std::size_t j = 0; j < sweep.samples.size(); ++j)
+                {
+                    on_f = on_f && close(sweep.samples[j], f(sweep.samples.x(j)), 1e-12);
+                }
+
+                const std::string what = std::to_string(divisions) + " divisions and " +
+                                         std::to_string(max_points) + " table points";
+
+                check(close(sweep.areas.rectangles, rectangles * step), "rectangles over " + what);
+                check(close(sweep.areas.trapezoids, trapezoids), "trapezoids over " + what);
+                check(close(sweep.integral.total(), sweep.areas.trapezoids), "F ends at the area for " + what);
+                check(sweep.samples.divisions() <= max_points, "the table is bounded for " + what);
+                check(on_f, "the table holds f at its points for " + what);
+            }
+        }
+    }
+}
+
+int main()
+{
+    scan_matches_serial_sum();
+    lookups_interpolate();
+    table_stride_divides();
+    sweep_keeps_the_divisions();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// M4 decimation: the pyramid keeps the first, last, lowest and highest
+// sample of every bucket at every level, so a decimated view has at most
+// four points per pixel column and never loses a peak.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "lod.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    // A wiggle with one narrow spike, sampled on [0, 1].
+    constexpr std::size_t count = 1000003;
+    constexpr std::size_t spike = 654321;
+
+    glm::vec2 point(std::size_t i)
+    {
+        const double x = static_cast<double>(i) / (count - 1);
+        const double y = (i == spike) ? 50.0 : std::sin(x * 200.0);
+
+        return { static_cast<float>(x), static_cast<float>(y) };
+    }
+
+    void buckets()
+    {
+        lod::Bucket a;
+        a.add({ 0.0f, 1.0f });
+        a.add({ 1.0f, std::nanf("") });
+        a.add({ 2.0f, -1.0f });
+
+        check(!a.empty && a.first.x == 0.0f && a.last.x == 2.0f, "a bucket keeps its first and last point");
+        check(a.min.y == -1.0f && a.max.y == 1.0f, "a bucket keeps its extremes");
+
+        lod::Bucket b;
+        b.add({ 3.0f, 5.0f });
+        a.merge(b);
+        a.merge(lod::Bucket {});
+
+        check(a.first.x == 0.0f && a.last.x == 3.0f && a.max.y == 5.0f, "merging takes the later bucket's end");
+    }
+
+    void pyramid()
+    {
+        const lod::M4Pyramid lod(count, point);
+
+        check(lod.levels() > 1, "the pyramid has several levels");
+
+        // Whole range on 500 pixels.
+        const double pixels_per_unit = 500.0;
+        std::vector<GraphPoint> out;
+        lod.emit(0.0, 1.0, pixels_per_unit, { 0, 0, 0, 255 }, out);
+
+        check(!out.empty() && out.size() <= 4 * 502, "at most four points per pixel column");
+
+        const auto highest = std::max_element(out.begin(), out.end(), [] (const GraphPoint& a, const GraphPoint& b) {
+            return a.pos.y < b.pos.y;
+        });
+
+        check(highest->pos.y == 50.0f && highest->pos.x == point(spike).x, "the spike survives decimation");
+        check(out.front().pos.x == 0.0f && out.back().pos.x == 1.0f, "the ends of the series are kept");
+
+        bool ordered = true;
+
+        for (std::size_t i = 1; i < out.size(); ++i)
+        {
+            ordered = ordered && out[i].pos.x >= out[i - 1].pos.x;
+        }
+
+        check(ordered, "decimated points are in order of x");
+    }
+
+    void raw_when_zoomed_in()
+    {
+        const lod::M4Pyramid lod(count, point);
+
+        // Far less than a sample per pixel.
+        const double pixels_per_unit = 1e9;
+        check(lod.level_for(pixels_per_unit) == -1, "a deep zoom draws raw samples");
+
+        std::vector<GraphPoint> out;
+        lod.emit(0.5, 0.50001, pixels_per_unit, { 0, 0, 0, 255 }, out);
+
+        bool raw = !out.empty();
+
+        for (const auto& v : out)
+        {
+            const auto i = static_cast<std::size_t>(std::llround(v.pos.x * (count - 1.0)));
+            raw = raw && v.pos.x == point(i).x && v.pos.y == point(i).y;
+        }
+
+        check(raw, "zoomed in, the samples are drawn as they are");
+        check(out.front().pos.x < 0.5 && out.size() >= 12, "one sample of margin on each side");
+    }
+}
+
+int main()
+{
+    buckets();
+    pyramid();
+    raw_when_zoomed_in();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// Text that is not a whole expression must be rejected wherever it comes
+// in: by the parser, by the server with BadRequest (leaving the other
+// requests of the round alone) and by batch jobs.
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "parser.hpp"
+#include "program.hpp"
+#include "eval_server.hpp"
+#include "batch.hpp"
+
+namespace
+{
+    const char* const malformed[] = {
+        "", " ", "(", "sin(", "|x", "x)", "(x", "x*", "2 +", "-", "sin()", "x y", "x @ 2", "||x|",
+    };
+
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    void parser_rejects()
+    {
+        for (const char* text : malformed)
+        {
+            auto tokens = tokenizer::tokenize(text);
+            check(!parser::create_ast(tokens), std::string("the parser rejects \"") + text + '"');
+            check(!bytecode::compile(text).valid(), std::string("compile rejects \"") + text + '"');
+        }
+
+        for (const char* text : { "x", "-x", "|x - 1|", "sin(x) ^ 2", "(x + 1) * 2 ", "2 * |sin(x)|" })
+        {
+            auto tokens = tokenizer::tokenize(text);
+            check(parser::create_ast(tokens) != nullptr, std::string("the parser accepts \"") + text + '"');
+        }
+    }
+
+    void server_rejects()
+    {
+        const std::string path = "/tmp/sample_plotter_test_" + std::to_string(::getpid()) + ".sock";
+
+        service::Server server(path);
+        check(server.valid(), "the server listens");
+
+        if (!server.valid())
+        {
+            return;
+        }
+
+        std::atomic<bool> stop{false};
+        std::thread thread([&] { server.run(stop); });
+
+        {
+            service::Client client(path);
+            check(client.valid(), "the client connects");
+
+            const double x[2] = { 1.0, 2.0 };
+
+            // Sent together, so they are answered in the same round.
+            for (const char* text : malformed)
+            {
+                client.submit(service::Op::Evaluate, text, x, sizeof(x));
+            }
+
+            client.submit(service::Op::Evaluate, "x * x", x, sizeof(x));
+            client.submit(service::Op::Sample, "sin(", service::Range { 0.0, 1.0, 10 });
+            client.submit(service::Op::Integrate, "|x", service::Range { 0.0, 1.0, 10 });
+
+            service::ReplyHeader header;
+            std::vector<double> values;
+
+            for (const char* text : malformed)
+            {
+                check(client.receive(header, values) && header.status == service::Status::BadRequest,
+                      std::string("the server rejects \"") + text + '"');
+            }
+
+            check(client.receive(header, values) && header.status == service::Status::Ok &&
+                  values.size() == 2 && values[0] == 1.0 && values[1] == 4.0,
+                  "a valid request in the same round is answered");
+
+            check(client.receive(header, values) && header.status == service::Status::BadRequest,
+                  "the server rejects a sample request for \"sin(\"");
+            check(client.receive(header, values) && header.status == service::Status::BadRequest,
+                  "the server rejects an integrate request for \"|x\"");
+
+            client.submit(service::Op::Integrate, "x", service::Range { 0.0, 1.0, service::max_divisions + 1 });
+
+            check(client.receive(header, values) && header.status == service::Status::TooLarge,
+                  "the server refuses to integrate over too many divisions");
+        }
+
+        stop = true;
+        thread.join();
+    }
+
+    void batch_rejects()
+    {
+        const auto stats = batch::run({ "(; 0; 1; 10", "x; 0; 1; 10", "sin(; 0; 1; 10; -" }, "");
+
+        check(stats.jobs == 3, "every batch job is run");
+        check(stats.failed == 2, "batch jobs with malformed expressions fail");
+    }
+}
+
+int main()
+{
+    parser_rejects();
+    server_rejects();
+    batch_rejects();
+
+    return failures == 0 ? 0 : 1;
+}
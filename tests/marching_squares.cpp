@@ -0,0 +1,128 @@
+// Marching squares: every case of the table joins the edges where the
+// corners change sign, and the traced contour of a circle lies on it,
+// is closed, skips the tiles far from it and leaves poles alone.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "implicit.hpp"
+#include "program.hpp"
+
+namespace
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    // The corners of edge e: 0 bottom, 1 right, 2 top, 3 left.
+    bool crosses(int signs, int e)
+    {
+        const int a = e;
+        const int b = (e + 1) % 4;
+
+        return ((signs >> a) & 1) != ((signs >> b) & 1);
+    }
+
+    bool joins_crossings(int signs, const implicit::detail::Case& c)
+    {
+        int used[4] = {};
+
+        for (int k = 0; k < 2 * c.count; ++k)
+        {
+            if (!crosses(signs, c.edges[k]))
+            {
+                return false;
+            }
+
+            ++used[c.edges[k]];
+        }
+
+        for (int e = 0; e < 4; ++e)
+        {
+            if (used[e] != (crosses(signs, e) ? 1 : 0))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void case_table()
+    {
+        for (int signs = 0; signs < 16; ++signs)
+        {
+            check(joins_crossings(signs, implicit::detail::cases[signs]),
+                  "case " + std::to_string(signs) + " joins every crossing once");
+        }
+
+        check(joins_crossings(5, implicit::detail::saddles[0]), "saddle 5 with a positive centre");
+        check(joins_crossings(10, implicit::detail::saddles[1]), "saddle 10 with a positive centre");
+    }
+
+    void circle()
+    {
+        const auto f = bytecode::compile("x^2 + y^2 - 1");
+
+        // 600 x 600 pixels on [-3, 3]^2.
+        const grid::Viewport view { -3.0, 3.0, -3.0, 3.0, 100.0, 100.0 };
+
+        // Whatever is already in `out` stays in front.
+        std::vector<GraphPoint> out(3);
+        out[0].pos = { 42.0f, 42.0f };
+
+        const auto stats = implicit::trace(f, view, implicit::ContourOptions {}, { 0, 0, 0, 255 }, out);
+
+        check(out[0].pos.x == 42.0f, "the contour is appended after the existing vertices");
+        check(out.size() == 3 + 2 * stats.segments, "two vertices per segment");
+        check(stats.segments > 100, "the circle is traced");
+        check(stats.skipped_tiles > 0 && stats.skipped_tiles < stats.tiles, "tiles away from the circle are skipped");
+
+        double worst = 0.0;
+        double length = 0.0;
+
+        for (std::size_t i = 3; i + 1 < out.size(); i += 2)
+        {
+            const auto a = out[i].pos;
+            const auto b = out[i + 1].pos;
+
+            worst = std::max(worst, std::abs(std::hypot(a.x, a.y) - 1.0));
+            worst = std::max(worst, std::abs(std::hypot(b.x, b.y) - 1.0));
+            length += std::hypot(b.x - a.x, b.y - a.y);
+        }
+
+        check(worst < 1e-3, "every vertex is on the circle");
+        check(std::abs(length - 2 * pi) < 1e-2, "the contour goes once around the circle");
+    }
+
+    void pole()
+    {
+        const auto f = bytecode::compile("1 / (x - 0.013)");
+        const grid::Viewport view { -1.0, 1.0, -1.0, 1.0, 100.0, 100.0 };
+
+        std::vector<GraphPoint> out;
+        const auto stats = implicit::trace(f, view, implicit::ContourOptions {}, { 0, 0, 0, 255 }, out);
+
+        check(stats.segments == 0 && out.empty(), "a sign change through a pole is not a contour");
+    }
+}
+
+int main()
+{
+    case_table();
+    circle();
+    pole();
+
+    return failures == 0 ? 0 : 1;
+}
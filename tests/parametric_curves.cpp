@@ -0,0 +1,113 @@
+// Parametric and polar curves as two-output programs: both coordinates
+// come from one evaluation, and the length and shoelace area of the path
+// match the closed forms of circles and a cardioid.
+
+#include <cmath>
+#include <string>
+#include <memory>
+#include <iostream>
+
+#include "parametric.hpp"
+#include "integration.hpp"
+#include "program.hpp"
+#include "parser.hpp"
+#include "tokenizer.hpp"
+
+namespace
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    bool close(double a, double b, double tolerance)
+    {
+        return std::abs(a - b) <= tolerance;
+    }
+
+    std::unique_ptr<parser::ExprAST> parse(const std::string& text)
+    {
+        auto tokens = tokenizer::tokenize(text);
+        return parser::create_ast(tokens);
+    }
+
+    void circle()
+    {
+        const auto x = parse("cos(t)");
+        const auto y = parse("sin(t)");
+        const auto path = bytecode::Program::parametric(*x, *y);
+
+        check(path.outputs() == 2, "a parametric program has two outputs");
+
+        Curve curve;
+        parametric::sample(path, 0.0, 2 * pi, 1001, { 0, 0, 0, 255 }, curve);
+
+        bool on_circle = curve.vertices.size() == 1001;
+
+        for (std::size_t i = 0; on_circle && i < curve.vertices.size(); ++i)
+        {
+            const double t = 2 * pi * i / 1000.0;
+            const auto p = curve.vertices[i].pos;
+
+            on_circle = close(p.x, std::cos(t), 1e-6) && close(p.y, std::sin(t), 1e-6);
+        }
+
+        check(on_circle, "every vertex is (cos t, sin t)");
+        check(curve.strips.size() == 1 && curve.strips.count[0] == 1001, "a defined path is one strip");
+
+        check(close(integration::arc_length(path, 0.0, 2 * pi, 100000), 2 * pi, 1e-6), "the unit circle is 2 pi long");
+        check(close(integration::enclosed_area(path, 0.0, 2 * pi, 100000), pi, 1e-6), "the unit circle encloses pi");
+        check(close(integration::enclosed_area(path, 2 * pi, 0.0, 100000), -pi, 1e-6),
+              "running clockwise makes the area negative");
+
+        // Half a turn is closed by the diameter.
+        check(close(integration::enclosed_area(path, 0.0, pi, 100000), pi / 2, 1e-6),
+              "an open path is closed back to its start");
+    }
+
+    void polar()
+    {
+        const auto two = parse("2");
+        const auto disc = bytecode::Program::polar(*two);
+
+        check(close(integration::arc_length(disc, 0.0, 2 * pi, 100000), 4 * pi, 1e-5), "r = 2 is 4 pi long");
+        check(close(integration::enclosed_area(disc, 0.0, 2 * pi, 100000), 4 * pi, 1e-5), "r = 2 encloses 4 pi");
+
+        const auto r = parse("1 + cos(t)");
+        const auto cardioid = bytecode::Program::polar(*r);
+
+        check(close(integration::enclosed_area(cardioid, 0.0, 2 * pi, 100000), 1.5 * pi, 1e-6),
+              "the cardioid encloses 3 pi / 2");
+        check(close(integration::arc_length(cardioid, 0.0, 2 * pi, 100000), 8.0, 1e-5), "the cardioid is 8 long");
+    }
+
+    void undefined()
+    {
+        const auto x = parse("t");
+        const auto y = parse("sqrt(1 - t * t)");
+        const auto path = bytecode::Program::parametric(*x, *y);
+
+        Curve curve;
+        parametric::sample(path, -2.0, 2.0, 401, { 0, 0, 0, 255 }, curve);
+
+        check(curve.strips.size() == 1, "only the defined stretch is drawn");
+        check(curve.strips.count[0] == 201, "the defined stretch runs over [-1, 1]");
+    }
+}
+
+int main()
+{
+    circle();
+    polar();
+    undefined();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// A deliberately slow function must not hold back the first, coarse level
+// of a tile: it is published within the refinement budget, plus the few
+// evaluations already under way when the budget ran out.
+
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <cmath>
+
+#include "adaptive.hpp"
+#include "sampling_worker.hpp"
+
+namespace
+{
+    using namespace std::chrono_literals;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto eval_time = 1ms;
+    constexpr auto budget = 10ms;
+
+    // Endpoints, then one midpoint overrunning the deadline.
+    constexpr auto first_level_bound = budget + 3 * eval_time + 20ms;
+
+    double slow_sin(double x)
+    {
+        std::this_thread::sleep_for(eval_time);
+        return std::sin(x);
+    }
+
+    sampling::AdaptiveOptions options()
+    {
+        sampling::AdaptiveOptions opt;
+        opt.pixels_per_unit = 100.0;
+        opt.min_depth = 5;
+        opt.max_depth = 12;
+
+        return opt;
+    }
+
+    int failures = 0;
+
+    void check(bool ok, const char* what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    void step_publishes_first_level()
+    {
+        sampling::ProgressiveSampler sampler;
+        sampler.reset(slow_sin, options(), 0.0, 10.0);
+
+        const auto start = Clock::now();
+        const bool published = sampler.step(budget);
+        const auto elapsed = Clock::now() - start;
+
+        check(published, "step() completes the first level");
+        check(elapsed < first_level_bound, "step() returns within its budget");
+        check(!sampler.done(), "a slow function is not sampled within one budget");
+        check(sampler.curve().vertices.size() >= 2, "the first level has the endpoints");
+    }
+
+    void seeds_are_not_evaluated()
+    {
+        int calls = 0;
+        const auto counted = [&calls] (double x) { ++calls; return x; };
+
+        sampling::AdaptiveOptions opt = options();
+        opt.min_depth = 0;
+
+        sampling::ProgressiveSampler sampler;
+        sampler.reset(counted, opt, { { 0.0, 0.0 }, { 1.0, 1.0 }, { 2.0, 2.0 } });
+
+        while (!sampler.done())
+        {
+            sampler.step(budget);
+        }
+
+        // One midpoint per seed segment, both flat.
+        check(calls == 2, "seeded refinement evaluates only the midpoints");
+        check(sampler.curve().vertices.size() == 3, "flat seed segments are kept as they are");
+    }
+
+    void worker_publishes_first_level()
+    {
+        sampling::SamplingWorker worker(
+            [] (sampling::TileKey key, sampling::ProgressiveSampler& sampler) {
+                sampler.reset(slow_sin, options(), key.index, key.index + 1.0);
+            },
+            budget);
+
+        const auto start = Clock::now();
+        check(worker.request({ 0, 0 }), "the request is queued");
+
+        sampling::TileBatch batch;
+
+        while (!worker.poll(batch) && Clock::now() - start < 1s)
+        {
+            std::this_thread::sleep_for(100us);
+        }
+
+        check(Clock::now() - start < first_level_bound, "the worker publishes within its slice");
+        check(!batch.final, "the first batch is a coarse level");
+
+        // A cancelled tile stops being refined: at most the batch of the
+        // slice under way follows.
+        check(worker.cancel({ 0, 0 }), "the cancellation is queued");
+        std::this_thread::sleep_for(2 * first_level_bound);
+
+        int batches = 0;
+
+        while (worker.poll(batch))
+        {
+            ++batches;
+        }
+
+        std::this_thread::sleep_for(2 * first_level_bound);
+        check(!worker.poll(batch), "a cancelled tile publishes nothing more");
+        check(batches <= 2, "a cancelled tile stops within a slice");
+    }
+}
+
+int main()
+{
+    step_publishes_first_level();
+    seeds_are_not_evaluated();
+    worker_publishes_first_level();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// The shared sampling stage: f is evaluated exactly once per grid point,
+// whichever constructor fills the buffer, and the areas, lookups and the
+// downsampled plot all read the same samples.
+
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "sampling.hpp"
+#include "integration.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    bool close(double a, double b)
+    {
+        return std::abs(a - b) <= 1e-12 * std::max(1.0, std::abs(b));
+    }
+
+    double f(double x)
+    {
+        return std::exp(-x) * std::cos(5.0 * x);
+    }
+
+    void evaluated_once()
+    {
+        std::atomic<std::size_t> calls { 0 };
+
+        const sampling::SampleBuffer samples(sampling::counted(f, calls), 2.0, -1.0, 1000);
+
+        check(calls.load() == 1001, "every grid point is evaluated once");
+        check(samples.lower() == -1.0 && samples.upper() == 2.0, "reversed limits are swapped");
+        check(samples.divisions() == 1000 && close(samples.step(), 0.003), "the grid has the divisions asked for");
+
+        bool on_f = true;
+
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            on_f = on_f && samples[i] == f(samples.x(i));
+        }
+
+        check(on_f, "the samples are f on the grid");
+
+        const sampling::SampleBuffer batched(
+            sampling::batched,
+            [] (double x, double step, std::size_t count, double* out) {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    out[i] = f(x + i * step);
+                }
+            },
+            -1.0, 2.0, 1000);
+
+        bool same = batched.size() == samples.size();
+
+        for (std::size_t i = 0; same && i < samples.size(); ++i)
+        {
+            same = close(batched[i], samples[i]);
+        }
+
+        check(same, "a batch evaluator fills the same grid");
+    }
+
+    void areas_read_the_samples()
+    {
+        const sampling::SampleBuffer samples(f, 0.0, 1.0, 4096);
+
+        double right = 0.0;
+        double both = 0.0;
+
+        for (std::size_t i = 0; i < samples.divisions(); ++i)
+        {
+            right += samples[i + 1];
+            both += samples[i] + samples[i + 1];
+        }
+
+        check(close(integration::function_area(samples), right * samples.step()),
+              "the rectangle area sums the right ends");
+        check(close(integration::trapezoid_area(samples), both * 0.5 * samples.step()),
+              "the trapezoid area sums both ends");
+    }
+
+    void lookups()
+    {
+        const sampling::SampleBuffer samples(f, 0.0, 1.0, 100);
+
+        check(samples.lookup(0.25) == samples[25], "a grid point is looked up");
+        check(!samples.lookup(0.255), "a point between samples is not");
+        check(!samples.lookup(-0.01) && !samples.lookup(1.01), "points outside the grid are not");
+        check(!samples.lookup(std::nan("")), "NaN is not");
+
+        const sampling::SampleBuffer point(0.5, 0.5, { 3.0, 3.0 });
+
+        check(point.lookup(0.5) == 3.0 && !point.lookup(0.6), "a grid of no width has its one point");
+    }
+
+    void downsampling()
+    {
+        const sampling::SampleBuffer samples(f, 0.0, 1.0, 1000);
+
+        std::vector<double> xs;
+        bool on_grid = true;
+
+        samples.downsample(0.1, 0.6, 0.0035, [&] (double x, double y) {
+            xs.push_back(x);
+            on_grid = on_grid && samples.lookup(x) == y;
+        });
+
+        // 0.001 doubled until at least 0.0035: every 4th sample.
+        check(!xs.empty() && close(xs.front(), 0.1), "downsampling starts at the first sample in range");
+        check(xs.size() == 126, "every 4th sample of [0.1, 0.6] is kept");
+        check(on_grid, "downsampled points are samples");
+
+        std::size_t outside = 0;
+        samples.downsample(1.5, 2.0, 0.001, [&] (double, double) { ++outside; });
+
+        check(outside == 0, "nothing is downsampled outside the grid");
+    }
+}
+
+int main()
+{
+    evaluated_once();
+    areas_read_the_samples();
+    lookups();
+    downsampling();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// Sample files: samples written in one call or streamed in pieces read
+// back exactly through the mapping, as doubles or rounded to floats, and
+// files that are cut short or not sample files are refused.
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "sample_file.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    std::string temp_path(const char* name)
+    {
+        return "/tmp/sample_plotter_test_" + std::to_string(::getpid()) + name + ".spsm";
+    }
+
+    // More than a block of doubles, and not a whole number of blocks.
+    constexpr std::size_t count = 1234;
+
+    std::vector<double> ys()
+    {
+        std::vector<double> values(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            values[i] = std::sin(i * 0.1) * 1e3 + 1.0 / (i + 3);
+        }
+
+        values[7] = std::nan("");
+        values[8] = -INFINITY;
+
+        return values;
+    }
+
+    bool same(double a, double b)
+    {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    }
+
+    void extension()
+    {
+        check(samplefile::has_extension("out.spsm"), "*.spsm is a sample file");
+        check(!samplefile::has_extension(".spsm"), "the extension alone is not a name");
+        check(!samplefile::has_extension("out.txt") && !samplefile::has_extension("-"), "other outputs are text");
+    }
+
+    void uniform()
+    {
+        const std::string path = temp_path("_uniform");
+        const auto values = ys();
+        const samplefile::Info info { "sin(x)", -2.0, 10.34, 0.01 };
+
+        check(samplefile::write(path, info, nullptr, values.data(), count), "a uniform file is written");
+
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        check(static_cast<std::uint64_t>(in.tellg()) == samplefile::file_size(info, count, false),
+              "the file is as large as file_size says");
+
+        const samplefile::MappedSamples file(path);
+
+        check(file.valid() && file.uniform() && file.size() == count, "a uniform file is read back");
+        check(file.expression() == "sin(x)", "the expression is kept");
+        check(file.lower() == -2.0 && file.upper() == 10.34 && file.step() == 0.01, "the range is kept");
+        check(file.y_data() != nullptr && reinterpret_cast<std::uintptr_t>(file.y_data()) % alignof(double) == 0,
+              "the column is aligned in the mapping");
+
+        bool exact = true;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            exact = exact && same(file.y(i), values[i]) && file.x(i) == -2.0 + i * 0.01;
+        }
+
+        check(exact, "every sample reads back as written");
+
+        const auto view = file.view({ 0, 0, 0, 255 });
+        check(view.count == count && view.data == file.y_data(), "the view points into the mapping");
+
+        ::unlink(path.c_str());
+    }
+
+    void two_columns()
+    {
+        const std::string path = temp_path("_xy");
+        const auto values = ys();
+        std::vector<double> xs(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            xs[i] = i * i * 0.5;
+        }
+
+        samplefile::Info info { "", 0.0, xs.back(), 0.0 };
+        info.dtype = samplefile::DType::F32;
+
+        check(samplefile::write(path, info, xs.data(), values.data(), count), "an x, y file is written");
+
+        const samplefile::MappedSamples file(path);
+
+        check(file.valid() && !file.uniform() && file.dtype() == samplefile::DType::F32, "an x, y file is read back");
+        check(file.expression().empty(), "the expression may be empty");
+
+        bool rounded = true;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            rounded = rounded && file.x(i) == static_cast<float>(xs[i]) &&
+                      same(file.y(i), static_cast<float>(values[i]));
+        }
+
+        check(rounded, "float files keep the samples rounded to float");
+
+        ::unlink(path.c_str());
+    }
+
+    void streamed()
+    {
+        const std::string path = temp_path("_stream");
+        const auto values = ys();
+        const samplefile::Info info { "x * x", 0.0, 1.0, 1.0 / (count - 1) };
+
+        {
+            samplefile::StreamWriter out(path, info, count);
+            check(out.valid(), "a stream opens its file");
+
+            // Uneven pieces, and more than `count` in all.
+            std::size_t done = 0;
+
+            for (std::size_t piece = 1; done < count; piece = piece * 3 + 1)
+            {
+                const std::size_t n = std::min(piece, count - done);
+                out.put(values.data() + done, n);
+                done += n;
+            }
+
+            out.put(values.data(), 10);
+            check(out.finish(), "a stream finishes once every sample is put");
+        }
+
+        const samplefile::MappedSamples file(path);
+        bool exact = file.valid() && file.size() == count;
+
+        for (std::size_t i = 0; exact && i < count; ++i)
+        {
+            exact = same(file.y(i), values[i]);
+        }
+
+        check(exact, "streamed samples read back as written, without the extra ones");
+
+        {
+            samplefile::StreamWriter out(path, info, count);
+            out.put(values.data(), count - 1);
+
+            check(!out.finish(), "a stream short of samples fails");
+        }
+
+        ::unlink(path.c_str());
+    }
+
+    void refused()
+    {
+        const std::string path = temp_path("_bad");
+        const auto values = ys();
+        const samplefile::Info info { "x", 0.0, 1.0, 0.5 };
+
+        check(samplefile::write(path, info, nullptr, values.data(), count), "a file to spoil is written");
+
+        // Cut inside the column.
+        check(::truncate(path.c_str(), samplefile::file_size(info, count, false) - 8) == 0, "the file is cut");
+        check(!samplefile::MappedSamples(path).valid(), "a file cut short is refused");
+
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << std::string(8192, 'x');
+        }
+
+        const samplefile::MappedSamples other(path);
+        check(!other.valid() && !other.error().empty(), "a file that is not a sample file is refused");
+
+        check(!samplefile::MappedSamples(temp_path("_missing")).valid(), "a missing file is refused");
+
+        ::unlink(path.c_str());
+    }
+}
+
+int main()
+{
+    extension();
+    uniform();
+    two_columns();
+    streamed();
+    refused();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+// Once the ring wraps, its two strips must join up: the first one ends on
+// the sample the second one starts from, and together they cover every
+// sample in the ring, oldest first.
+
+#include <vector>
+#include <iostream>
+
+#include "sample_ring.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const char* what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    // The x of every vertex drawn, strip after strip, with the vertex two
+    // consecutive strips share counted once.
+    std::vector<float> drawn(streaming::SampleRing& ring, const std::vector<GraphPoint>& buffer)
+    {
+        std::vector<float> xs;
+        const StripList& strips = ring.segments();
+
+        for (std::size_t s = 0; s < strips.size(); ++s)
+        {
+            for (asl::mut_i32 i = 0; i < strips.count[s]; ++i)
+            {
+                const float x = buffer[strips.first[s] + i].pos.x;
+
+                if (i == 0 && s > 0)
+                {
+                    check(!xs.empty() && xs.back() == x, "strips share the vertex where they meet");
+                    continue;
+                }
+
+                xs.push_back(x);
+            }
+        }
+
+        return xs;
+    }
+
+    void wrapped_strips_are_contiguous()
+    {
+        streaming::SampleRing ring(5, { 0, 0, 255, 255 });
+        std::vector<GraphPoint> buffer(ring.buffer_size());
+
+        for (std::size_t count = 1; count <= 13; ++count)
+        {
+            ring.push(static_cast<double>(count - 1), 1.0);
+
+            ring.flush([&] (asl::i32 offset, const GraphPoint* data, asl::i32 n) {
+                std::copy(data, data + n, buffer.begin() + offset);
+            });
+
+            const auto xs = drawn(ring, buffer);
+            const std::size_t kept = std::min<std::size_t>(count, ring.capacity());
+
+            check(xs.size() == kept, "every sample in the ring is drawn once");
+
+            for (std::size_t i = 0; i < xs.size(); ++i)
+            {
+                check(xs[i] == static_cast<float>(count - kept + i), "samples are drawn oldest first");
+            }
+        }
+    }
+}
+
+int main()
+{
+    wrapped_strips_are_contiguous();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// The tile grid, the LRU cache of sampled tiles and the slots they are
+// given in the vertex buffer, without the worker or a GL context.
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "tile_cache.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        if (!ok)
+        {
+            std::cerr << "FAILED: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    Curve tile(std::size_t vertices)
+    {
+        Curve curve;
+        curve.vertices.resize(vertices);
+        curve.strips.push_back(0, static_cast<asl::i32>(vertices));
+
+        return curve;
+    }
+
+    void grid()
+    {
+        const sampling::TileGrid g;
+
+        check(g.level_for(1.0) == 0, "coarse scales use level 0");
+        check(g.level_for(g.base_scale) == 0, "the base scale is level 0");
+        check(g.level_for(g.base_scale * 1.5) == 1, "a scale between levels takes the finer one");
+        check(g.level_for(1e9) == g.max_level, "fine scales stop at the last level");
+
+        const sampling::TileKey key { 2, -3 };
+        check(g.lower(key) == -3 * g.width(2) && g.upper(key) == -2 * g.width(2),
+              "tiles of negative index are left of 0");
+
+        std::vector<sampling::TileKey> keys;
+        const double w = g.width(1);
+
+        g.visible(1, -0.5 * w, 1.5 * w, [&] (sampling::TileKey k) { keys.push_back(k); });
+
+        check(keys.size() == 3 && keys.front().index == -1 && keys.back().index == 1,
+              "the tiles overlapping a range are listed in order");
+    }
+
+    void lru()
+    {
+        sampling::TileCache cache(100);
+
+        cache.insert({ 0, 0 }, tile(40));
+        cache.insert({ 0, 1 }, tile(40));
+        cache.insert({ 0, 2 }, tile(40));
+
+        check(cache.size() == 3 && cache.vertices() == 120, "insertion never evicts");
+
+        // Tile 0 becomes the most recent one, so tile 1 goes first.
+        const Curve* first = cache.find({ 0, 0 });
+        check(first && first->vertices.size() == 40, "a cached tile is found");
+
+        cache.trim();
+
+        check(cache.vertices() <= 100, "trim fits the budget");
+        check(!cache.contains({ 0, 1 }) && cache.contains({ 0, 0 }) && cache.contains({ 0, 2 }),
+              "the least recently used tile is dropped");
+        check(cache.find({ 0, 1 }) == nullptr, "a dropped tile is not found");
+
+        cache.insert({ 0, 2 }, tile(10));
+        check(cache.size() == 2 && cache.vertices() == 50, "inserting a key again replaces its tile");
+
+        cache.insert({ 0, 3 }, tile(200));
+        cache.trim(2);
+        check(cache.size() == 2 && cache.contains({ 0, 3 }), "trim keeps the most recent tiles asked for");
+    }
+
+    void slots()
+    {
+        sampling::TileSlots slots(2, 64);
+        sampling::TileSlots::Assignment a {};
+        sampling::TileSlots::Assignment b {};
+
+        check(slots.capacity() == 128, "the buffer holds every slot");
+
+        check(slots.acquire({ 0, 0 }, 1, a) && a.fresh, "a new tile gets a fresh slot");
+        check(slots.acquire({ 0, 1 }, 1, b) && b.fresh && b.slot != a.slot, "another tile gets the other slot");
+        check(!slots.acquire({ 0, 2 }, 1, a), "no slot is taken from a tile of the same frame");
+
+        check(slots.touch({ 0, 1 }, 2), "a resident tile is touched");
+        check(slots.acquire({ 0, 1 }, 2, a) && !a.fresh && a.slot == b.slot, "a resident tile keeps its slot");
+
+        check(slots.acquire({ 0, 2 }, 2, a) && a.fresh && a.slot != b.slot,
+              "a new tile takes the slot drawn least recently");
+
+        slots.release({ 0, 1 });
+        check(!slots.touch({ 0, 1 }, 3), "a released tile has no slot");
+        check(slots.acquire({ 0, 1 }, 3, a) && a.fresh, "a released tile is written again");
+    }
+}
+
+int main()
+{
+    grid();
+    lru();
+    slots();
+
+    return failures == 0 ? 0 : 1;
+}